@@ -0,0 +1,153 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace config
+{
+// How the connection of every request is chosen
+enum class connection_selection
+{
+    ROUND_ROBIN,        // one after the other
+    LEAST_OUTSTANDING,  // the one with the fewest requests waiting for an answer
+    TWO_CHOICES         // the one with fewer requests waiting of two picked at random
+};
+
+/**
+ * Connections a client opens to the server. Load balancers spread traffic by
+ * connection, and every connection is served by one server worker, with its
+ * own HPACK context and TCP window, so a single one caps what hermes can load.
+ */
+struct connection_pool
+{
+    std::size_t size = 1;
+    connection_selection selection = connection_selection::ROUND_ROBIN;
+    // Streams a connection keeps open at most, 0 for no limit. The client cannot read the peer
+    // settings, so it has to be given, usually as 100, the lowest SETTINGS_MAX_CONCURRENT_STREAMS
+    // servers should advertise. Only then are requests held, and the pool may grow
+    std::size_t max_streams = 0;
+    // Connections the pool may grow to when all of them are out of streams, 0 to never grow
+    std::size_t max_size = 0;
+    // Requests waiting for a stream, beyond which they are skipped
+    std::size_t queue_size = 10000;
+    // Index of the first connection, so that the connections of every shard are told apart
+    std::size_t first_index = 0;
+
+    // Connections the pool may end up with
+    std::size_t capacity() const { return std::max(size, max_size); }
+
+    // The pool of the engine shard with the given index, with one such pool by endpoint
+    connection_pool shard(const std::size_t index, const std::size_t endpoints = 1) const
+    {
+        connection_pool p(*this);
+        p.first_index = index * capacity() * endpoints;
+        return p;
+    }
+};
+
+inline std::string to_string(const connection_selection s)
+{
+    switch (s)
+    {
+        case connection_selection::LEAST_OUTSTANDING:
+            return "least-outstanding";
+        case connection_selection::TWO_CHOICES:
+            return "two-choices";
+        default:
+            return "round-robin";
+    }
+}
+
+/**
+ * Builds the pool from its command line definition, a comma separated list of
+ * key=value: connections=<n>,select=round-robin|least-outstanding|two-choices,
+ * streams=<n>,grow=<max connections>,queue=<n>
+ * Throws std::invalid_argument when the definition is not valid.
+ */
+inline connection_pool parse_connection_pool(const std::string& definition)
+{
+    connection_pool pool;
+    std::istringstream fields(definition);
+    std::string field;
+    while (std::getline(fields, field, ','))
+    {
+        const auto separator = field.find('=');
+        const std::string key = field.substr(0, separator);
+        const std::string value =
+            separator == std::string::npos ? "" : field.substr(separator + 1);
+
+        if (key == "select")
+        {
+            if (value == "round-robin")
+            {
+                pool.selection = connection_selection::ROUND_ROBIN;
+            }
+            else if (value == "least-outstanding")
+            {
+                pool.selection = connection_selection::LEAST_OUTSTANDING;
+            }
+            else if (value == "two-choices")
+            {
+                pool.selection = connection_selection::TWO_CHOICES;
+            }
+            else
+            {
+                throw std::invalid_argument("Unknown connection selection: " + value);
+            }
+        }
+        else
+        {
+            std::size_t number{0};
+            try
+            {
+                std::size_t read{0};
+                number = std::stoul(value, &read);
+                if (read != value.size() || value.front() == '-')
+                {
+                    throw std::invalid_argument(value);
+                }
+            }
+            catch (const std::logic_error&)
+            {
+                throw std::invalid_argument("Wrong connection pool setting: " + field);
+            }
+
+            if (key == "connections" && number > 0)
+            {
+                pool.size = number;
+            }
+            else if (key == "streams")
+            {
+                pool.max_streams = number;
+            }
+            else if (key == "grow")
+            {
+                pool.max_size = number;
+            }
+            else if (key == "queue")
+            {
+                pool.queue_size = number;
+            }
+            else
+            {
+                throw std::invalid_argument("Wrong connection pool setting: " + field);
+            }
+        }
+    }
+
+    if (pool.max_size > 0 && pool.max_size < pool.size)
+    {
+        throw std::invalid_argument("The pool cannot grow to less than its connections");
+    }
+    if (pool.max_size > 0 && pool.max_streams == 0)
+    {
+        throw std::invalid_argument("The pool only grows when its connections are out of "
+                                    "streams, so it needs streams=<n>");
+    }
+    return pool;
+}
+
+}  // namespace config
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace config
+{
+// What to do with a send that would exceed the in-flight limits
+enum class overload_policy
+{
+    SKIP,   // it is not sent, and accounted as skipped
+    DELAY,  // the sender waits until there is room, so the rate drops
+    QUEUE   // it is kept until there is room, up to queue_size, and skipped beyond that
+};
+
+/**
+ * Caps on the work hermes keeps outstanding, so that a slow server cannot
+ * make it pile up timers and buffers without bounds. Requests are counted
+ * from the moment they are sent until they are answered or time out, and
+ * scripts from their first request until they are over. 0 means no limit.
+ */
+struct in_flight_limits
+{
+    std::size_t max_requests = 0;
+    std::size_t max_scripts = 0;
+    overload_policy policy = overload_policy::SKIP;
+    std::size_t queue_size = 10000;
+
+    bool enabled() const { return max_requests > 0 || max_scripts > 0; }
+
+    // Limits for one of count engine shards
+    in_flight_limits shard(const std::size_t count) const
+    {
+        in_flight_limits l(*this);
+        l.max_requests = (max_requests + count - 1) / count;
+        l.max_scripts = (max_scripts + count - 1) / count;
+        l.queue_size = (queue_size + count - 1) / count;
+        return l;
+    }
+};
+
+/**
+ * Builds the limits from their command line definition, a comma separated
+ * list of key=value: requests=<n>,scripts=<n>,policy=skip|delay|queue,queue=<n>
+ * Throws std::invalid_argument when the definition is not valid.
+ */
+inline in_flight_limits parse_in_flight_limits(const std::string& definition)
+{
+    in_flight_limits limits;
+    std::istringstream fields(definition);
+    std::string field;
+    while (std::getline(fields, field, ','))
+    {
+        const auto separator = field.find('=');
+        const std::string key = field.substr(0, separator);
+        const std::string value =
+            separator == std::string::npos ? "" : field.substr(separator + 1);
+
+        if (key == "policy")
+        {
+            if (value == "skip")
+            {
+                limits.policy = overload_policy::SKIP;
+            }
+            else if (value == "delay")
+            {
+                limits.policy = overload_policy::DELAY;
+            }
+            else if (value == "queue")
+            {
+                limits.policy = overload_policy::QUEUE;
+            }
+            else
+            {
+                throw std::invalid_argument("Unknown overload policy: " + value);
+            }
+            continue;
+        }
+
+        std::size_t number{0};
+        try
+        {
+            std::size_t read{0};
+            number = std::stoul(value, &read);
+            if (read != value.size() || value.front() == '-')
+            {
+                throw std::invalid_argument(value);
+            }
+        }
+        catch (const std::logic_error&)
+        {
+            throw std::invalid_argument("Wrong in-flight limit: " + field);
+        }
+
+        if (key == "requests")
+        {
+            limits.max_requests = number;
+        }
+        else if (key == "scripts")
+        {
+            limits.max_scripts = number;
+        }
+        else if (key == "queue")
+        {
+            limits.queue_size = number;
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown in-flight limit: " + field);
+        }
+    }
+    return limits;
+}
+
+}  // namespace config
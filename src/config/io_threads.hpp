@@ -0,0 +1,80 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace config
+{
+/**
+ * Threads running the io contexts of hermes, apart from the one of every
+ * engine shard. The connections of a shard share a set of io contexts, one
+ * thread each, so opening more connections does not add threads.
+ */
+struct io_threads
+{
+    // For the connections of all the shards. 0 means one per core
+    std::size_t connections = 0;
+    std::size_t stats = 2;
+
+    // Threads for the connections of the engine shard with the given index, at least one
+    std::size_t shard(const std::size_t index, const std::size_t shards) const
+    {
+        const std::size_t total =
+            connections > 0 ? connections : std::max(1u, std::thread::hardware_concurrency());
+        return std::max<std::size_t>(1, total / shards + (index < total % shards ? 1 : 0));
+    }
+};
+
+/**
+ * Builds the thread counts from their command line definition, a comma
+ * separated list of key=value: connections=<n>,stats=<n>
+ * Throws std::invalid_argument when the definition is not valid.
+ */
+inline io_threads parse_io_threads(const std::string& definition)
+{
+    io_threads threads;
+    std::istringstream fields(definition);
+    std::string field;
+    while (std::getline(fields, field, ','))
+    {
+        const auto separator = field.find('=');
+        const std::string key = field.substr(0, separator);
+        const std::string value =
+            separator == std::string::npos ? "" : field.substr(separator + 1);
+
+        std::size_t number{0};
+        try
+        {
+            std::size_t read{0};
+            number = std::stoul(value, &read);
+            if (read != value.size() || value.front() == '-')
+            {
+                throw std::invalid_argument(value);
+            }
+        }
+        catch (const std::logic_error&)
+        {
+            throw std::invalid_argument("Wrong thread setting: " + field);
+        }
+
+        if (key == "connections")
+        {
+            threads.connections = number;
+        }
+        else if (key == "stats" && number > 0)
+        {
+            threads.stats = number;
+        }
+        else
+        {
+            throw std::invalid_argument("Wrong thread setting: " + field);
+        }
+    }
+    return threads;
+}
+
+}  // namespace config
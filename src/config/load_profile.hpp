@@ -0,0 +1,316 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace config
+{
+/**
+ * Describes how the target rate (requests/s) evolves along the test.
+ * Ramps, steps and staircases are stored as a list of segments in which the
+ * rate changes linearly, and sines are solved in closed form.
+ * Time is expressed in seconds since the beginning of the traffic.
+ */
+class load_profile
+{
+public:
+    enum class shape
+    {
+        LINEAR,
+        SINE
+    };
+
+    struct segment
+    {
+        double start;     // s
+        double rate;      // req/s at start
+        double slope;     // req/s^2
+        double requests;  // expected requests sent before start
+    };
+
+    static load_profile constant(double rate) { return load_profile({{0, rate, 0, 0}}); }
+
+    static load_profile ramp(double from, double to, double seconds)
+    {
+        check_rates({from, to});
+        if (seconds <= 0)
+        {
+            throw std::invalid_argument("Ramp duration must be greater than 0.");
+        }
+        return load_profile({{0, from, (to - from) / seconds, 0},
+                             {seconds, to, 0, (from + to) / 2 * seconds}});
+    }
+
+    static load_profile step(double from, double to, double at)
+    {
+        check_rates({from, to});
+        if (at <= 0)
+        {
+            throw std::invalid_argument("Step must happen after the beginning of the traffic.");
+        }
+        return load_profile({{0, from, 0, 0}, {at, to, 0, from * at}});
+    }
+
+    static load_profile staircase(double from, double increment, double every, double to)
+    {
+        check_rates({from, to});
+        if (increment <= 0 || every <= 0 || to < from)
+        {
+            throw std::invalid_argument(
+                "Staircase needs a positive increment and duration, and a final rate greater "
+                "than the initial one.");
+        }
+
+        const double steps = std::ceil((to - from) / increment);
+        if (steps > max_segments)
+        {
+            throw std::invalid_argument("Too many steps in staircase.");
+        }
+
+        std::vector<segment> segments;
+        double requests{0};
+        for (int i = 0; i <= steps; ++i)
+        {
+            const double rate = std::min(from + i * increment, to);
+            segments.push_back({i * every, rate, 0, requests});
+            requests += rate * every;
+        }
+        return load_profile(std::move(segments));
+    }
+
+    static load_profile sine(double mean, double amplitude, double period)
+    {
+        check_rates({amplitude, mean - amplitude});
+        if (mean <= 0 || period <= 0)
+        {
+            throw std::invalid_argument("Sine mean rate and period must be greater than 0.");
+        }
+        load_profile p({{0, mean, 0, 0}});
+        p.kind = shape::SINE;
+        p.amplitude = amplitude;
+        p.period = period;
+        return p;
+    }
+
+    double rate_at(double t) const
+    {
+        if (kind == shape::SINE)
+        {
+            return segments.front().rate + amplitude * std::sin(2 * M_PI * t / period);
+        }
+        const auto& s = find(t);
+        return s.rate + s.slope * (t - s.start);
+    }
+
+    // Expected number of requests sent in [0, t]
+    double requests_until(double t) const
+    {
+        if (kind == shape::SINE)
+        {
+            return segments.front().rate * t +
+                   amplitude * period / (2 * M_PI) * (1 - std::cos(2 * M_PI * t / period));
+        }
+        const auto& s = find(t);
+        const double dt = t - s.start;
+        return s.requests + s.rate * dt + s.slope * dt * dt / 2;
+    }
+
+    // Mean target rate in [from, to]
+    double mean_rate(double from, double to) const
+    {
+        return to > from ? (requests_until(to) - requests_until(from)) / (to - from)
+                         : rate_at(from);
+    }
+
+    /**
+     * Time at which the expected number of requests reaches n, that is, the
+     * inverse of requests_until. As n grows monotonically in the sender, the
+     * index of the current segment is kept by the caller, so that every call
+     * is O(1).
+     */
+    double time_of(double n, std::size_t& current) const
+    {
+        if (kind == shape::SINE)
+        {
+            return sine_time_of(n);
+        }
+
+        while (current + 1 < segments.size() && segments[current + 1].requests <= n)
+        {
+            ++current;
+        }
+
+        const auto& s = segments[current];
+        const double left = n - s.requests;
+        if (left <= 0)
+        {
+            return s.start;
+        }
+
+        if (s.slope == 0)
+        {
+            // Once the rate drops to 0 for good, no more requests are expected
+            return s.rate > 0 ? s.start + left / s.rate : std::numeric_limits<double>::infinity();
+        }
+
+        // left = rate * dt + slope * dt^2 / 2
+        const double disc = std::max(0.0, s.rate * s.rate + 2 * s.slope * left);
+        return s.start + 2 * left / (s.rate + std::sqrt(disc));
+    }
+
+    // Same profile with every rate multiplied by factor
+    load_profile scaled(double factor) const
+    {
+        load_profile p(*this);
+        for (auto& s : p.segments)
+        {
+            s.rate *= factor;
+            s.slope *= factor;
+            s.requests *= factor;
+        }
+        p.amplitude *= factor;
+        return p;
+    }
+
+    // Same profile until t, and constant at rate from then on
+    load_profile switched(double t, double rate) const
+    {
+        check_rates({rate});
+        std::vector<segment> kept;
+        if (kind == shape::SINE)
+        {
+            // The past of a sine is summarized by its mean, so requests_until(t) stays the same
+            if (t > 0)
+            {
+                kept.push_back({0, mean_rate(0, t), 0, 0});
+            }
+        }
+        else
+        {
+            std::copy_if(segments.begin(), segments.end(), std::back_inserter(kept),
+                         [t](const segment& s) { return s.start < t; });
+        }
+        kept.push_back({t, rate, 0, requests_until(t)});
+        return load_profile(std::move(kept));
+    }
+
+    shape get_shape() const { return kind; }
+
+private:
+    static constexpr double max_segments = 100000;
+
+    explicit load_profile(std::vector<segment>&& s) : segments(std::move(s)) {}
+
+    static void check_rates(std::initializer_list<double> rates)
+    {
+        for (const auto r : rates)
+        {
+            if (r < 0)
+            {
+                throw std::invalid_argument("Rates in load profiles cannot be negative.");
+            }
+        }
+    }
+
+    const segment& find(double t) const
+    {
+        auto it = std::upper_bound(segments.begin(), segments.end(), t,
+                                   [](double time, const segment& s) { return time < s.start; });
+        return *std::prev(it);
+    }
+
+    double sine_time_of(double n) const
+    {
+        // requests_until is monotonic and within +-amplitude*period/pi of mean*t, so
+        // Newton is kept inside that bracket. It usually converges in a few iterations.
+        const double mean = segments.front().rate;
+        const double margin = amplitude * period / M_PI;
+        double lo = std::max(0.0, (n - margin) / mean);
+        double hi = (n + margin) / mean;
+        double t = n / mean;
+        for (int i = 0; i < 50; ++i)
+        {
+            const double f = requests_until(t) - n;
+            if (std::abs(f) < 1e-9 * std::max(1.0, n))
+            {
+                break;
+            }
+
+            if (f < 0)
+            {
+                lo = t;
+            }
+            else
+            {
+                hi = t;
+            }
+
+            const double rate = rate_at(t);
+            const double next = rate > 0 ? t - f / rate : lo;
+            t = next > lo && next < hi ? next : (lo + hi) / 2;
+        }
+        return t;
+    }
+
+    std::vector<segment> segments;
+    shape kind = shape::LINEAR;
+    double amplitude = 0;
+    double period = 0;
+};
+
+/**
+ * Builds a profile from its command line definition:
+ * ramp:<from>:<to>:<seconds> | step:<from>:<to>:<at_second> |
+ * stairs:<from>:<increment>:<every_seconds>:<to> | sine:<mean>:<amplitude>:<period_seconds>
+ * Throws std::invalid_argument when the definition is not valid.
+ */
+inline load_profile parse_load_profile(const std::string& definition)
+{
+    std::vector<std::string> fields;
+    std::size_t start{0};
+    for (auto end = definition.find(':'); end != std::string::npos;
+         start = end + 1, end = definition.find(':', start))
+    {
+        fields.push_back(definition.substr(start, end - start));
+    }
+    fields.push_back(definition.substr(start));
+
+    const auto& kind = fields.front();
+    std::vector<double> args;
+    try
+    {
+        std::transform(fields.begin() + 1, fields.end(), std::back_inserter(args),
+                       [](const std::string& f) { return std::stod(f); });
+    }
+    catch (const std::logic_error&)
+    {
+        throw std::invalid_argument("Wrong numeric value in load profile: " + definition);
+    }
+
+    if (kind == "ramp" && args.size() == 3)
+    {
+        return load_profile::ramp(args[0], args[1], args[2]);
+    }
+    if (kind == "step" && args.size() == 3)
+    {
+        return load_profile::step(args[0], args[1], args[2]);
+    }
+    if (kind == "stairs" && args.size() == 4)
+    {
+        return load_profile::staircase(args[0], args[1], args[2], args[3]);
+    }
+    if (kind == "sine" && args.size() == 3)
+    {
+        return load_profile::sine(args[0], args[1], args[2]);
+    }
+
+    throw std::invalid_argument("Unknown load profile: " + definition);
+}
+
+}  // namespace config
@@ -1,21 +1,70 @@
 #include <chrono>
+#include <cstdint>
+#include <optional>
+#include <vector>
 #pragma once
 
+#include "load_profile.hpp"
+
 using std::chrono::steady_clock;
 using std::chrono::time_point;
 namespace config
 {
+enum class arrival_mode
+{
+    CONSTANT,
+    POISSON,
+    JITTER,
+    TRACE
+};
+
+struct arrival_config
+{
+    arrival_mode mode = arrival_mode::CONSTANT;
+    // Fraction of the period a request may move around its nominal time (JITTER)
+    double jitter = 0.0;
+    // Inter-arrival gaps to be replayed, in any unit (TRACE)
+    std::vector<double> trace;
+    uint64_t seed = 1;
+};
+
 class params
 {
 public:
     params() = delete;
-    params(const int wait_time, const int duration) : wait_time(wait_time), duration(duration) {}
+    params(const double wait_time, const int duration, const arrival_config& arrival = {},
+           const std::optional<load_profile>& profile = std::nullopt)
+        : wait_time(wait_time),
+          duration(duration),
+          arrival(arrival),
+          profile(profile.value_or(load_profile::constant(1e6 / wait_time)))
+    {
+    }
     params(const params& p) = default;
 
     ~params() = default;
 
-    int64_t wait_time;
+    // Parameters for one of count engine shards, which sends 1/count of the traffic
+    params shard(const std::size_t index, const std::size_t count) const
+    {
+        params p(*this);
+        p.wait_time *= double(count);
+        p.profile = profile.scaled(1.0 / double(count));
+        p.arrival.seed += index;
+        // Interleave the shards instead of having all of them sending at the same time
+        p.phase = double(index) / double(count);
+        return p;
+    }
+
+    double wait_time;  // us
     int64_t duration;
+    // Minimum time between two wake-ups of the sender (us). Requests falling due
+    // in between are sent in a batch. With 0, the sender wakes up for every request.
+    double tick = 0;
+    // Offset of the first request, as a fraction of a request (0 to 1)
+    double phase = 0;
+    arrival_config arrival;
+    load_profile profile;
     time_point<steady_clock> init_time = steady_clock::now();
 };
 }  // namespace config
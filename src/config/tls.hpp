@@ -0,0 +1,95 @@
+#pragma once
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace config
+{
+/**
+ * Settings of the TLS context shared by every secure connection. Empty
+ * strings keep the defaults of OpenSSL. Peers are not verified by default,
+ * as test servers seldom have a trusted certificate.
+ */
+struct tls
+{
+    // PEM file with the certificates to verify the server with, on top of the system ones
+    std::string ca_file;
+    // For TLS 1.2 and below, and for TLS 1.3, in the OpenSSL format
+    std::string ciphers;
+    std::string suites;
+    // Offered in order. HTTP/2 must be among them
+    std::vector<std::string> alpn{"h2"};
+    bool verify = false;
+    // Reconnections resume the last session, with a TLS 1.3 ticket or a TLS 1.2 session id
+    bool resume = true;
+};
+
+/**
+ * Builds the TLS settings from their command line definition, a comma
+ * separated list of key=value: ca=<file>,ciphers=<list>,suites=<list>,
+ * alpn=<protocol>:<protocol>,verify=on|off,resume=on|off
+ * Throws std::invalid_argument when the definition is not valid.
+ */
+inline tls parse_tls(const std::string& definition)
+{
+    tls settings;
+    std::istringstream fields(definition);
+    std::string field;
+    while (std::getline(fields, field, ','))
+    {
+        const auto separator = field.find('=');
+        const std::string key = field.substr(0, separator);
+        const std::string value =
+            separator == std::string::npos ? "" : field.substr(separator + 1);
+        if (value.empty())
+        {
+            throw std::invalid_argument("Wrong TLS setting: " + field);
+        }
+
+        if (key == "ca")
+        {
+            settings.ca_file = value;
+        }
+        else if (key == "ciphers")
+        {
+            settings.ciphers = value;
+        }
+        else if (key == "suites")
+        {
+            settings.suites = value;
+        }
+        else if (key == "alpn")
+        {
+            settings.alpn.clear();
+            std::istringstream protocols(value);
+            std::string protocol;
+            while (std::getline(protocols, protocol, ':'))
+            {
+                if (protocol.empty() || protocol.size() > 255)
+                {
+                    throw std::invalid_argument("Wrong TLS setting: " + field);
+                }
+                settings.alpn.push_back(protocol);
+            }
+            if (std::find(settings.alpn.begin(), settings.alpn.end(), "h2") ==
+                settings.alpn.end())
+            {
+                throw std::invalid_argument("ALPN must offer h2: " + field);
+            }
+        }
+        else if ((key == "verify" || key == "resume") && (value == "on" || value == "off"))
+        {
+            (key == "verify" ? settings.verify : settings.resume) = value == "on";
+        }
+        else
+        {
+            throw std::invalid_argument("Wrong TLS setting: " + field);
+        }
+    }
+    return settings;
+}
+
+}  // namespace config
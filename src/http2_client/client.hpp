@@ -1,18 +1,40 @@
 #pragma once
 
+#include <chrono>
+#include <functional>
+#include <limits>
+
 namespace http2_client
 {
 class client
 {
 public:
+    // Called once a request is over. sent is false when it could not even be sent
+    using completion_handler = std::function<void(bool sent)>;
+
     virtual ~client() = default;
 
-    virtual void send() = 0;
+    /**
+     * Sends the next request. intended_time is when it should have been sent
+     * according to the schedule, so that answers delayed by a late send are
+     * still accounted from that time.
+     */
+    virtual void send(const std::chrono::steady_clock::time_point& intended_time) = 0;
+
+    void send() { send(std::chrono::steady_clock::now()); }
+
+    /**
+     * Requests that can be sent right now. Senders keep the rest for later,
+     * which only happens when the in-flight limits are set to delay them.
+     */
+    virtual std::size_t get_room() const { return std::numeric_limits<std::size_t>::max(); }
 
     virtual bool has_finished() const = 0;
 
     virtual void close_window() = 0;
 
     virtual bool is_connected() const = 0;
+
+    virtual void set_completion_handler(completion_handler&& handler) = 0;
 };
 }  // namespace http2_client
@@ -3,16 +3,19 @@
 #include <nghttp2/asio_http2_client.h>
 #include <syslog.h>
 
+#include <algorithm>
 #include <atomic>
 #include <boost/asio.hpp>
-#include <boost/bind/bind.hpp>
 #include <boost/system/error_code.hpp>
 #include <chrono>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <mutex>
 #include <optional>
+#include <random>
 #include <shared_mutex>
+#include <stdexcept>
 #include <utility>
 
 #include "connection.hpp"
@@ -32,202 +35,801 @@ namespace ot_conv = opentelemetry::semconv;
 
 namespace http2_client
 {
+namespace
+{
+// Resolution of the request timeouts, the same for all those of an io context
+constexpr milliseconds timeout_tick{10};
+// Time a connection is given to open before trying again
+constexpr milliseconds connect_timeout{2000};
+// Requests handed over to a connection and not submitted yet. Beyond that, they are posted
+// one by one
+constexpr std::size_t submission_ring_size{4096};
+// Most an answer reserves up front from its content-length. Pooled contexts keep their
+// buffers, so a wrong or huge length must not pin that much memory. Longer answers just grow
+constexpr std::size_t max_answer_reserve{1 << 20};
+}  // namespace
+
+client_impl::pooled_connection::pooled_connection(boost::asio::io_context& io_ctx,
+                                                  io_context_pool::context& conn_ctx,
+                                                  const std::size_t endpoint)
+    : endpoint(endpoint),
+      conn_ctx(conn_ctx),
+      streams(0),
+      submissions(submission_ring_size),
+      draining(false),
+      healthy(false),
+      reconnecting(false),
+      generation(0),
+      connecting(false),
+      attempts(0),
+      reconnect_timer(io_ctx)
+{
+}
+
+client_impl::endpoint_pool::endpoint_pool(const traffic::endpoint& ep, const bool secure_session,
+                                          const std::size_t first,
+                                          const config::connection_pool& pool_cfg)
+    : host(ep.dns),
+      port(ep.port),
+      uri_prefix(build_uri_prefix(ep.dns, ep.port, secure_session)),
+      first(first),
+      slots(std::max<std::size_t>(1, pool_cfg.capacity())),
+      active(std::max<std::size_t>(1, pool_cfg.size)),
+      growing(false),
+      selector(pool_cfg.selection)
+{
+}
+
 client_impl::client_impl(std::shared_ptr<stats::stats_if> st, boost::asio::io_context& io_ctx,
                          std::unique_ptr<traffic::script_queue_if> q, const std::string& h,
-                         const std::string& p, const bool secure_session)
+                         const std::string& p, const bool secure_session,
+                         const config::in_flight_limits& limits,
+                         const config::connection_pool& pool_cfg,
+                         const std::size_t io_threads)
+    : client_impl(std::move(st), io_ctx, std::move(q), {traffic::endpoint{h, p}}, {},
+                  secure_session, limits, pool_cfg, io_threads)
+{
+}
+
+client_impl::client_impl(std::shared_ptr<stats::stats_if> st, boost::asio::io_context& io_ctx,
+                         std::unique_ptr<traffic::script_queue_if> q,
+                         const std::vector<traffic::endpoint>& eps,
+                         const traffic::endpoint_selection& selection, const bool secure_session,
+                         const config::in_flight_limits& limits,
+                         const config::connection_pool& pool_cfg,
+                         const std::size_t io_threads)
     : stats(std::move(st)),
       io_ctx(io_ctx),
       queue(std::move(q)),
-      host(h),
-      port(p),
       secure_session(secure_session),
-      conn(std::make_unique<connection>(h, p, secure_session))
+      io_contexts(std::max<std::size_t>(1, io_threads), timeout_tick),
+      pool_config(pool_cfg),
+      endpoint_choice(eps, selection),
+      limits(limits),
+      outstanding(0),
+      jitter(std::random_device{}()),
+      life(std::make_shared<lifetime>())
 {
-    if (!conn->wait_to_be_connected())
+    if (eps.empty())
     {
-        std::cerr << "Fatal error. Could not connect to: " << host << ":" << port << std::endl;
+        throw std::invalid_argument("A client needs at least one endpoint");
+    }
+
+    // All the connections are opened at once, spread over the io contexts
+    for (std::size_t e = 0; e < eps.size(); ++e)
+    {
+        const auto& ep = *endpoints.emplace_back(
+            std::make_unique<endpoint_pool>(eps[e], secure_session, pool.size(), pool_config));
+        for (std::size_t i = 0; i < ep.slots; ++i)
+        {
+            auto& pc = pool.emplace_back(
+                std::make_unique<pooled_connection>(io_ctx, io_contexts.next(), e));
+            if (i < ep.active)
+            {
+                pc->conn = make_connection(ep.first + i, pc->generation);
+            }
+        }
+    }
+
+    for (std::size_t i = 0; i < pool.size(); ++i)
+    {
+        if (!is_active(i))
+        {
+            continue;
+        }
+        if (pool[i]->conn->wait_to_be_connected())
+        {
+            pool[i]->healthy = true;
+        }
+        else
+        {
+            const auto& ep = *endpoints[pool[i]->endpoint];
+            std::cerr << "Fatal error. Could not connect to: " << ep.host << ":" << ep.port
+                      << std::endl;
+        }
     }
 }
 
-void client_impl::handle_timeout(const std::shared_ptr<race_control>& control,
-                                 const std::string& msg_name) const
+client_impl::~client_impl()
 {
-    std::scoped_lock guard(control->mtx);
-    if (control->answered)
     {
-        return;
+        // Waits for the handler running, if any, and drops the rest
+        std::scoped_lock guard(life->mtx);
+        life->alive = false;
+    }
+    // Nothing of the connections runs from now on, neither their callbacks nor their timers
+    io_contexts.stop();
+    for (auto& pc : pool)
+    {
+        pc->conn.reset();
     }
-    control->timed_out = true;
-    stats->add_timeout(msg_name);
+    // Sessions still held by the handlers left close their streams when destroyed, so it is
+    // done while the pool is still there
+    io_contexts.shutdown();
+}
+
+bool client_impl::is_connected(const pooled_connection& pc) const
+{
+    return pc.conn != nullptr && pc.conn->get_status() == connection::status::OPEN;
+}
+
+bool client_impl::is_connected() const
+{
+    for (std::size_t i = 0; i < pool.size(); ++i)
+    {
+        if (is_active(i) && !is_connected(*pool[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void client_impl::add_event(const std::size_t index, const stats::connection_event e,
+                            const int64_t service_time)
+{
+    stats->add_connection_event(stats_index(index), e);
+    stats->add_endpoint_event(pool[index]->endpoint, e, service_time);
+}
+
+void client_impl::handle_timeout(const std::size_t index, const std::string& msg_name,
+                                 const steady_clock::time_point& intended_time)
+{
+    stats->add_timeout(msg_name,
+                       duration_cast<microseconds>(steady_clock::now() - intended_time).count());
+    add_event(index, stats::connection_event::FAILED);
     queue->cancel_script();
+    complete(true);
 }
 // TODO: Add timeout handling in spans
-void client_impl::handle_timeout_cancelled(const std::shared_ptr<race_control>& control,
-                                           const std::string& msg_name) const
+void client_impl::handle_abandoned(const std::size_t index, const std::string& msg_name)
+{
+    stats->add_error(msg_name, 469);
+    add_event(index, stats::connection_event::FAILED);
+    queue->cancel_script();
+    complete(false);
+}
+
+void client_impl::abandon_timeouts(const std::size_t index, const uint64_t generation)
+{
+    pool[index]->conn_ctx.timeouts.expire_all(
+        timeout_owner(index, generation),
+        [this](const uint64_t owner, const std::string& msg_name, const steady_clock::time_point&)
+        { handle_abandoned(owner_index(owner), msg_name); });
+}
+
+void client_impl::start_ticking(io_context_pool::context& ctx)
+{
+    if (!ctx.ticking)
+    {
+        ctx.ticking = true;
+        schedule_tick(ctx);
+    }
+}
+
+void client_impl::schedule_tick(io_context_pool::context& ctx)
+{
+    ctx.tick_timer.expires_after(timeout_tick);
+    ctx.tick_timer.async_wait(guarded([this, &ctx](const boost::system::error_code& e)
+                                      { on_tick(ctx, e); }));
+}
+
+void client_impl::on_tick(io_context_pool::context& ctx, const boost::system::error_code& e)
+{
+    ctx.ticking = false;
+    if (e)
+    {
+        return;
+    }
+
+    ctx.timeouts.advance(steady_clock::now(),
+                         [this](const uint64_t owner, const std::string& msg_name,
+                                const steady_clock::time_point& intended_time)
+                         { handle_timeout(owner_index(owner), msg_name, intended_time); });
+
+    // Only ticks while there are timeouts armed, so that the io context can run out of work
+    if (ctx.timeouts.size() > 0)
+    {
+        start_ticking(ctx);
+    }
+}
+
+std::shared_ptr<connection> client_impl::make_connection(const std::size_t index,
+                                                         const uint64_t generation)
+{
+    const auto& ep = *endpoints[pool[index]->endpoint];
+    return std::make_shared<connection>(
+        pool[index]->conn_ctx.io, ep.host, ep.port, secure_session,
+        [this, index, generation](const connection::status st)
+        {
+            boost::asio::post(io_ctx, guarded([this, index, generation, st]()
+                                              { on_status(index, generation, st); }));
+        });
+}
+
+void client_impl::open_connection(const std::size_t index)
+{
+    auto& pc = *pool[index];
+    {
+        std::unique_lock guard(pc.mtx);
+        pc.healthy = false;
+        // Requests still waiting for an answer are lost with the connection. Their timeouts are
+        // only touched from its io context, so they expire there
+        boost::asio::post(pc.conn_ctx.io,
+                          guarded([this, index, generation = pc.generation.load()]()
+                                  { abandon_timeouts(index, generation); }));
+        pc.conn.reset();
+        // Streams are not closed one by one when the connection is gone
+        ++pc.generation;
+        pc.streams = 0;
+        pc.conn = make_connection(index, pc.generation);
+    }
+
+    pc.connecting = true;
+    pc.reconnect_timer.expires_after(connect_timeout);
+    pc.reconnect_timer.async_wait(
+        guarded([this, index, generation = pc.generation.load()](const boost::system::error_code& e)
+                {
+                    if (!e)
+                    {
+                        on_connect_failure(index, generation);
+                    }
+                }));
+}
+
+void client_impl::start_reconnect(const std::size_t index)
 {
-    if (control->mtx.try_lock())
+    if (!pool[index]->reconnecting.exchange(true))
     {
-        if (!control->answered)
+        boost::asio::post(io_ctx, guarded([this, index]() { reconnect(index); }));
+    }
+}
+
+void client_impl::reconnect(const std::size_t index)
+{
+    auto& pc = *pool[index];
+    if (is_connected(pc))
+    {
+        pc.healthy = true;
+        pc.reconnecting = false;
+        return;
+    }
+    open_connection(index);
+}
+
+void client_impl::schedule_reconnect(const std::size_t index)
+{
+    auto& pc = *pool[index];
+    const auto wait =
+        reconnect_backoff(++pc.attempts, std::uniform_real_distribution<double>(0, 1)(jitter));
+    std::cerr << "Could not reconnect connection " << stats_index(index) << ". Retrying in "
+              << wait.count() << "ms" << std::endl;
+
+    pc.reconnect_timer.expires_after(wait);
+    pc.reconnect_timer.async_wait(guarded(
+        [this, index](const boost::system::error_code& e)
         {
-            control->timed_out = true;
-            stats->add_error(msg_name, 469);
-            queue->cancel_script();
+            if (!e)
+            {
+                reconnect(index);
+            }
+        }));
+}
+
+void client_impl::on_status(const std::size_t index, const uint64_t generation,
+                            const connection::status st)
+{
+    auto& pc = *pool[index];
+    if (generation != pc.generation)
+    {
+        return;
+    }
+
+    if (st == connection::status::OPEN)
+    {
+        pc.reconnect_timer.cancel();
+        pc.connecting = false;
+        pc.attempts = 0;
+        pc.healthy = true;
+        if (!is_active(index))
+        {
+            std::cerr << "Every connection is out of streams. Opened connection "
+                      << stats_index(index) << std::endl;
+            auto& ep = *endpoints[pc.endpoint];
+            ++ep.active;
+            ep.growing = false;
         }
-        control->mtx.unlock();
+        else if (pc.reconnecting.exchange(false))
+        {
+            std::cerr << "Reconnected connection " << stats_index(index) << std::endl;
+        }
+        send_deferred();
+        return;
+    }
+
+    pc.healthy = false;
+    if (pc.connecting)
+    {
+        on_connect_failure(index, generation);
+    }
+    else if (is_active(index))
+    {
+        // An open connection was lost
+        start_reconnect(index);
     }
 }
 
-void client_impl::on_timeout(const boost::system::error_code& e,
-                             std::shared_ptr<race_control> control,
-                             const std::string& msg_name) const
+void client_impl::on_connect_failure(const std::size_t index, const uint64_t generation)
 {
-    if (e.value() == 0)
+    auto& pc = *pool[index];
+    if (generation != pc.generation || !pc.connecting)
     {
-        handle_timeout(control, msg_name);
+        return;
     }
-    else
+
+    pc.connecting = false;
+    if (!is_active(index))
     {
-        handle_timeout_cancelled(control, msg_name);
+        on_grow_failure(index);
+        return;
     }
+    schedule_reconnect(index);
 }
 
-void client_impl::open_new_connection()
+void client_impl::grow(const std::size_t endpoint)
 {
-    if (!mtx.try_lock())
+    auto& ep = *endpoints[endpoint];
+    if (ep.active >= ep.slots)
     {
+        ep.growing = false;
         return;
     }
-    conn.reset();
+    // It is only taken once open, see on_status
+    open_connection(ep.first + ep.active);
+}
 
-    if (auto new_conn = std::make_unique<connection>(host, port, secure_session);
-        new_conn->wait_to_be_connected())
+void client_impl::on_grow_failure(const std::size_t index)
+{
+    // The pool is not grown again until the backoff is over
+    auto& pc = *pool[index];
+    const auto wait =
+        reconnect_backoff(++pc.attempts, std::uniform_real_distribution<double>(0, 1)(jitter));
+    pc.reconnect_timer.expires_after(wait);
+    pc.reconnect_timer.async_wait(guarded(
+        [this, endpoint = pc.endpoint](const boost::system::error_code& e)
+        {
+            if (!e)
+            {
+                endpoints[endpoint]->growing = false;
+            }
+        }));
+}
+
+int64_t client_impl::in_flight_room() const
+{
+    const int64_t requests = limits.max_requests ? int64_t(limits.max_requests) - outstanding
+                                                 : std::numeric_limits<int64_t>::max();
+    return std::min(requests, queue->get_room());
+}
+
+int64_t client_impl::stream_room() const
+{
+    if (pool_config.max_streams == 0)
     {
-        conn = std::move(new_conn);
+        return std::numeric_limits<int64_t>::max();
     }
-    else
+
+    int64_t free{0};
+    bool any_healthy{false};
+    for (std::size_t i = 0; i < pool.size(); ++i)
     {
-        new_conn.reset();
+        if (is_active(i) && pool[i]->healthy)
+        {
+            any_healthy = true;
+            free += std::max<int64_t>(0, int64_t(pool_config.max_streams) - pool[i]->streams);
+        }
     }
-    mtx.unlock();
+    // Without any connection open sends are not held, they are lost right away as 466
+    return any_healthy ? free : std::numeric_limits<int64_t>::max();
+}
+
+int64_t client_impl::room() const
+{
+    return std::min(in_flight_room(), stream_room());
 }
 
-void client_impl::send()
+std::size_t client_impl::get_room() const
+{
+    if (!limits.enabled() || limits.policy != config::overload_policy::DELAY)
+    {
+        return std::numeric_limits<std::size_t>::max();
+    }
+    return std::size_t(std::max<int64_t>(0, in_flight_room()));
+}
+
+void client_impl::defer(const steady_clock::time_point& intended_time)
+{
+    // Once the window is closed, only ongoing scripts are sent, and they are not lost
+    if (queue->is_window_closed())
+    {
+        return;
+    }
+
+    if (in_flight_room() <= 0)
+    {
+        // With delay, the sender already waits for room, so only sends racing with it are kept
+        if (limits.policy != config::overload_policy::SKIP && deferred.size() < limits.queue_size)
+        {
+            deferred.push_back({intended_time, std::nullopt});
+            return;
+        }
+        stats->add_skipped();
+        return;
+    }
+
+    // Every connection is out of streams, or there are sends already waiting for them
+    if (stream_room() <= 0)
+    {
+        for (std::size_t e = 0; e < endpoints.size(); ++e)
+        {
+            if (auto& ep = *endpoints[e]; ep.active < ep.slots && !ep.growing.exchange(true))
+            {
+                boost::asio::post(io_ctx, guarded([this, e]() { grow(e); }));
+            }
+        }
+    }
+    if (deferred.size() < pool_config.queue_size)
+    {
+        deferred.push_back({intended_time, steady_clock::now()});
+        return;
+    }
+    stats->add_skipped();
+}
+
+void client_impl::send_deferred()
+{
+    std::unique_lock guard(deferred_mtx);
+    while (!deferred.empty() && room() > 0)
+    {
+        const auto next = deferred.front();
+        deferred.pop_front();
+        guard.unlock();
+        if (next.stream_wait_since)
+        {
+            stats->add_stream_wait(
+                duration_cast<microseconds>(steady_clock::now() - *next.stream_wait_since)
+                    .count());
+        }
+        send_now(next.intended_time);
+        guard.lock();
+    }
+}
+
+void client_impl::notify_room()
+{
+    if (defers())
+    {
+        std::scoped_lock guard(deferred_mtx);
+        if (!deferred.empty())
+        {
+            boost::asio::post(io_ctx, guarded([this]() { send_deferred(); }));
+        }
+    }
+}
+
+void client_impl::release_stream(const std::size_t index, const uint64_t generation)
+{
+    // Streams are not closed one by one when the connection is replaced
+    if (auto& pc = *pool[index]; pc.generation == generation)
+    {
+        --pc.streams;
+    }
+    notify_room();
+}
+
+void client_impl::complete(const bool sent)
+{
+    --outstanding;
+    notify_room();
+
+    if (on_completion)
+    {
+        on_completion(sent);
+    }
+}
+
+void client_impl::send(const steady_clock::time_point& intended_time)
+{
+    if (defers())
+    {
+        std::scoped_lock guard(deferred_mtx);
+        // Deferred sends go first
+        if (!deferred.empty() || room() <= 0)
+        {
+            defer(intended_time);
+            return;
+        }
+    }
+    send_now(intended_time);
+}
+
+void client_impl::send_now(const steady_clock::time_point& intended_time)
 {
     auto script = queue->get_next_script();
     if (!script)
     {
         return;
     }
-    request req = get_next_request(host, port, *script);
+    auto& ep = *endpoints[endpoint_of(*script)];
+    // Connections being reconnected are only taken if none is open
+    const std::size_t index =
+        ep.first +
+        ep.selector.select(
+            ep.active,
+            [this, first = ep.first](const std::size_t i)
+            {
+                const auto& pc = *pool[first + i];
+                return pc.healthy ? pc.streams.load() : std::numeric_limits<int64_t>::max();
+            },
+            pool_config.max_streams ? int64_t(pool_config.max_streams)
+                                    : std::numeric_limits<int64_t>::max());
+    auto& pc = *pool[index];
+    ++outstanding;
+    ++pc.streams;
+    const uint64_t generation = pc.generation;
 
-    if (!is_connected())
+    if (!pc.mtx.try_lock_shared())
     {
-        stats->add_client_error(req.name, 466);
+        stats->add_client_error(script->get_next_msg_name(), 467);
+        add_event(index, stats::connection_event::FAILED);
         queue->cancel_script();
-        open_new_connection();
+        release_stream(index, generation);
+        complete(false);
         return;
     }
 
-    if (!mtx.try_lock_shared())
+    if (!is_connected(pc))
     {
-        stats->add_client_error(req.name, 467);
+        pc.mtx.unlock_shared();
+        stats->add_client_error(script->get_next_msg_name(), 466);
+        add_event(index, stats::connection_event::FAILED);
         queue->cancel_script();
+        release_stream(index, generation);
+        start_reconnect(index);
+        complete(false);
         return;
     }
 
-    const auto& session = conn->get_session();
-    session.io_service().post(
-        [this, script = std::move(script), &session, req]() mutable
-        {
-            boost::system::error_code ec;
-            auto init_time = std::make_shared<time_point<steady_clock>>(steady_clock::now());
+    auto ctx = contexts.acquire();
+    fill_next_request(ctx->req, ep.uri_prefix, *script);
+    ctx->script = std::move(script);
+    ctx->intended_time = intended_time;
+    ctx->index = index;
+    ctx->generation = generation;
 
-            auto span = o11y::create_child_span(req.name, script->get_span());
-            span->SetAttribute(ot_conv::url::kUrlFull, req.url);
-            span->SetAttribute(ot_conv::http::kHttpRequestMethod, req.method);
-            o11y::inject_trace_context(span, req.headers);
+    enqueue(index, std::move(ctx));
+    pc.mtx.unlock_shared();
+}
+
+std::size_t client_impl::endpoint_of(traffic::script& s)
+{
+    if (const auto e = s.get_endpoint())
+    {
+        return *e;
+    }
+    // Every request of the script goes to the same endpoint
+    const std::size_t e = endpoint_choice.select(s.get_endpoint_key());
+    s.set_endpoint(e);
+    return e;
+}
 
-            auto nghttp_req = session.submit(ec, req.method, req.url, req.body, req.headers);
-            if (!nghttp_req)
+void client_impl::enqueue(const std::size_t index, request_context_ptr ctx)
+{
+    auto& pc = *pool[index];
+    if (!pc.submissions.push(ctx.get()))
+    {
+        boost::asio::post(pc.conn_ctx.io, [this, index, ctx = std::move(ctx)]() mutable
+                          { drain(index, std::move(ctx)); });
+        return;
+    }
+    ctx.detach();
+
+    // A single wake-up of the connection thread for every request pushed until it drains
+    if (!pc.draining.exchange(true))
+    {
+        boost::asio::post(pc.conn_ctx.io, [this, index]() { drain(index); });
+    }
+}
+
+void client_impl::drain(const std::size_t index, request_context_ptr overflow)
+{
+    auto& pc = *pool[index];
+    // Cleared first, so that requests pushed while draining wake it up again
+    pc.draining = false;
+
+    std::shared_ptr<connection> conn;
+    uint64_t generation{0};
+    {
+        std::shared_lock guard(pc.mtx);
+        conn = pc.conn;
+        generation = pc.generation;
+    }
+
+    // Every request is submitted before nghttp2 gets to write again, so they share the writes
+    if (overflow)
+    {
+        submit(conn, generation, std::move(overflow));
+    }
+    request_context* raw{nullptr};
+    while (pc.submissions.pop(raw))
+    {
+        submit(conn, generation, request_context_ptr(raw, false));
+    }
+}
+
+void client_impl::submit(const std::shared_ptr<connection>& conn, const uint64_t generation,
+                         request_context_ptr ctx)
+{
+    if (!conn || ctx->generation != generation)
+    {
+        // The connection was replaced while the request was waiting to be submitted
+        stats->add_client_error(ctx->req.name, 466);
+        add_event(ctx->index, stats::connection_event::FAILED);
+        queue->cancel_script();
+        release_stream(ctx->index, ctx->generation);
+        complete(false);
+        return;
+    }
+
+    auto& pc = *pool[ctx->index];
+    auto& session = conn->get_session();
+    boost::system::error_code ec;
+    ctx->init_time = steady_clock::now();
+
+    ctx->span = o11y::create_child_span(ctx->req.name, ctx->script->get_span());
+    ctx->span->SetAttribute(ot_conv::url::kUrlFull, ctx->req.url);
+    ctx->span->SetAttribute(ot_conv::http::kHttpRequestMethod, ctx->req.method);
+    o11y::inject_trace_context(ctx->span, ctx->req.headers);
+
+    auto nghttp_req =
+        session.submit(ec, ctx->req.method, ctx->req.url, ctx->req.body, ctx->req.headers);
+    if (!nghttp_req)
+    {
+        std::cerr << "Error submitting. Closing connection:" << ec.message() << std::endl;
+        conn->close();
+        stats->add_client_error(ctx->req.name, 468);
+        add_event(ctx->index, stats::connection_event::FAILED);
+        queue->cancel_script();
+        release_stream(ctx->index, ctx->generation);
+        complete(false);
+        return;
+    }
+
+    stats->increase_sent(ctx->req.name);
+    add_event(ctx->index, stats::connection_event::SENT);
+    ctx->span->AddEvent("Request sent");
+
+    // Named after the message in the definition, which outlives the request and its context
+    ctx->timeout = pc.conn_ctx.timeouts.arm(
+        steady_clock::now(), milliseconds(ctx->script->get_timeout_ms()),
+        ctx->script->get_next_msg_name(), ctx->intended_time,
+        timeout_owner(ctx->index, ctx->generation));
+    start_ticking(pc.conn_ctx);
+
+    // The stream keeps the context until it is closed, and its callbacks borrow it
+    request_context* stream_ctx = ctx.detach();
+    nghttp_req->on_response([this, stream_ctx](const ng::client::response& res)
+                            { on_response(stream_ctx, res); });
+
+    // Streams stay open after a timeout, until the server answers or resets them. The context
+    // goes back to the pool even if the client is being destroyed. Streams are only closed
+    // from the io contexts, which the client tears down before it is gone, so this is valid
+    nghttp_req->on_close(
+        [this, stream_ctx]([[maybe_unused]] uint32_t error_code)
+        {
+            request_context_ptr adopted(stream_ctx, false);
+            std::scoped_lock guard(life->mtx);
+            if (life->alive)
             {
-                std::cerr << "Error submitting. Closing connection:" << ec.message() << std::endl;
-                conn->close();
-                stats->add_client_error(req.name, 468);
-                queue->cancel_script();
-                return;
+                release_stream(stream_ctx->index, stream_ctx->generation);
             }
+        });
+}
 
-            stats->increase_sent(req.name);
-            span->AddEvent("Request sent");
+void client_impl::on_response(request_context* ctx, const ng::client::response& res)
+{
+    ctx->answer_time = steady_clock::now();
 
-            auto ctrl = std::make_shared<race_control>();
-            auto timer = std::make_shared<boost::asio::steady_timer>(io_ctx);
-            timer->expires_after(milliseconds(script->get_timeout_ms()));
-            timer->async_wait(boost::bind(&client_impl::on_timeout, this,
-                                          boost::asio::placeholders::error, ctrl, req.name));
+    // Whoever takes the timeout out of the wheel owns the request
+    if (!pool[ctx->index]->conn_ctx.timeouts.cancel(ctx->timeout))
+    {
+        return;
+    }
 
-            nghttp_req->on_response(
-                [this, timer, init_time, script = std::move(script), ctrl, req,
-                 span](const ng::client::response& res) mutable
-                {
-                    auto elapsed_time =
-                        duration_cast<microseconds>(steady_clock::now() - (*init_time)).count();
+    ctx->span->AddEvent("Response received");
+    ctx->response = &res;
+    if (const auto* compiled = ctx->script->get_next_template())
+    {
+        ctx->keep_answer = compiled->needs_body;
+        ctx->keep_headers = compiled->needs_headers;
+    }
+    if (const int64_t length = res.content_length();
+        ctx->keep_answer && length > int64_t(ctx->answer.capacity()))
+    {
+        ctx->answer.reserve(std::min(std::size_t(length), max_answer_reserve));
+    }
+    res.on_data([this, ctx](const uint8_t* data, std::size_t len) { on_data(ctx, data, len); });
+}
 
-                    std::lock_guard guard(ctrl->mtx);
-                    if (ctrl->timed_out)
-                    {
-                        return;
-                    }
-                    ctrl->answered = true;
-                    timer->cancel();
-
-                    span->AddEvent("Response received");
-                    auto answer = std::make_shared<std::string>();
-                    res.on_data(
-                        [this, &res, script = std::move(script), answer, elapsed_time, req, span](
-                            const uint8_t* data, std::size_t len) mutable
-                        {
-                            if (len > 0)
-                            {
-                                std::string json(reinterpret_cast<const char*>(data), len);
-                                *answer += json;
-                            }
-                            else
-                            {
-                                span->AddEvent("Body received");
-                                traffic::answer_type ans = {res.status_code(), *answer,
-                                                            res.header()};
-                                span->SetAttribute(ot_conv::http::kHttpResponseStatusCode,
-                                                   res.status_code());
-
-                                bool valid_answer = script->validate_answer(ans);
-                                if (valid_answer)
-                                {
-                                    stats->add_measurement(req.name, elapsed_time,
-                                                           res.status_code());
-                                    span->SetStatus(ot_trace::StatusCode::kOk);
-                                    span->End();
-                                    queue->enqueue_script(std::move(script), ans);
-                                }
-                                else
-                                {
-                                    stats->add_error(req.name, res.status_code());
-                                    span->SetStatus(opentelemetry::trace::StatusCode::kError);
-                                    span->End();
-                                    queue->cancel_script();
-                                }
-                            }
-                        });
-                });
-
-            nghttp_req->on_close(
-                []([[maybe_unused]] uint32_t error_code)
-                {
-                    // on_close is registered here for the sake of completion and
-                    // because it helps debugging sometimes, but no implementation needed.
-                });
-        });
-    mtx.unlock_shared();
+void client_impl::on_data(request_context* ctx, const uint8_t* data, const std::size_t len)
+{
+    if (len > 0)
+    {
+        ctx->answer_bytes += len;
+        if (ctx->keep_answer)
+        {
+            ctx->answer.append(reinterpret_cast<const char*>(data), len);
+        }
+        return;
+    }
+
+    const auto& res = *ctx->response;
+    const auto elapsed_time =
+        duration_cast<microseconds>(ctx->answer_time - ctx->init_time).count();
+    const auto response_time =
+        duration_cast<microseconds>(ctx->answer_time - ctx->intended_time).count();
+    const auto& name = ctx->req.name;
+
+    ctx->span->AddEvent("Body received");
+    traffic::answer_type ans{res.status_code(), {}, {}};
+    ans.body.swap(ctx->answer);
+    if (ctx->keep_headers)
+    {
+        ans.headers = res.header();
+    }
+    ctx->span->SetAttribute(ot_conv::http::kHttpResponseStatusCode, res.status_code());
+    ctx->span->SetAttribute(ot_conv::http::kHttpResponseBodySize, int64_t(ctx->answer_bytes));
+
+    stats->add_latency(name, elapsed_time, response_time);
+    add_event(ctx->index, stats::connection_event::ANSWERED, elapsed_time);
+    bool valid_answer = ctx->script->validate_answer(ans);
+    if (valid_answer)
+    {
+        stats->add_measurement(name, elapsed_time, res.status_code());
+        ctx->span->SetStatus(ot_trace::StatusCode::kOk);
+        ctx->span->End();
+        queue->enqueue_script(std::move(ctx->script), ans);
+    }
+    else
+    {
+        stats->add_error(name, res.status_code());
+        ctx->span->SetStatus(opentelemetry::trace::StatusCode::kError);
+        ctx->span->End();
+        queue->cancel_script();
+    }
+    // The buffer goes back to the context, for the next request to use
+    ctx->answer.swap(ans.body);
+    complete(true);
 }
 
 }  // namespace http2_client
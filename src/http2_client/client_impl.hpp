@@ -1,19 +1,32 @@
 #include <atomic>
 #include <boost/asio.hpp>
+#include <deque>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <random>
 #include <shared_mutex>
+#include <vector>
 
 #pragma once
 
 #include "client.hpp"
 #include "client_utils.hpp"
 #include "connection.hpp"
+#include "connection_pool.hpp"
+#include "connection_selector.hpp"
+#include "endpoint_selector.hpp"
+#include "in_flight_limits.hpp"
+#include "io_context_pool.hpp"
+#include "mpsc_ring.hpp"
+#include "request_context.hpp"
 #include "script_queue.hpp"
+#include "timeout_wheel.hpp"
 
 namespace stats
 {
 class stats_if;
+enum class connection_event;
 }
 
 namespace http2_client
@@ -23,35 +36,210 @@ class client_impl : public client
 public:
     client_impl(std::shared_ptr<stats::stats_if> stats, boost::asio::io_context& io_ctx,
                 std::unique_ptr<traffic::script_queue_if> q, const std::string& h,
-                const std::string& p, const bool secure_session = false);
+                const std::string& p, const bool secure_session = false,
+                const config::in_flight_limits& limits = {},
+                const config::connection_pool& pool = {}, const std::size_t io_threads = 1);
 
-    ~client_impl() final = default;
+    // A pool of connections by endpoint, and every script sent to one of them
+    client_impl(std::shared_ptr<stats::stats_if> stats, boost::asio::io_context& io_ctx,
+                std::unique_ptr<traffic::script_queue_if> q,
+                const std::vector<traffic::endpoint>& endpoints,
+                const traffic::endpoint_selection& selection, const bool secure_session = false,
+                const config::in_flight_limits& limits = {},
+                const config::connection_pool& pool = {}, const std::size_t io_threads = 1);
+
+    ~client_impl() final;
 
-    void send() override;
+    using client::send;
+    void send(const std::chrono::steady_clock::time_point& intended_time) override;
+    std::size_t get_room() const override;
     bool has_finished() const override { return !queue->has_pending_scripts(); };
     void close_window() override { queue->close_window(); };
-    bool is_connected() const override
+    // True when every connection opened so far is open
+    bool is_connected() const override;
+    void set_completion_handler(completion_handler&& handler) override
     {
-        return conn != nullptr && conn->get_status() == connection::status::OPEN;
+        on_completion = std::move(handler);
     };
 
 private:
-    void open_new_connection();
-    void handle_timeout(const std::shared_ptr<race_control>& control,
-                        const std::string& msg_name) const;
-    void handle_timeout_cancelled(const std::shared_ptr<race_control>& control,
-                                  const std::string& msg_name) const;
-    void on_timeout(const boost::system::error_code& e, std::shared_ptr<race_control> control,
-                    const std::string& msg_name) const;
+    // A connection of the pool, with the requests waiting on it
+    struct pooled_connection
+    {
+        pooled_connection(boost::asio::io_context& io_ctx, io_context_pool::context& conn_ctx,
+                          const std::size_t endpoint);
+
+        // Endpoint of the script it connects to
+        const std::size_t endpoint;
+        // Where the connection runs, and the wheel its timeouts are armed in. Reconnections stay
+        // in it
+        io_context_pool::context& conn_ctx;
+        // Also held by the requests about to be submitted on it
+        std::shared_ptr<connection> conn;
+        // Held shared while sending, and exclusively while replacing the connection
+        std::shared_timed_mutex mtx;
+        // Streams open, or taken by a request about to be submitted
+        std::atomic<int64_t> streams;
+        // Requests waiting to be submitted on it, drained in batches from its io context.
+        // Each one holds a reference to its context
+        mpsc_ring<request_context*> submissions;
+        std::atomic<bool> draining;
+        // Set while it is open, so that requests go to the other connections otherwise
+        std::atomic<bool> healthy;
+        std::atomic<bool> reconnecting;
+
+        // Tells the notifications and the streams of a replaced connection apart
+        std::atomic<uint64_t> generation;
+        // Only used from the io context of the client. The timer bounds the attempts and the
+        // waits between them
+        bool connecting;
+        unsigned attempts;
+        boost::asio::steady_timer reconnect_timer;
+    };
+
+    // The connections of an endpoint, taking the slots of the pool from the first one on
+    struct endpoint_pool
+    {
+        endpoint_pool(const traffic::endpoint& ep, const bool secure_session,
+                      const std::size_t first, const config::connection_pool& pool_cfg);
+
+        std::string host;
+        std::string port;
+        std::string uri_prefix;
+        std::size_t first;
+        std::size_t slots;
+        // Only the first active connections are opened
+        std::atomic<std::size_t> active;
+        std::atomic<bool> growing;
+        connection_selector selector;
+    };
+
+    // Handlers given to the io context are dropped once the client is gone
+    struct lifetime
+    {
+        std::mutex mtx;
+        bool alive = true;
+    };
+
+    template <typename Handler>
+    auto guarded(Handler&& handler)
+    {
+        return [weak = std::weak_ptr<lifetime>(life),
+                handler = std::forward<Handler>(handler)](auto&&... args) mutable
+        {
+            if (const auto l = weak.lock())
+            {
+                std::scoped_lock guard(l->mtx);
+                if (l->alive)
+                {
+                    handler(std::forward<decltype(args)>(args)...);
+                }
+            }
+        };
+    }
+
+    bool is_connected(const pooled_connection& pc) const;
+    std::shared_ptr<connection> make_connection(const std::size_t index, const uint64_t generation);
+    // Replaces the connection without waiting for it to open, from the io context
+    void open_connection(const std::size_t index);
+    // Reconnects in the background, unless it is already being done
+    void start_reconnect(const std::size_t index);
+    void reconnect(const std::size_t index);
+    void schedule_reconnect(const std::size_t index);
+    void on_status(const std::size_t index, const uint64_t generation,
+                   const connection::status st);
+    void on_connect_failure(const std::size_t index, const uint64_t generation);
+    void send_now(const std::chrono::steady_clock::time_point& intended_time);
+    // The one the script was sent to, or the one chosen for it now
+    std::size_t endpoint_of(traffic::script& s);
+    // Hands the request over to the thread of its connection
+    void enqueue(const std::size_t index, request_context_ptr ctx);
+    // Submits every request waiting, and the one that did not fit in the ring, if any
+    void drain(const std::size_t index, request_context_ptr overflow = nullptr);
+    // Only if it is still the connection the request was sent on
+    void submit(const std::shared_ptr<connection>& conn, const uint64_t generation,
+                request_context_ptr ctx);
+    void on_response(request_context* ctx, const nghttp2::asio_http2::client::response& res);
+    void on_data(request_context* ctx, const uint8_t* data, const std::size_t len);
+    // Sends that fit in the in-flight limits and in the free streams right now
+    int64_t room() const;
+    int64_t in_flight_room() const;
+    int64_t stream_room() const;
+    bool defers() const { return limits.enabled() || pool_config.max_streams > 0; }
+    void defer(const std::chrono::steady_clock::time_point& intended_time);
+    void send_deferred();
+    void notify_room();
+    // Opens one more connection to the endpoint, if its pool may still grow
+    void grow(const std::size_t endpoint);
+    void on_grow_failure(const std::size_t index);
+    // Only if the stream was taken on the connection open now
+    void release_stream(const std::size_t index, const uint64_t generation);
+    void complete(const bool sent);
+    // Accounted as a response time too, since the request was meant to be sent
+    void handle_timeout(const std::size_t index, const std::string& msg_name,
+                        const std::chrono::steady_clock::time_point& intended_time);
+    // The request was lost with its connection before being answered
+    void handle_abandoned(const std::size_t index, const std::string& msg_name);
+    // Index of the connection in the stats
+    std::size_t stats_index(const std::size_t index) const
+    {
+        return pool_config.first_index + index;
+    }
+    // Of the connection and of its endpoint
+    void add_event(const std::size_t index, const stats::connection_event e,
+                   const int64_t service_time = 0);
+    // Taken by the connection, among those of its endpoint
+    bool is_active(const std::size_t index) const
+    {
+        const auto& ep = *endpoints[pool[index]->endpoint];
+        return index - ep.first < ep.active;
+    }
+    // Timeouts of the connections sharing a wheel are told apart by index and generation
+    static uint64_t timeout_owner(const std::size_t index, const uint64_t generation)
+    {
+        return (uint64_t(index) << 32) | uint32_t(generation);
+    }
+    static std::size_t owner_index(const uint64_t owner) { return std::size_t(owner >> 32); }
+    // From the io context of the connection, once it was replaced
+    void abandon_timeouts(const std::size_t index, const uint64_t generation);
+    // From the io context ticking
+    void start_ticking(io_context_pool::context& ctx);
+    void schedule_tick(io_context_pool::context& ctx);
+    void on_tick(io_context_pool::context& ctx, const boost::system::error_code& e);
 
     std::shared_ptr<stats::stats_if> stats;
     boost::asio::io_context& io_ctx;
     std::unique_ptr<traffic::script_queue_if> queue;
-    std::string host;
-    std::string port;
     bool secure_session;
-    std::unique_ptr<connection> conn;
-    std::shared_timed_mutex mtx;
+    completion_handler on_completion;
+
+    // Given back by the streams of the connections, so it outlives them
+    request_context_pool contexts;
+    // Run the connections, so they outlive them too. Torn down first when the client is gone
+    io_context_pool io_contexts;
+
+    config::connection_pool pool_config;
+    // Sized to the capacity of the pool by endpoint, one endpoint after the other
+    std::vector<std::unique_ptr<pooled_connection>> pool;
+    std::vector<std::unique_ptr<endpoint_pool>> endpoints;
+    endpoint_selector endpoint_choice;
+
+    config::in_flight_limits limits;
+    // Requests sent and not over yet
+    std::atomic<int64_t> outstanding;
+    struct deferred_send
+    {
+        std::chrono::steady_clock::time_point intended_time;
+        // Set when it waits for a stream, rather than for the in-flight limits
+        std::optional<std::chrono::steady_clock::time_point> stream_wait_since;
+    };
+    // Sends waiting for room
+    std::deque<deferred_send> deferred;
+    std::mutex deferred_mtx;
+
+    // Spreads the waits between reconnections, only used from the io context
+    std::minstd_rand jitter;
+    std::shared_ptr<lifetime> life;
 };
 
 }  // namespace http2_client
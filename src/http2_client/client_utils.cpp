@@ -1,34 +1,94 @@
 #include "client_utils.hpp"
 
+#include <algorithm>
+
 #include "script.hpp"
 
 namespace http2_client
 {
-std::string build_uri(const std::string& host, const std::string& port, const std::string& uri_path)
+namespace
+{
+// Copying a header map over another reuses its nodes but builds its strings again, so when
+// both have the same names only the values are assigned, keeping their buffers. False if
+// the names differ, and nothing was copied
+bool assign_values(header_map& to, const header_map& from)
+{
+    if (to.size() != from.size() ||
+        !std::equal(from.begin(), from.end(), to.begin(),
+                    [](const auto& f, const auto& t) { return f.first == t.first; }))
+    {
+        return false;
+    }
+
+    auto it = to.begin();
+    for (const auto& [name, value] : from)
+    {
+        it->second.value.assign(value.value);
+        it->second.sensitive = value.sensitive;
+        ++it;
+    }
+    return true;
+}
+}  // namespace
+
+std::string build_uri_prefix(const std::string& host, const std::string& port, const bool secure)
+{
+    return (secure ? "https://" : "http://") + host + ":" + port + "/";
+}
+
+std::string build_uri(const std::string& host, const std::string& port,
+                      const std::string& uri_path, const bool secure)
 {
-    return "http://" + host + ":" + port + "/" + uri_path;
+    return build_uri_prefix(host, port, secure) + uri_path;
 }
 
 header_map build_headers(const std::size_t s, const traffic::msg_headers& h)
 {
-    header_map map = {{CONTENT_TYPE, {APP_JSON, false}},
-                      {CONTENT_LENGTH, {std::to_string(s), false}}};
+    return traffic::build_request_headers(s, h);
+}
+
+request get_next_request(const std::string& host, const std::string& port, const traffic::script& s,
+                         const bool secure)
+{
+    request r;
+    fill_next_request(r, build_uri_prefix(host, port, secure), s);
+    return r;
+}
+
+void fill_next_request(request& r, const std::string& uri_prefix, const traffic::script& s)
+{
+    r.body = s.get_next_body();
+    r.url.assign(uri_prefix).append(s.get_next_url());
+    r.method = s.get_next_method();
+    r.name = s.get_next_msg_name();
 
-    for (const auto& [k, v] : h)
+    const auto* compiled = s.get_next_template();
+    if (!compiled || !compiled->headers)
     {
-        map.emplace(k, header_value{v, false});
+        r.headers = build_headers(r.body.size(), s.get_next_headers());
+        return;
     }
 
-    return map;
+    // The last request of the context was most likely the same message
+    if (!assign_values(r.headers, *compiled->headers))
+    {
+        r.headers = *compiled->headers;
+    }
+    if (r.body.size() != compiled->body_size)
+    {
+        r.headers.find(CONTENT_LENGTH)->second.value = std::to_string(r.body.size());
+    }
 }
 
-request get_next_request(const std::string& host, const std::string& port, const traffic::script& s)
+std::chrono::milliseconds reconnect_backoff(const unsigned attempt, const double jitter)
 {
-    const std::string body = s.get_next_body();
-    const auto map = build_headers(body.size(), s.get_next_headers());
-
-    return request{build_uri(host, port, s.get_next_url()), s.get_next_method(), body, map,
-                   s.get_next_msg_name()};
+    constexpr std::chrono::milliseconds first{100};
+    constexpr std::chrono::milliseconds cap{5000};
+    // Shifting further would only overflow, the cap is reached long before
+    const unsigned doublings = std::min(attempt > 0 ? attempt - 1 : 0u, 16u);
+    const auto ceiling = std::min(cap, first * (1 << doublings));
+    const double spread = std::clamp(jitter, 0.0, 1.0);
+    return ceiling / 2 + std::chrono::milliseconds(int64_t(double(ceiling.count() / 2) * spread));
 }
 
 }  // namespace http2_client
\ No newline at end of file
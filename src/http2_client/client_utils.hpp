@@ -2,9 +2,10 @@
 
 #include <nghttp2/asio_http2.h>
 
-#include <mutex>
+#include <chrono>
 #include <string>
 
+#include "message_template.hpp"
 #include "script_structs.hpp"
 
 namespace traffic
@@ -17,17 +18,9 @@ namespace http2_client
 using nghttp2::asio_http2::header_map;
 using nghttp2::asio_http2::header_value;
 
-inline static const std::string CONTENT_TYPE = "content-type";
-inline static const std::string CONTENT_LENGTH = "content-length";
-inline static const std::string APP_JSON = "application/json";
-
-struct race_control
-{
-    race_control() = default;
-    bool timed_out = false;
-    bool answered = false;
-    std::mutex mtx;
-};
+using traffic::APP_JSON;
+using traffic::CONTENT_LENGTH;
+using traffic::CONTENT_TYPE;
 
 struct request
 {
@@ -46,10 +39,23 @@ enum class method
     DELETE
 };
 
+// scheme://host:port/, the part of the URI shared by all the requests of a client
+std::string build_uri_prefix(const std::string& host, const std::string& port,
+                             const bool secure = false);
 std::string build_uri(const std::string& host, const std::string& port,
-                      const std::string& uri_path);
+                      const std::string& uri_path, const bool secure = false);
 header_map build_headers(const std::size_t s, const traffic::msg_headers& h);
 request get_next_request(const std::string& host, const std::string& port,
-                         const traffic::script& s);
+                         const traffic::script& s, const bool secure = false);
+// Same as get_next_request, reusing the buffers of the given request and the template of
+// the message, so that only its dynamic parts are built
+void fill_next_request(request& r, const std::string& uri_prefix, const traffic::script& s);
+
+/**
+ * Wait before the given reconnection attempt, counted from 1. It doubles with
+ * every attempt up to a cap, and only its upper half is spread by the jitter,
+ * in [0, 1), so that connections lost together do not retry in lockstep.
+ */
+std::chrono::milliseconds reconnect_backoff(const unsigned attempt, const double jitter);
 
 }  // namespace http2_client
\ No newline at end of file
@@ -2,6 +2,9 @@
 
 #include <boost/asio/ip/tcp.hpp>
 #include <iostream>
+#include <utility>
+
+#include "tls_context.hpp"
 
 using boost::asio::ip::tcp;
 using nghttp2::asio_http2::client::session;
@@ -14,11 +17,8 @@ nghttp2::asio_http2::client::session create_session(boost::asio::io_service& io_
 {
     if (secure_session)
     {
-        boost::system::error_code ec;
-        boost::asio::ssl::context tls_ctx(boost::asio::ssl::context::sslv23);
-        tls_ctx.set_default_verify_paths();
-        nghttp2::asio_http2::client::configure_tls_context(ec, tls_ctx);
-        return nghttp2::asio_http2::client::session(io_service, tls_ctx, h, p);
+        return nghttp2::asio_http2::client::session(
+            io_service, http2_client::tls_context::shared().native(h, p), h, p);
     }
 
     return nghttp2::asio_http2::client::session(io_service, h, p);
@@ -27,70 +27,108 @@ nghttp2::asio_http2::client::session create_session(boost::asio::io_service& io_
 
 namespace http2_client
 {
-connection::connection(const std::string& h, const std::string& p, bool secure_session)
-    : svc_work(boost::asio::io_service::work(io_service)),
-      session(create_session(io_service, h, p, secure_session))
+connection::connection(boost::asio::io_context& io_ctx, const std::string& h, const std::string& p,
+                       bool secure_session, status_callback on_status)
+    : io_ctx(io_ctx),
+      session(std::make_shared<nghttp2::asio_http2::client::session>(
+          create_session(io_ctx, h, p, secure_session))),
+      state(std::make_shared<shared_state>())
 {
-    session.on_connect(
-        [this, h, p](tcp::resolver::iterator)
+    state->on_status = std::move(on_status);
+
+    session->on_connect(
+        [st = state, h, p](tcp::resolver::iterator)
         {
             std::cerr << "Connected to " << h << ":" << p << std::endl;
-            connection_status = status::OPEN;
-            status_change_cond_var.notify_one();
+            st->opened();
         });
 
-    session.on_error(
-        [this, h, p](const boost::system::error_code& ec)
+    session->on_error(
+        [st = state, h, p](const boost::system::error_code& ec)
         {
             std::cerr << "Error in connection to " << h << ":" << p
                       << " Message: " << ec.message().c_str() << std::endl;
-            notify_close();
+            st->closed();
         });
-
-    worker = std::thread([this] { io_service.run(); });
 }
 
 connection::~connection()
 {
-    io_service.stop();
+    std::scoped_lock lock(state->mtx);
+    state->on_status = nullptr;
+    state->abandoned = true;
 
-    if (worker.joinable())
+    if (state->connection_status == status::NOT_OPEN)
+    {
+        state->orphan = std::move(session);
+    }
+    else if (state->connection_status == status::OPEN && !io_ctx.stopped())
     {
-        worker.join();
+        boost::asio::post(io_ctx, [s = std::move(session)]() { s->shutdown(); });
     }
+}
 
-    if (connection_status == status::OPEN)
+void connection::shared_state::opened()
+{
+    std::unique_lock lock(mtx);
+    if (abandoned)
     {
-        session.shutdown();
+        auto s = std::move(orphan);
+        lock.unlock();
+        if (s)
+        {
+            s->shutdown();
+        }
+        return;
     }
+    notify(status::OPEN);
 }
 
-void connection::notify_close()
+void connection::shared_state::closed()
 {
-    connection_status = status::CLOSED;
-    status_change_cond_var.notify_one();
+    std::unique_lock lock(mtx);
+    if (abandoned)
+    {
+        auto s = std::move(orphan);
+        lock.unlock();
+        return;
+    }
+    notify(status::CLOSED);
+}
+
+void connection::shared_state::notify(const status st)
+{
+    connection_status = st;
+    status_change_cond_var.notify_all();
+    if (on_status)
+    {
+        on_status(st);
+    }
 }
 
 void connection::close()
 {
-    session.shutdown();
-    notify_close();
+    // The session is only used from the thread of its io context
+    boost::asio::post(io_ctx, [s = session]() { s->shutdown(); });
+    std::scoped_lock lock(state->mtx);
+    state->notify(status::CLOSED);
 }
 
 bool connection::wait_to_be_connected()
 {
-    std::unique_lock lock(mtx);
-    status_change_cond_var.wait_for(lock, std::chrono::duration<int, std::milli>(2000),
-                                    [this] { return (connection_status != status::NOT_OPEN); });
-    return (connection_status == status::OPEN);
+    std::unique_lock lock(state->mtx);
+    state->status_change_cond_var.wait_for(
+        lock, std::chrono::duration<int, std::milli>(2000),
+        [this] { return (state->connection_status != status::NOT_OPEN); });
+    return (state->connection_status == status::OPEN);
 }
 
 bool connection::wait_for_status(const std::chrono::duration<int, std::milli>& max_time,
                                  const status& st)
 {
-    std::unique_lock lock(mtx);
-    return status_change_cond_var.wait_for(lock, max_time,
-                                           [this, &st] { return connection_status == st; });
+    std::unique_lock lock(state->mtx);
+    return state->status_change_cond_var.wait_for(
+        lock, max_time, [this, &st] { return state->connection_status == st; });
 }
 
 }  // namespace http2_client
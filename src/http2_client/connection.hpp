@@ -2,10 +2,14 @@
 
 #include <nghttp2/asio_http2_client.h>
 
+#include <atomic>
+#include <boost/asio.hpp>
 #include <chrono>
+#include <condition_variable>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
-#include <thread>
 
 namespace nghttp2::asio_http2::client
 {
@@ -17,6 +21,11 @@ namespace http2_client
 class connection;
 using connection_callback = std::function<void(connection&)>;
 
+/**
+ * An HTTP/2 session run by an io context the connection does not own, and
+ * that other connections may share. The session may outlive the connection
+ * in that io context, so whatever its callbacks use is kept apart.
+ */
 class connection
 {
 public:
@@ -30,7 +39,11 @@ public:
         CLOSED
     };
 
-    connection(const std::string& host, const std::string& port, const bool secure_session = false);
+    // Called from the thread of the io context once it opens or closes
+    using status_callback = std::function<void(status)>;
+
+    connection(boost::asio::io_context& io_ctx, const std::string& host, const std::string& port,
+               const bool secure_session = false, status_callback on_status = {});
 
     connection(const connection& o) = delete;
     connection(connection&& o) = delete;
@@ -40,29 +53,37 @@ public:
     connection& operator=(const connection& o) = delete;
     connection& operator=(connection&& o) = delete;
 
-    nghttp2::asio_http2::client::session& get_session() { return session; };
-    const status& get_status() const { return connection_status; };
+    nghttp2::asio_http2::client::session& get_session() { return *session; };
+    status get_status() const { return state->connection_status; };
     bool wait_to_be_connected();
     void close();
 
     bool wait_for_status(const std::chrono::duration<int, std::milli>& max_time, const status& st);
 
 private:
-    void close_impl();
-    void notify_close();
+    // Shared with the callbacks of the session
+    struct shared_state
+    {
+        void opened();
+        void closed();
+        void notify(const status st);
+
+        std::atomic<status> connection_status{status::NOT_OPEN};
+        status_callback on_status;
+        // The connection is gone. If it was still opening, the session is kept here until
+        // it opens, to shut it down, or until it fails
+        bool abandoned = false;
+        std::shared_ptr<nghttp2::asio_http2::client::session> orphan;
+
+        std::mutex mtx;
+        std::condition_variable status_change_cond_var;
+    };
 
     /// ASIO attributes
-    boost::asio::io_service io_service;
-    boost::asio::io_service::work svc_work;
-    nghttp2::asio_http2::client::session session;
-
-    /// Class attributes
-    status connection_status = status::NOT_OPEN;
+    boost::asio::io_context& io_ctx;
+    std::shared_ptr<nghttp2::asio_http2::client::session> session;
 
-    /// Concurrency attributes
-    std::mutex mtx;
-    std::thread worker;
-    std::condition_variable status_change_cond_var;
+    std::shared_ptr<shared_state> state;
 };
 
 }  // namespace http2_client
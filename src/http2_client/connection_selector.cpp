@@ -0,0 +1,82 @@
+#include "connection_selector.hpp"
+
+namespace
+{
+// splitmix64, to turn consecutive turns into unrelated random numbers
+uint64_t mix(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+}  // namespace
+
+namespace http2_client
+{
+connection_selector::connection_selector(const config::connection_selection selection)
+    : selection(selection), turns(0)
+{
+}
+
+std::size_t connection_selector::select(const std::size_t size, const outstanding_fn& outstanding,
+                                        const int64_t max_outstanding)
+{
+    const uint64_t turn = turns.fetch_add(1, std::memory_order_relaxed);
+    if (size < 2)
+    {
+        return 0;
+    }
+
+    std::size_t chosen{0};
+    switch (selection)
+    {
+        case config::connection_selection::LEAST_OUTSTANDING:
+            return least_outstanding(size, outstanding, turn);
+        case config::connection_selection::TWO_CHOICES:
+            chosen = two_choices(size, outstanding, turn);
+            break;
+        default:
+            chosen = std::size_t(turn % size);
+            break;
+    }
+
+    // A full connection is only taken if all of them are
+    for (std::size_t i = 0; i < size && outstanding(chosen) >= max_outstanding; ++i)
+    {
+        chosen = (chosen + 1) % size;
+    }
+    return chosen;
+}
+
+std::size_t connection_selector::least_outstanding(const std::size_t size,
+                                                   const outstanding_fn& outstanding,
+                                                   const uint64_t turn)
+{
+    // Ties are broken in turns, so that idle connections are not all left but the first
+    const std::size_t first = std::size_t(turn % size);
+    std::size_t best{first};
+    int64_t fewest{outstanding(first)};
+    for (std::size_t i = 1; i < size && fewest > 0; ++i)
+    {
+        const std::size_t candidate = (first + i) % size;
+        if (const int64_t n = outstanding(candidate); n < fewest)
+        {
+            best = candidate;
+            fewest = n;
+        }
+    }
+    return best;
+}
+
+std::size_t connection_selector::two_choices(const std::size_t size,
+                                             const outstanding_fn& outstanding,
+                                             const uint64_t turn)
+{
+    const uint64_t random = mix(turn);
+    const std::size_t first = std::size_t(random % size);
+    // Another one, different from the first
+    const std::size_t second = (first + 1 + std::size_t((random >> 32) % (size - 1))) % size;
+    return outstanding(second) < outstanding(first) ? second : first;
+}
+}  // namespace http2_client
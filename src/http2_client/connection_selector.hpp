@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+
+#include "connection_pool.hpp"
+
+namespace http2_client
+{
+/**
+ * Chooses the connection of a pool every request goes through. It is thread
+ * safe and lock free: the random choices are derived from a counter, so they
+ * are also reproducible. The pool may grow, so its size is given every time.
+ */
+class connection_selector
+{
+public:
+    // Streams open on the connection with the given index
+    using outstanding_fn = std::function<int64_t(std::size_t)>;
+
+    explicit connection_selector(const config::connection_selection selection);
+
+    // A connection with less than max_outstanding streams open, if there is any
+    std::size_t select(const std::size_t size, const outstanding_fn& outstanding,
+                       const int64_t max_outstanding = std::numeric_limits<int64_t>::max());
+
+private:
+    static std::size_t least_outstanding(const std::size_t size, const outstanding_fn& outstanding,
+                                         const uint64_t turn);
+    static std::size_t two_choices(const std::size_t size, const outstanding_fn& outstanding,
+                                   const uint64_t turn);
+
+    config::connection_selection selection;
+    std::atomic<uint64_t> turns;
+};
+}  // namespace http2_client
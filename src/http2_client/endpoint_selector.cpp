@@ -0,0 +1,91 @@
+#include "endpoint_selector.hpp"
+
+#include <algorithm>
+
+namespace
+{
+// Points of every unit of weight on the hash ring
+constexpr unsigned ring_points{64};
+
+// FNV-1a, stable across runs and platforms, unlike std::hash
+uint64_t fnv1a(const std::string& s)
+{
+    uint64_t h{0xcbf29ce484222325ULL};
+    for (const unsigned char c : s)
+    {
+        h = (h ^ c) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// splitmix64 finalizer, so that close keys land far apart on the ring
+uint64_t mix(uint64_t x)
+{
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+}  // namespace
+
+namespace http2_client
+{
+endpoint_selector::endpoint_selector(const std::vector<traffic::endpoint>& eps,
+                                     const traffic::endpoint_selection& selection)
+    : endpoints(eps.size()), policy(selection.policy), total_weight(0), current(eps.size(), 0)
+{
+    for (const auto& ep : eps)
+    {
+        weights.push_back(std::clamp(ep.weight, 1u, traffic::max_endpoint_weight));
+        total_weight += weights.back();
+    }
+
+    if (policy == traffic::endpoint_policy::HASH)
+    {
+        // Points depend on the weight of their endpoint only, as the rest may change
+        for (std::size_t i = 0; i < eps.size(); ++i)
+        {
+            const std::string name = eps[i].dns + ":" + eps[i].port + "#";
+            for (int64_t point = 0; point < weights[i] * ring_points; ++point)
+            {
+                ring.emplace_back(mix(fnv1a(name + std::to_string(point))), i);
+            }
+        }
+        std::sort(ring.begin(), ring.end());
+    }
+}
+
+std::size_t endpoint_selector::select(const std::string& key)
+{
+    if (endpoints < 2)
+    {
+        return 0;
+    }
+    if (policy == traffic::endpoint_policy::HASH && !key.empty())
+    {
+        return hashed(key);
+    }
+
+    // Smooth weighted round robin: every turn adds the weights, and the highest pays the total.
+    // Weights 2 and 4 take the same turns as 1 and 2 do
+    std::scoped_lock guard(mtx);
+    std::size_t best{0};
+    for (std::size_t i = 0; i < endpoints; ++i)
+    {
+        current[i] += weights[i];
+        if (current[i] > current[best])
+        {
+            best = i;
+        }
+    }
+    current[best] -= total_weight;
+    return best;
+}
+
+std::size_t endpoint_selector::hashed(const std::string& key) const
+{
+    const uint64_t h = mix(fnv1a(key));
+    // The first point clockwise from the key, wrapping around
+    auto it = std::lower_bound(ring.begin(), ring.end(), std::make_pair(h, std::size_t{0}));
+    return it == ring.end() ? ring.front().second : it->second;
+}
+}  // namespace http2_client
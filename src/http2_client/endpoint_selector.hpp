@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "script_structs.hpp"
+
+namespace http2_client
+{
+/**
+ * Chooses the endpoint every script goes to. Weighted round robin interleaves
+ * the endpoints as smooth weighted round robin does, one turn at a time, so
+ * nothing grows with the weights. Consistent hashing places every endpoint on
+ * a ring as many times as its weight, so that a key keeps its endpoint when
+ * the others change.
+ */
+class endpoint_selector
+{
+public:
+    endpoint_selector(const std::vector<traffic::endpoint>& endpoints,
+                      const traffic::endpoint_selection& selection);
+
+    // Scripts without a key are spread by weight, whatever the policy
+    std::size_t select(const std::string& key);
+
+    std::size_t size() const { return endpoints; }
+
+private:
+    std::size_t hashed(const std::string& key) const;
+
+    std::size_t endpoints;
+    traffic::endpoint_policy policy;
+    // Capped to the highest weight allowed
+    std::vector<int64_t> weights;
+    int64_t total_weight;
+    // What every endpoint is owed, taken by the highest on every turn
+    std::vector<int64_t> current;
+    std::mutex mtx;
+    // Sorted by hash
+    std::vector<std::pair<uint64_t, std::size_t>> ring;
+};
+}  // namespace http2_client
@@ -0,0 +1,68 @@
+#include "io_context_pool.hpp"
+
+#include <algorithm>
+
+namespace http2_client
+{
+io_context_pool::context::context(const timeout_wheel::time_point& start,
+                                  std::chrono::milliseconds tick)
+    // A single thread per context, so its handlers never run concurrently
+    : io(1),
+      timeouts(start, tick),
+      tick_timer(io),
+      ticking(false)
+{
+}
+
+io_context_pool::io_context_pool(const std::size_t threads, std::chrono::milliseconds tick)
+    : turns(0)
+{
+    const std::size_t count =
+        threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        auto& ctx = contexts.emplace_back(std::make_unique<context>(start, tick));
+        guards.push_back(boost::asio::make_work_guard(ctx->io));
+    }
+    for (auto& ctx : contexts)
+    {
+        workers.emplace_back([&io_ctx = ctx->io]() { io_ctx.run(); });
+    }
+}
+
+io_context_pool::~io_context_pool()
+{
+    stop();
+}
+
+void io_context_pool::stop()
+{
+    // Sessions keep reading while they are open, so the contexts never run out of work
+    for (std::size_t i = 0; i < contexts.size(); ++i)
+    {
+        guards[i].reset();
+        contexts[i]->io.stop();
+    }
+    for (auto& worker : workers)
+    {
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+    }
+}
+
+void io_context_pool::shutdown()
+{
+    stop();
+    workers.clear();
+    guards.clear();
+    contexts.clear();
+}
+
+io_context_pool::context& io_context_pool::next()
+{
+    return *contexts[turns.fetch_add(1, std::memory_order_relaxed) % contexts.size()];
+}
+}  // namespace http2_client
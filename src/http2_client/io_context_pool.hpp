@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "timeout_wheel.hpp"
+
+namespace http2_client
+{
+/**
+ * A fixed set of io contexts for the connections to share, each one run by
+ * its own thread, as if it were a core. Every connection is given one in
+ * turns, and its session, its stream callbacks and its timers all run there.
+ * Every context keeps the timeouts of the requests sent from it in a single
+ * wheel, with one coarse tick for all of them.
+ */
+class io_context_pool
+{
+public:
+    struct context
+    {
+        context(const timeout_wheel::time_point& start, std::chrono::milliseconds tick);
+
+        boost::asio::io_context io;
+        // Only touched from the thread of the context
+        timeout_wheel timeouts;
+        boost::asio::steady_timer tick_timer;
+        // Set while the timer waits for the next tick
+        bool ticking;
+    };
+
+    // 0 threads means one per core
+    explicit io_context_pool(const std::size_t threads = 0,
+                             std::chrono::milliseconds tick = std::chrono::milliseconds(10));
+
+    io_context_pool(const io_context_pool&) = delete;
+    io_context_pool& operator=(const io_context_pool&) = delete;
+
+    ~io_context_pool();
+
+    // Stops every io context and waits for its thread, dropping what is left to run
+    void stop();
+    // Stops and destroys every io context, and with them the handlers left and what they hold.
+    // Nothing can be run in the pool anymore
+    void shutdown();
+
+    context& next();
+    std::size_t size() const { return contexts.size(); }
+
+private:
+    using work_guard = boost::asio::executor_work_guard<boost::asio::io_context::executor_type>;
+
+    std::vector<std::unique_ptr<context>> contexts;
+    std::vector<work_guard> guards;
+    std::vector<std::thread> workers;
+    std::atomic<std::size_t> turns;
+};
+}  // namespace http2_client
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace http2_client
+{
+/**
+ * Bounded lock-free queue for many producers and a single consumer. Every
+ * cell carries a sequence number telling whether it is free for the producer
+ * of a lap or ready for the consumer, so producers only contend on the tail
+ * index, and nothing is allocated once it is built.
+ * A push may be seen by the consumer slightly after a later one, while its
+ * producer is between taking the cell and filling it.
+ */
+template <typename T>
+class mpsc_ring
+{
+public:
+    // Rounded up to a power of two
+    explicit mpsc_ring(const std::size_t capacity) : mask(round_up(capacity) - 1)
+    {
+        cells = std::make_unique<cell[]>(mask + 1);
+        for (std::size_t i = 0; i <= mask; ++i)
+        {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    mpsc_ring(const mpsc_ring&) = delete;
+    mpsc_ring& operator=(const mpsc_ring&) = delete;
+
+    // From any thread. False if the ring is full
+    bool push(const T& value)
+    {
+        std::size_t pos = tail.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell& c = cells[pos & mask];
+            const std::size_t sequence = c.sequence.load(std::memory_order_acquire);
+            const auto lap = intptr_t(sequence) - intptr_t(pos);
+            if (lap == 0)
+            {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    c.value = value;
+                    c.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (lap < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Only from the consumer. False if there is nothing ready
+    bool pop(T& value)
+    {
+        cell& c = cells[head & mask];
+        if (c.sequence.load(std::memory_order_acquire) != head + 1)
+        {
+            return false;
+        }
+        value = c.value;
+        // Free for the producers of the next lap
+        c.sequence.store(head + mask + 1, std::memory_order_release);
+        ++head;
+        return true;
+    }
+
+    std::size_t capacity() const { return mask + 1; }
+
+private:
+    static std::size_t round_up(const std::size_t n)
+    {
+        std::size_t p{1};
+        while (p < n)
+        {
+            p <<= 1;
+        }
+        return p;
+    }
+
+    struct cell
+    {
+        std::atomic<std::size_t> sequence;
+        T value{};
+    };
+
+    const std::size_t mask;
+    std::unique_ptr<cell[]> cells;
+    // Apart, so that producers do not bounce the line the consumer works on
+    alignas(64) std::atomic<std::size_t> tail{0};
+    alignas(64) std::size_t head{0};
+};
+}  // namespace http2_client
@@ -0,0 +1,73 @@
+#include "request_context.hpp"
+
+namespace http2_client
+{
+void request_context::clear()
+{
+    req.url.clear();
+    req.method.clear();
+    req.body.clear();
+    // Headers are kept, the next request copies its own over them reusing their buffers
+    req.name.clear();
+    script.reset();
+    span = nullptr;
+    response = nullptr;
+    answer.clear();
+    keep_answer = true;
+    keep_headers = true;
+    answer_bytes = 0;
+    timeout = {};
+    index = 0;
+    generation = 0;
+}
+
+void intrusive_ptr_add_ref(request_context* ctx)
+{
+    ctx->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void intrusive_ptr_release(request_context* ctx)
+{
+    if (ctx->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        ctx->owner->give_back(ctx);
+    }
+}
+
+request_context_ptr request_context_pool::acquire()
+{
+    std::scoped_lock guard(mtx);
+    if (free_contexts.empty())
+    {
+        auto& ctx = contexts.emplace_back(std::make_unique<request_context>());
+        ctx->owner = this;
+        // So that giving every context back never allocates
+        free_contexts.reserve(contexts.capacity());
+        return request_context_ptr(ctx.get());
+    }
+
+    request_context* ctx = free_contexts.back();
+    free_contexts.pop_back();
+    return request_context_ptr(ctx);
+}
+
+void request_context_pool::give_back(request_context* ctx)
+{
+    // Released outside the lock: the script and the span may free memory of their own
+    ctx->clear();
+    std::scoped_lock guard(mtx);
+    free_contexts.push_back(ctx);
+}
+
+std::size_t request_context_pool::size() const
+{
+    std::scoped_lock guard(mtx);
+    return contexts.size();
+}
+
+std::size_t request_context_pool::available() const
+{
+    std::scoped_lock guard(mtx);
+    return free_contexts.size();
+}
+}  // namespace http2_client
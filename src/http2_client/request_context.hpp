@@ -0,0 +1,97 @@
+#pragma once
+
+#include <nghttp2/asio_http2_client.h>
+
+#include <atomic>
+#include <boost/intrusive_ptr.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "client_utils.hpp"
+#include "opentelemetry/nostd/shared_ptr.h"
+#include "opentelemetry/trace/span.h"
+#include "timeout_wheel.hpp"
+
+namespace traffic
+{
+class script;
+}
+
+namespace http2_client
+{
+class request_context_pool;
+
+/**
+ * Everything a request needs from the moment it is sent until its stream is
+ * closed. Contexts are pooled and intrusively counted, so the callbacks of the
+ * stream just borrow a pointer, small enough for std::function not to allocate.
+ * Buffers are cleared but keep their capacity when given back to the pool.
+ */
+struct request_context
+{
+    using time_point = std::chrono::steady_clock::time_point;
+
+    request req;
+    std::shared_ptr<traffic::script> script;
+    opentelemetry::nostd::shared_ptr<opentelemetry::trace::Span> span;
+    time_point intended_time;
+    time_point init_time;
+    time_point answer_time;
+    timeout_wheel::handle timeout;
+    // Set once the answer is received, and valid until the stream is closed
+    const nghttp2::asio_http2::client::response* response = nullptr;
+    // Kept only if the script needs it. Its buffer is reused by the next requests
+    std::string answer;
+    bool keep_answer = true;
+    bool keep_headers = true;
+    std::size_t answer_bytes = 0;
+    // Connection of the pool it is sent on, and which one of those opened in it
+    std::size_t index = 0;
+    uint64_t generation = 0;
+
+private:
+    friend class request_context_pool;
+    friend void intrusive_ptr_add_ref(request_context* ctx);
+    friend void intrusive_ptr_release(request_context* ctx);
+
+    void clear();
+
+    std::atomic<uint32_t> refs{0};
+    request_context_pool* owner = nullptr;
+};
+
+using request_context_ptr = boost::intrusive_ptr<request_context>;
+
+void intrusive_ptr_add_ref(request_context* ctx);
+void intrusive_ptr_release(request_context* ctx);
+
+/**
+ * Hands out request contexts, creating them only when all of them are in use.
+ * Contexts are given back when their last reference is dropped, from any thread.
+ * Those still referenced, as the ones of streams lost with their connection,
+ * are not reused, and are freed with the pool.
+ */
+class request_context_pool
+{
+public:
+    request_context_ptr acquire();
+
+    // Contexts created so far
+    std::size_t size() const;
+    // Contexts ready to be handed out
+    std::size_t available() const;
+
+private:
+    friend void intrusive_ptr_release(request_context* ctx);
+    void give_back(request_context* ctx);
+
+    mutable std::mutex mtx;
+    std::vector<std::unique_ptr<request_context>> contexts;
+    std::vector<request_context*> free_contexts;
+};
+}  // namespace http2_client
@@ -0,0 +1,188 @@
+#include "timeout_wheel.hpp"
+
+#include <algorithm>
+
+namespace http2_client
+{
+timeout_wheel::timeout_wheel(const time_point& start, std::chrono::milliseconds tick,
+                             std::size_t slot_count)
+    : start(start),
+      tick(tick),
+      mask(0),
+      last_tick(0),
+      free_list(none),
+      armed(0)
+{
+    // A power of two, so that the slot of a tick is just a mask away
+    std::size_t size{1};
+    while (size < slot_count)
+    {
+        size <<= 1;
+    }
+    mask = size - 1;
+    slots.assign(size, none);
+}
+
+uint64_t timeout_wheel::tick_of(const time_point& t) const
+{
+    return t > start ? uint64_t((t - start) / tick) : 0;
+}
+
+void timeout_wheel::link(uint32_t index)
+{
+    auto& e = entries[index];
+    auto& head = slots[e.deadline & mask];
+    e.prev = none;
+    e.next = head;
+    if (head != none)
+    {
+        entries[head].prev = index;
+    }
+    head = index;
+}
+
+void timeout_wheel::unlink(uint32_t index)
+{
+    auto& e = entries[index];
+    if (e.prev != none)
+    {
+        entries[e.prev].next = e.next;
+    }
+    else
+    {
+        slots[e.deadline & mask] = e.next;
+    }
+
+    if (e.next != none)
+    {
+        entries[e.next].prev = e.prev;
+    }
+}
+
+void timeout_wheel::release(uint32_t index)
+{
+    unlink(index);
+    auto& e = entries[index];
+    e.armed = false;
+    ++e.generation;
+    e.next = free_list;
+    free_list = index;
+    --armed;
+}
+
+void timeout_wheel::expire(uint32_t index, std::vector<expiry>& expired)
+{
+    expired.push_back({entries[index].owner, entries[index].id, entries[index].origin});
+    release(index);
+}
+
+void timeout_wheel::notify(std::vector<expiry>& expired, const handler& on_expiry)
+{
+    for (const auto& e : expired)
+    {
+        on_expiry(e.owner, *e.id, e.origin);
+    }
+
+    expired.clear();
+    if (expired.capacity() > expired_buffer.capacity())
+    {
+        expired_buffer.swap(expired);
+    }
+}
+
+timeout_wheel::handle timeout_wheel::arm(const time_point& now, std::chrono::milliseconds timeout,
+                                         const std::string& id, const time_point& origin,
+                                         const uint64_t owner)
+{
+    uint32_t index{free_list};
+    if (index != none)
+    {
+        free_list = entries[index].next;
+    }
+    else
+    {
+        index = uint32_t(entries.size());
+        entries.emplace_back();
+    }
+
+    auto& e = entries[index];
+    // Rounded up, so that it never expires early
+    const auto since_start =
+        std::max<std::chrono::steady_clock::duration>(now + timeout - start, {});
+    const auto deadline = uint64_t((since_start + tick - std::chrono::nanoseconds(1)) / tick);
+    e.deadline = std::max(deadline, last_tick + 1);
+    e.armed = true;
+    e.id = &id;
+    e.origin = origin;
+    e.owner = owner;
+    link(index);
+    ++armed;
+    return {index, e.generation};
+}
+
+bool timeout_wheel::cancel(const handle& h)
+{
+    if (h.index >= entries.size())
+    {
+        return false;
+    }
+
+    auto& e = entries[h.index];
+    if (!e.armed || e.generation != h.generation)
+    {
+        return false;
+    }
+
+    release(h.index);
+    return true;
+}
+
+void timeout_wheel::advance(const time_point& now, const handler& on_expiry)
+{
+    const uint64_t target = tick_of(now);
+    if (target <= last_tick)
+    {
+        return;
+    }
+    std::vector<expiry> expired;
+    expired.swap(expired_buffer);
+
+    // After a long stall, every slot is visited once
+    const uint64_t steps = std::min(target - last_tick, mask + 1);
+    for (uint64_t t = last_tick + 1; t <= last_tick + steps; ++t)
+    {
+        for (uint32_t i = slots[t & mask]; i != none;)
+        {
+            const uint32_t next = entries[i].next;
+            if (entries[i].deadline <= target)
+            {
+                expire(i, expired);
+            }
+            i = next;
+        }
+    }
+    last_tick = target;
+
+    notify(expired, on_expiry);
+}
+
+void timeout_wheel::expire_all(const uint64_t owner, const handler& on_expiry)
+{
+    std::vector<expiry> expired;
+    expired.swap(expired_buffer);
+    for (uint32_t i = 0; i < entries.size(); ++i)
+    {
+        if (entries[i].armed && entries[i].owner == owner)
+        {
+            expire(i, expired);
+        }
+    }
+
+    notify(expired, on_expiry);
+}
+
+std::size_t timeout_wheel::size() const
+{
+    return armed;
+}
+}  // namespace http2_client
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace http2_client
+{
+/**
+ * Hashed timing wheel for the timeouts of the requests sent from an io
+ * context. Time is split in ticks, and every timeout is linked in the slot of the tick it
+ * expires in, so arming and cancelling are O(1), and every tick only visits
+ * its own slot. Entries are pooled and reused, and they are linked through
+ * indexes, and ids are kept by reference, so once warmed up the wheel does
+ * not allocate.
+ * Timeouts never expire early, and they may expire up to one tick late.
+ * It is not thread safe: it is only used from the thread of its io context.
+ */
+class timeout_wheel
+{
+public:
+    using time_point = std::chrono::steady_clock::time_point;
+    // Receives the owner, the id and the origin given when the timeout was armed
+    using handler =
+        std::function<void(uint64_t owner, const std::string& id, const time_point& origin)>;
+
+    // Identifies an armed timeout. It stays valid, and harmless, once the entry is reused
+    struct handle
+    {
+        uint32_t index = 0;
+        uint32_t generation = 0;
+    };
+
+    timeout_wheel(const time_point& start, std::chrono::milliseconds tick,
+                  std::size_t slots = 1024);
+
+    // The id is kept by reference, so it has to outlive the timeout. The origin is just given
+    // back on expiry, as the time the wait is measured from, and so is the owner, which tells
+    // apart those sharing the wheel
+    handle arm(const time_point& now, std::chrono::milliseconds timeout, const std::string& id,
+               const time_point& origin, uint64_t owner = 0);
+    handle arm(const time_point& now, std::chrono::milliseconds timeout, std::string&& id,
+               const time_point& origin, uint64_t owner = 0) = delete;
+
+    // True if the timeout was still armed. Then, it will not expire anymore
+    bool cancel(const handle& h);
+
+    // Expires every timeout due by now. The handler is called once the wheel is up to date
+    void advance(const time_point& now, const handler& on_expiry);
+
+    // Expires every timeout armed by the owner at once, whatever its due time
+    void expire_all(uint64_t owner, const handler& on_expiry);
+
+    std::size_t size() const;
+
+private:
+    static constexpr uint32_t none = UINT32_MAX;
+
+    struct entry
+    {
+        uint64_t deadline = 0;  // tick
+        uint32_t prev = none;
+        uint32_t next = none;
+        uint32_t generation = 0;
+        bool armed = false;
+        const std::string* id = nullptr;
+        time_point origin;
+        uint64_t owner = 0;
+    };
+
+    struct expiry
+    {
+        uint64_t owner;
+        const std::string* id;
+        time_point origin;
+    };
+
+    uint64_t tick_of(const time_point& t) const;
+    void link(uint32_t index);
+    void unlink(uint32_t index);
+    // Unlinks an entry and gives it back to the pool
+    void release(uint32_t index);
+    // Unlinks and frees an entry, keeping its id and origin in expired
+    void expire(uint32_t index, std::vector<expiry>& expired);
+    // Calls the handler for every id expired, and keeps the buffer for the next expiries
+    void notify(std::vector<expiry>& expired, const handler& on_expiry);
+
+    time_point start;
+    std::chrono::steady_clock::duration tick;
+    uint64_t mask;
+    uint64_t last_tick;
+    std::vector<uint32_t> slots;
+    std::vector<entry> entries;
+    uint32_t free_list;
+    std::size_t armed;
+    // Taken while expiring timeouts, so that the handlers may arm new ones meanwhile
+    std::vector<expiry> expired_buffer;
+};
+}  // namespace http2_client
@@ -0,0 +1,244 @@
+#include "tls_context.hpp"
+
+#include <nghttp2/asio_http2_client.h>
+
+#include <chrono>
+#include <stdexcept>
+#include <string>
+
+using namespace std::chrono;
+
+namespace http2_client
+{
+namespace
+{
+// Kept in the SSL object of every connection while it lives
+struct handshake_record
+{
+    steady_clock::time_point start;
+    bool reported = false;
+};
+
+void free_record(void*, void* ptr, CRYPTO_EX_DATA*, int, long, void*)
+{
+    delete static_cast<handshake_record*>(ptr);
+}
+
+int record_index()
+{
+    static const int index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, free_record);
+    return index;
+}
+
+// The app data of the context is taken by boost for its verify callback
+int target_index()
+{
+    static const int index = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+    return index;
+}
+
+std::string target_key(const std::string& host, const std::string& port)
+{
+    return host + ":" + port;
+}
+
+std::mutex shared_mtx;
+std::unique_ptr<tls_context> shared_ctx;
+}  // namespace
+
+tls_context::target::target(tls_context& owner, const config::tls& settings)
+    : owner(owner), ctx(boost::asio::ssl::context::sslv23)
+{
+    boost::system::error_code ec;
+    ctx.set_default_verify_paths(ec);
+    nghttp2::asio_http2::client::configure_tls_context(ec, ctx);
+
+    auto* handle = ctx.native_handle();
+    if (!settings.ca_file.empty())
+    {
+        ctx.load_verify_file(settings.ca_file, ec);
+        if (ec)
+        {
+            throw std::invalid_argument("Could not load CA file " + settings.ca_file + ": " +
+                                        ec.message());
+        }
+    }
+    if (!settings.ciphers.empty() && SSL_CTX_set_cipher_list(handle, settings.ciphers.c_str()) != 1)
+    {
+        throw std::invalid_argument("Wrong TLS ciphers: " + settings.ciphers);
+    }
+    if (!settings.suites.empty() && SSL_CTX_set_ciphersuites(handle, settings.suites.c_str()) != 1)
+    {
+        throw std::invalid_argument("Wrong TLS 1.3 cipher suites: " + settings.suites);
+    }
+
+    // In wire format, every protocol preceded by its length
+    std::string protocols;
+    for (const auto& protocol : settings.alpn)
+    {
+        protocols += char(protocol.size());
+        protocols += protocol;
+    }
+    if (SSL_CTX_set_alpn_protos(handle, reinterpret_cast<const unsigned char*>(protocols.data()),
+                                unsigned(protocols.size())) != 0)
+    {
+        throw std::invalid_argument("Wrong ALPN protocols");
+    }
+
+    // The sessions check the name of the server, but only if peers are verified
+    ctx.set_verify_mode(settings.verify ? boost::asio::ssl::verify_peer
+                                        : boost::asio::ssl::verify_none);
+
+    SSL_CTX_set_ex_data(handle, target_index(), this);
+    SSL_CTX_set_info_callback(handle, on_info);
+    if (settings.resume)
+    {
+        SSL_CTX_set_session_cache_mode(handle,
+                                       SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(handle, on_new_session);
+    }
+    else
+    {
+        SSL_CTX_set_session_cache_mode(handle, SSL_SESS_CACHE_OFF);
+        SSL_CTX_set_options(handle, SSL_OP_NO_TICKET);
+    }
+}
+
+tls_context::target::~target()
+{
+    if (session)
+    {
+        SSL_SESSION_free(session);
+    }
+}
+
+tls_context::tls_context(const config::tls& settings) : settings(settings)
+{
+    // Wrong settings are told at once, rather than on the first connection
+    target check(*this, settings);
+}
+
+tls_context::~tls_context() = default;
+
+void tls_context::configure(const config::tls& settings)
+{
+    auto configured = std::make_unique<tls_context>(settings);
+    std::scoped_lock guard(shared_mtx);
+    shared_ctx = std::move(configured);
+}
+
+tls_context& tls_context::shared()
+{
+    std::scoped_lock guard(shared_mtx);
+    if (!shared_ctx)
+    {
+        shared_ctx = std::make_unique<tls_context>();
+    }
+    return *shared_ctx;
+}
+
+boost::asio::ssl::context& tls_context::native(const std::string& host, const std::string& port)
+{
+    std::scoped_lock guard(mtx);
+    auto& t = targets[target_key(host, port)];
+    if (!t)
+    {
+        t = std::make_unique<target>(*this, settings);
+    }
+    return t->ctx;
+}
+
+void tls_context::set_handshake_callback(handshake_callback cb)
+{
+    std::scoped_lock guard(mtx);
+    on_handshake = std::move(cb);
+}
+
+bool tls_context::has_session(const std::string& host, const std::string& port) const
+{
+    std::scoped_lock guard(mtx);
+    const auto t = targets.find(target_key(host, port));
+    return t != targets.end() && t->second->session != nullptr;
+}
+
+tls_context::target& tls_context::target_of(const SSL* ssl)
+{
+    return *static_cast<target*>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), target_index()));
+}
+
+void tls_context::on_info(const SSL* ssl, int where, [[maybe_unused]] int ret)
+{
+    auto& t = target_of(ssl);
+    // OpenSSL only hands out a const pointer, but the SSL object is the one handshaking
+    if (where & SSL_CB_HANDSHAKE_START)
+    {
+        t.owner.handshake_started(t, const_cast<SSL*>(ssl));
+    }
+    else if (where & SSL_CB_HANDSHAKE_DONE)
+    {
+        t.owner.handshake_done(const_cast<SSL*>(ssl));
+    }
+}
+
+int tls_context::on_new_session(SSL* ssl, SSL_SESSION* new_session)
+{
+    auto& t = target_of(ssl);
+    // A copy, as OpenSSL marks the session of a connection dropped without a TLS shutdown
+    // as not resumable, and connections are dropped that way
+    SSL_SESSION* copy = SSL_SESSION_dup(new_session);
+    if (copy == nullptr)
+    {
+        return 0;
+    }
+    std::scoped_lock guard(t.owner.mtx);
+    if (t.session)
+    {
+        SSL_SESSION_free(t.session);
+    }
+    t.session = copy;
+    return 0;
+}
+
+void tls_context::handshake_started(target& t, SSL* ssl)
+{
+    // Only the first handshake of the connection, not the later ones, if any
+    if (SSL_get_ex_data(ssl, record_index()) != nullptr)
+    {
+        return;
+    }
+    SSL_set_ex_data(ssl, record_index(), new handshake_record{steady_clock::now()});
+
+    // The client hello is not built yet, so it offers the session of the server. A copy of
+    // it too, for the one kept to stay resumable whatever happens to this connection
+    if (settings.resume)
+    {
+        std::scoped_lock guard(mtx);
+        if (SSL_SESSION* offered = t.session ? SSL_SESSION_dup(t.session) : nullptr)
+        {
+            SSL_set_session(ssl, offered);
+            SSL_SESSION_free(offered);
+        }
+    }
+}
+
+void tls_context::handshake_done(SSL* ssl)
+{
+    auto* record = static_cast<handshake_record*>(SSL_get_ex_data(ssl, record_index()));
+    if (record == nullptr || record->reported)
+    {
+        return;
+    }
+    record->reported = true;
+    const int64_t time = duration_cast<microseconds>(steady_clock::now() - record->start).count();
+
+    handshake_callback cb;
+    {
+        std::scoped_lock guard(mtx);
+        cb = on_handshake;
+    }
+    if (cb)
+    {
+        cb(time, SSL_session_reused(ssl) == 1);
+    }
+}
+}  // namespace http2_client
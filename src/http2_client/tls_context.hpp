@@ -0,0 +1,81 @@
+#pragma once
+
+#include <openssl/ssl.h>
+
+#include <boost/asio/ssl.hpp>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "tls.hpp"
+
+namespace http2_client
+{
+/**
+ * The TLS settings shared by every secure connection of the process, so that
+ * reconnections resume the last session instead of going through a full
+ * handshake. OpenSSL does not resume client sessions by itself: the last one
+ * a server handed out is kept, and set on every handshake with that server as
+ * it starts. Every server, by name and port, gets an SSL context of its own,
+ * as the handshake only tells the name apart, and sessions are only offered
+ * to the server that handed them out.
+ */
+class tls_context
+{
+public:
+    // Time (us) of a handshake, from its start to its end, and whether it resumed a session.
+    // Called from the thread of the connection
+    using handshake_callback = std::function<void(const int64_t time, const bool resumed)>;
+
+    // Throws std::invalid_argument when the settings cannot be applied
+    explicit tls_context(const config::tls& settings = {});
+
+    tls_context(const tls_context&) = delete;
+    tls_context& operator=(const tls_context&) = delete;
+
+    ~tls_context();
+
+    // Replaces the shared context. Only before any secure connection is opened
+    static void configure(const config::tls& settings);
+    // The one configured, or one with the default settings otherwise
+    static tls_context& shared();
+
+    // The context of the connections to a server, made on first use
+    boost::asio::ssl::context& native(const std::string& host, const std::string& port);
+    void set_handshake_callback(handshake_callback cb);
+    // True once the server handed out a session to resume
+    bool has_session(const std::string& host, const std::string& port) const;
+
+private:
+    // The context of the connections to a server, and the last session it handed out
+    struct target
+    {
+        target(tls_context& owner, const config::tls& settings);
+
+        target(const target&) = delete;
+        target& operator=(const target&) = delete;
+
+        ~target();
+
+        tls_context& owner;
+        boost::asio::ssl::context ctx;
+        SSL_SESSION* session = nullptr;
+    };
+
+    static target& target_of(const SSL* ssl);
+    static void on_info(const SSL* ssl, int where, int ret);
+    static int on_new_session(SSL* ssl, SSL_SESSION* new_session);
+    void handshake_started(target& t, SSL* ssl);
+    void handshake_done(SSL* ssl);
+
+    const config::tls settings;
+
+    mutable std::mutex mtx;
+    // Keyed by the name and the port of the server
+    std::map<std::string, std::unique_ptr<target>> targets;
+    handshake_callback on_handshake;
+};
+}  // namespace http2_client
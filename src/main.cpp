@@ -8,19 +8,30 @@
 #include <cstdlib>
 #include <exception>
 #include <fstream>
+#include <future>
 #include <iostream>
+#include <memory>
 #include <thread>
+#include <vector>
 
+#include "arrival.hpp"
 #include "client_impl.hpp"
+#include "closed_loop.hpp"
 #include "connection.hpp"
+#include "connection_pool.hpp"
+#include "in_flight_limits.hpp"
+#include "io_threads.hpp"
 #include "observability.hpp"
 #include "params.hpp"
+#include "rate_search.hpp"
 #include "script.hpp"
 #include "script_queue.hpp"
 #include "script_schema.hpp"
 #include "sender.hpp"
 #include "stats.hpp"
 #include "timer_impl.hpp"
+#include "tls.hpp"
+#include "tls_context.hpp"
 
 using nghttp2::asio_http2::header_map;
 using nghttp2::asio_http2::header_value;
@@ -32,28 +43,79 @@ namespace ba = boost::asio;
 using namespace nghttp2::asio_http2;
 using namespace nghttp2::asio_http2::client;
 
+namespace
+{
+// Everything a share of the traffic needs, run by its own thread
+struct engine_shard
+{
+    ba::io_context io_ctx;
+    ba::executor_work_guard<ba::io_context::executor_type> guard = ba::make_work_guard(io_ctx);
+    std::thread worker;
+    std::promise<void> prom;
+    std::future<void> fut = prom.get_future();
+    std::unique_ptr<engine::sender> sender;
+    std::unique_ptr<engine::closed_loop> loop;
+    std::shared_ptr<stats::stats_if> stats;
+};
+}  // namespace
+
 const char* progname;
-const unsigned int default_rate{10};
+const double default_rate{10};
 const int default_duration{60};
 const int default_stats_print_period{10};
+const uint64_t default_seed{1};
+const double default_tick{0};
+const int default_jobs{1};
+const int default_users{0};
 
 const std::string default_traffic_path{"/etc/scripts/traffic.json"};
 const std::string default_output_file{"hermes.out"};
+const std::string default_arrival{"constant"};
 
 [[noreturn]] static void usage(int rc)
 {
     syslog(LOG_INFO,
            "C++ Traffic Generator. Usage:  %s [options] \n"
            "options:\n\n"
-           " \t-r <rate>\tRequests/second ( Default: %d )\n"
+           " \t-r <rate>\tRequests/second, decimals allowed ( Default: %g )\n"
+           " \t-a <mode>\tArrival process: constant, poisson, jitter:<fraction> or\n"
+           " \t\t\ttrace:<path> to a file with one inter-arrival time per line ( Default: %s )\n"
+           " \t-S <seed>\tSeed for random arrival processes ( Default: %lu )\n"
+           " \t-l <profile>\tTime-varying rate, overriding -r and the script:\n"
+           " \t\t\tramp:<from>:<to>:<s>, step:<from>:<to>:<at_s>,\n"
+           " \t\t\tstairs:<from>:<increment>:<every_s>:<to> or\n"
+           " \t\t\tsine:<mean>:<amplitude>:<period_s> ( Default: constant -r )\n"
+           " \t-k <tick>\tMinimum time between sender wake-ups (us). Requests due in between\n"
+           " \t\t\tare sent in batches, recommended above 100k req/s ( Default: %g )\n"
+           " \t-j <shards>\tEngine shards, each one with its own thread, connections and 1/N\n"
+           " \t\t\tof the rate ( Default: %d )\n"
+           " \t-c <users>\tClosed loop: keep <users> requests in flight, sending a new one as\n"
+           " \t\t\tsoon as another is over, instead of following a rate ( Default: %d, off )\n"
+           " \t-n <pool>\tConnections of every engine shard, and how requests are spread:\n"
+           " \t\t\tconnections=<n>,select=round-robin|least-outstanding|two-choices,\n"
+           " \t\t\tstreams=<max per connection>,grow=<max connections>,queue=<n>\n"
+           " \t\t\t( Default: connections=1,streams=0 (no limit),queue=10000 )\n"
+           " \t-b <limits>\tCaps on requests and scripts in flight, and what to do beyond them:\n"
+           " \t\t\trequests=<n>,scripts=<n>,policy=skip|delay|queue,queue=<n>\n"
+           " \t\t\t( Default: no limits )\n"
+           " \t-w <threads>\tThreads for the connections, split among the engine shards,\n"
+           " \t\t\tand for the statistics: connections=<n>,stats=<n>\n"
+           " \t\t\t( Default: connections=<one per core>,stats=2 )\n"
+           " \t-T <tls>\tTLS of secure servers: ca=<file>,ciphers=<list>,suites=<list>,\n"
+           " \t\t\talpn=<protocol>:<protocol>,verify=on|off,resume=on|off\n"
+           " \t\t\t( Default: alpn=h2,verify=off,resume=on )\n"
+           " \t-m <slo>\tSearch the max rate meeting the objectives, overriding -r and -l:\n"
+           " \t\t\tsuccess=<fraction>,p<percentile>=<ms>,start=<req/s>,warmup=<periods>,\n"
+           " \t\t\tperiods=<periods>,precision=<fraction> ( Default: off )\n"
            " \t-t <time>\tTime to run traffic (s) ( Default: %d )\n"
            " \t-p <period>\tPrint and save statistics every <period> (s) ( Default: %d )\n"
            " \t-f <path>\tPath with the traffic json definition ( Default: %s )\n"
            " \t-s \t\tShow schema for json traffic definition.\n"
            " \t-o <file>\tOutput file for statistics( Default: %s )\n"
            " \t-h \t\tThis help.",
-           progname, default_rate, default_duration, default_stats_print_period,
-           default_traffic_path.c_str(), default_output_file.c_str());
+           progname, default_rate, default_arrival.c_str(), default_seed, default_tick,
+           default_jobs, default_users, default_duration,
+           default_stats_print_period, default_traffic_path.c_str(), default_output_file.c_str());
     exit(rc);
 }
 
@@ -62,21 +124,65 @@ int main(int argc, char* argv[])
     progname = basename(argv[0]);
     openlog(progname, LOG_CONS | LOG_PERROR, LOG_LOCAL1);
 
-    unsigned int rate{default_rate};
+    double rate{default_rate};
     int duration{default_duration};
     int print_period{default_stats_print_period};
     std::string traffic_json_path{default_traffic_path};
     std::string output_file{default_output_file};
+    std::string arrival{default_arrival};
+    uint64_t seed{default_seed};
+    std::string profile;
+    double tick{default_tick};
+    int jobs{default_jobs};
+    int users{default_users};
+    std::string search_definition;
+    std::string limits_definition;
+    std::string pool_definition;
+    std::string threads_definition;
+    std::string tls_definition;
 
     int option{};
-    while ((option = getopt(argc, argv, "hr:t:f:sp:o:")) != EOF)
+    while ((option = getopt(argc, argv, "hr:a:S:l:k:j:c:n:b:w:T:m:t:f:sp:o:")) != EOF)
     {
         switch (option)
         {
             case 'h':
                 usage(0);
             case 'r':
-                rate = atoi(optarg);
+                rate = atof(optarg);
+                break;
+            case 'a':
+                arrival = optarg;
+                break;
+            case 'S':
+                seed = strtoull(optarg, nullptr, 10);
+                break;
+            case 'l':
+                profile = optarg;
+                break;
+            case 'k':
+                tick = atof(optarg);
+                break;
+            case 'j':
+                jobs = atoi(optarg);
+                break;
+            case 'c':
+                users = atoi(optarg);
+                break;
+            case 'n':
+                pool_definition = optarg;
+                break;
+            case 'b':
+                limits_definition = optarg;
+                break;
+            case 'w':
+                threads_definition = optarg;
+                break;
+            case 'T':
+                tls_definition = optarg;
+                break;
+            case 'm':
+                search_definition = optarg;
                 break;
             case 't':
                 duration = atoi(optarg);
@@ -99,10 +205,68 @@ int main(int argc, char* argv[])
         }
     }
 
+    if (jobs < 1)
+    {
+        std::cerr << "At least one engine shard is needed" << std::endl;
+        usage(1);
+    }
+
+    if (users < 0 || (users > 0 && users < jobs))
+    {
+        std::cerr << "Closed loop needs at least one user per engine shard" << std::endl;
+        usage(1);
+    }
+
+    if (users > 0 && !search_definition.empty())
+    {
+        std::cerr << "Rate search cannot be run in closed loop" << std::endl;
+        usage(1);
+    }
+
+    config::arrival_config arrival_cfg;
+    std::optional<config::load_profile> load_profile;
+    std::optional<engine::rate_search> search;
+    config::in_flight_limits limits;
+    config::connection_pool pool;
+    config::io_threads threads;
+    try
+    {
+        arrival_cfg = engine::parse_arrival(arrival, seed);
+        if (!profile.empty())
+        {
+            load_profile = config::parse_load_profile(profile);
+        }
+        if (!pool_definition.empty())
+        {
+            pool = config::parse_connection_pool(pool_definition);
+        }
+        if (!threads_definition.empty())
+        {
+            threads = config::parse_io_threads(threads_definition);
+        }
+        if (!tls_definition.empty())
+        {
+            http2_client::tls_context::configure(config::parse_tls(tls_definition));
+        }
+        if (!limits_definition.empty())
+        {
+            limits = config::parse_in_flight_limits(limits_definition);
+        }
+        if (!search_definition.empty())
+        {
+            search.emplace(engine::parse_search(search_definition));
+        }
+    }
+    catch (const std::logic_error& e)
+    {
+        std::cerr << e.what() << std::endl;
+        usage(1);
+    }
+
     std::optional<traffic::script> the_script;
     try
     {
-        the_script = traffic::script(traffic_json_path);
+        the_script.emplace(traffic_json_path);
     }
     catch (const std::logic_error& e)
     {
@@ -113,6 +277,18 @@ int main(int argc, char* argv[])
         exit(1);
     }
 
+    if (!load_profile && the_script->get_load_profile())
+    {
+        load_profile = *the_script->get_load_profile();
+    }
+
+    // The search drives the rate from the start rate on
+    if (search)
+    {
+        rate = search->get_rate();
+        load_profile.reset();
+    }
+
     /******************************************************************
      * OBSERVABILITY
      ******************************************************************/
@@ -121,73 +297,232 @@ int main(int argc, char* argv[])
     /******************************************************************
      * IO_CTX
      ******************************************************************/
-    ba::io_context io_ctx;
-    ba::executor_work_guard<ba::io_context::executor_type> io_ctx_grd = ba::make_work_guard(io_ctx);
-    std::vector<std::thread> workers;
-    for (auto i = 0; i < 2; ++i)
-    {
-        workers.emplace_back([&io_ctx]() { io_ctx.run(); });
-    }
-
     ba::io_context stats_io_ctx;
     ba::executor_work_guard<ba::io_context::executor_type> stats_io_ctx_guard =
         ba::make_work_guard(stats_io_ctx);
 
     std::vector<std::thread> stats_workers;
-    for (auto i = 0; i < 2; ++i)
+    for (std::size_t i = 0; i < threads.stats; ++i)
     {
         stats_workers.emplace_back([&stats_io_ctx]() { stats_io_ctx.run(); });
     }
 
-    ba::io_context client_io_ctx;
-    ba::executor_work_guard<ba::io_context::executor_type> client_io_ctx_guard =
-        ba::make_work_guard(client_io_ctx);
-    std::thread client_worker([&client_io_ctx]() { client_io_ctx.run(); });
+    std::vector<std::unique_ptr<engine_shard>> shards;
+    for (auto i = 0; i < jobs; ++i)
+    {
+        auto& shard = shards.emplace_back(std::make_unique<engine_shard>());
+        shard->worker = std::thread([&io_ctx = shard->io_ctx]() { io_ctx.run(); });
+    }
 
     /******************************************************************
      * PARAMS
      ******************************************************************/
-    std::cerr << "Rate is " << rate << "req/s" << std::endl;
-    double wait_time = std::pow(10.0, 6) / double(rate);
-    std::cerr << "Sending a request every " << wait_time << "us" << std::endl;
-    auto params = std::make_shared<config::params>(int(wait_time), duration);
+    double wait_time = std::pow(10.0, 6) / rate;
+    if (users > 0)
+    {
+        std::cerr << "Closed loop with " << users << " users" << std::endl;
+    }
+    else if (search)
+    {
+        std::cerr << "Searching the max sustainable rate, starting at " << rate << "req/s"
+                  << std::endl;
+    }
+    else if (load_profile)
+    {
+        std::cerr << "Rate follows a load profile, starting at " << load_profile->rate_at(0)
+                  << "req/s" << std::endl;
+    }
+    else
+    {
+        std::cerr << "Rate is " << rate << "req/s" << std::endl;
+        std::cerr << "Sending a request every " << wait_time << "us" << std::endl;
+    }
+    if (!users)
+    {
+        std::cerr << "Arrival process is " << engine::to_string(arrival_cfg) << std::endl;
+    }
+    auto params = std::make_shared<config::params>(wait_time, duration, arrival_cfg, load_profile);
+    params->tick = tick;
+    if (tick > 0)
+    {
+        std::cerr << "Sender wakes up at most every " << tick << "us" << std::endl;
+    }
+    if (jobs > 1)
+    {
+        std::cerr << "Traffic is split among " << jobs << " engine shards" << std::endl;
+    }
+
+    // A closed loop keeps its users in flight, and nothing else
+    if (users > 0)
+    {
+        limits = {};
+    }
+    if (limits.enabled())
+    {
+        std::cerr << "In flight at most " << limits.max_requests << " requests and "
+                  << limits.max_scripts << " scripts (0: no limit)" << std::endl;
+    }
+    const auto shard_limits = jobs > 1 ? limits.shard(jobs) : limits;
+    std::cerr << "Connections of every engine shard run in " << threads.shard(0, std::size_t(jobs))
+              << " threads, statistics in " << threads.stats << std::endl;
+    if (pool.size > 1)
+    {
+        std::cerr << "Every engine shard opens " << pool.size << " connections, selected by "
+                  << config::to_string(pool.selection) << std::endl;
+    }
+    if (pool.max_size > pool.size)
+    {
+        std::cerr << "Every engine shard may grow up to " << pool.max_size
+                  << " connections when they are out of streams" << std::endl;
+    }
+    const auto& endpoints = the_script->get_endpoints();
+    const auto& endpoint_selection = the_script->get_endpoint_selection();
+    std::vector<std::string> endpoint_names;
+    for (const auto& e : endpoints)
+    {
+        endpoint_names.push_back(e.dns + ":" + e.port);
+    }
+    if (endpoints.size() > 1)
+    {
+        std::cerr << "Scripts are spread over " << endpoints.size() << " endpoints, "
+                  << (endpoint_selection.policy == traffic::endpoint_policy::HASH
+                          ? "hashing " + endpoint_selection.variable
+                          : std::string("by weight"))
+                  << ", with a pool of connections each" << std::endl;
+    }
 
     auto stats = std::make_shared<stats::stats>(stats_io_ctx, print_period, output_file,
                                                 the_script->get_message_names());
+    stats->set_endpoint_names(endpoint_names);
 
     /******************************************************************
-     * CLIENT
+     * CLIENTS
      ******************************************************************/
-    auto q = std::make_unique<traffic::script_queue>(*the_script);
-    auto client = std::make_unique<http2_client::client_impl>(
-        stats, client_io_ctx, std::move(q), the_script->get_server_dns(),
-        the_script->get_server_port(), the_script->is_server_secure());
-    if (!client->is_connected())
+    http2_client::tls_context::shared().set_handshake_callback(
+        [stats](const int64_t time, const bool resumed) { stats->add_handshake(time, resumed); });
+
+    std::vector<std::unique_ptr<http2_client::client>> clients;
+    for (auto i = 0; i < jobs; ++i)
     {
-        std::cerr << "Terminating application. Error connecting server." << std::endl;
-        exit(1);
+        std::shared_ptr<stats::stats_if> shard_stats = stats;
+        std::unique_ptr<traffic::script_queue> q;
+        if (jobs > 1)
+        {
+            shard_stats = stats->create_shard();
+            q = std::make_unique<traffic::script_queue>(*the_script, i, jobs);
+        }
+        else
+        {
+            q = std::make_unique<traffic::script_queue>(*the_script);
+        }
+        q->set_max_in_flight(int64_t(shard_limits.max_scripts));
+        shards[i]->stats = shard_stats;
+
+        auto client = std::make_unique<http2_client::client_impl>(
+            shard_stats, shards[i]->io_ctx, std::move(q), endpoints, endpoint_selection,
+            the_script->is_server_secure(), shard_limits,
+            pool.shard(std::size_t(i), endpoints.size()),
+            threads.shard(std::size_t(i), std::size_t(jobs)));
+        if (!client->is_connected())
+        {
+            std::cerr << "Terminating application. Error connecting server." << std::endl;
+            exit(1);
+        }
+        clients.push_back(std::move(client));
     }
 
     /******************************************************************
      * EXECUTION
      ******************************************************************/
 
-    std::promise<void> prom;
-    std::future<void> fut = prom.get_future();
+    // Do not count the time spent connecting as if the traffic had already started. The
+    // stats threads only see the params from now on
+    params->init_time = steady_clock::now();
+    // There is no fixed target rate in closed loop, nor while searching it
+    if (!users && !search)
+    {
+        stats->set_params(params);
+    }
+    for (auto i = 0; i < jobs; ++i)
+    {
+        auto& shard = *shards[i];
+        auto shard_params =
+            jobs > 1 ? std::make_shared<config::params>(params->shard(i, jobs)) : params;
+        if (users > 0)
+        {
+            const std::size_t shard_users = users / jobs + (i < users % jobs ? 1 : 0);
+            shard.loop = std::make_unique<engine::closed_loop>(
+                shard.io_ctx, std::move(clients[i]), shard_params, shard_users,
+                std::move(shard.prom));
+        }
+        else
+        {
+            shard.sender = std::make_unique<engine::sender>(
+                std::make_unique<engine::timer_impl>(shard.io_ctx), std::move(clients[i]),
+                shard_params, std::move(shard.prom), shard.stats);
+        }
+    }
+
+    // Every print period is evaluated, and the new rate is split among the shards
+    if (search)
+    {
+        stats->set_period_callback(
+            [&search, &shards, jobs](const stats::snapshot& period)
+            {
+                if (search->is_done())
+                {
+                    return;
+                }
 
-    engine::sender sender(std::make_unique<engine::timer_impl>(io_ctx), std::move(client), params,
-                          std::move(prom));
+                const double seconds =
+                    std::chrono::duration<double>(steady_clock::now() - period.init_time)
+                        .count();
+                int64_t failed{period.timed_out};
+                for (const auto& rc : period.response_codes_nok)
+                {
+                    failed += rc.second;
+                }
+                const auto percentile = search->get_config().objectives.percentile;
+                const double previous = search->get_rate();
+                const double next = search->on_period(
+                    {seconds > 0 ? double(period.sent) / seconds : 0, period.responded_ok, failed,
+                     double(period.response_time.percentile(percentile)) / 1000});
 
-    fut.wait();
+                if (search->is_done())
+                {
+                    std::cerr << "Search finished at " << next << "req/s" << std::endl;
+                    for (auto& shard : shards)
+                    {
+                        shard->sender->stop();
+                    }
+                }
+                else if (next != previous)
+                {
+                    std::cerr << "Search: trying " << next << "req/s" << std::endl;
+                    for (auto& shard : shards)
+                    {
+                        shard->sender->set_rate(next / jobs);
+                    }
+                }
+            });
+    }
+
+    for (auto& shard : shards)
+    {
+        shard->fut.wait();
+    }
 
+    // The last period is cut short by the end of the traffic, so it is not evaluated
+    stats->set_period_callback({});
+    http2_client::tls_context::shared().set_handshake_callback({});
     stats->end();
 
     o11y::shutdown_observability();
 
-    io_ctx_grd.reset();
-    for (auto& thread : workers)
+    for (auto& shard : shards)
     {
-        thread.join();
+        shard->guard.reset();
+        shard->worker.join();
     }
 
     stats_io_ctx_guard.reset();
@@ -196,6 +531,10 @@ int main(int argc, char* argv[])
         thread.join();
     }
 
-    client_io_ctx_guard.reset();
-    client_worker.join();
+    if (search)
+    {
+        std::ofstream report(output_file + ".search");
+        search->report(report);
+        search->report(std::cout);
+    }
 }
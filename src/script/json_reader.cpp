@@ -9,7 +9,7 @@ namespace traffic
 {
 void json_reader::parse(const std::string& json_str, const std::string& schema_str)
 {
-    if (document.Parse(json_str.c_str()).HasParseError())
+    if (document.Parse(json_str.data(), json_str.size()).HasParseError())
     {
         throw std::invalid_argument("Error parsing input! Wrong json.");
     }
@@ -52,6 +52,10 @@ json_reader::json_reader(const json_reader& other)
     document.CopyFrom(other.document, document.GetAllocator());
 }
 
+json_reader::json_reader(json_reader&& other) noexcept : document(std::move(other.document))
+{
+}
+
 json_reader& json_reader::operator=(json_reader other)
 {
     swap(*this, other);
@@ -64,58 +68,82 @@ bool json_reader::operator==(const json_reader& other) const
 }
 
 template <>
-json_reader json_reader::get_value<json_reader>(const std::string& path)
+json_reader json_reader::get_value<json_reader>(const json_pointer& ptr)
 {
-    if (const auto* value = rapidjson::Pointer(path.c_str()).Get(document);
+    if (const auto* value = ptr.pointer.Get(document);
         value && value->GetType() == rapidjson::kObjectType)
     {
         return json_reader(value);
     }
 
-    throw std::out_of_range("Object not found in " + path);
+    throw std::out_of_range("Object not found in " + ptr.path());
 }
 
 template <>
-int json_reader::get_value<int>(const std::string& path)
+int json_reader::get_value<int>(const json_pointer& ptr)
 {
-    if (const auto* value = rapidjson::Pointer(path.c_str()).Get(document);
+    if (const auto* value = ptr.pointer.Get(document);
         value && value->GetType() == rapidjson::kNumberType)
     {
         return value->GetInt();
     }
 
-    throw std::out_of_range("Integer not found in " + path);
+    throw std::out_of_range("Integer not found in " + ptr.path());
 }
 
 template <>
-bool json_reader::get_value<bool>(const std::string& path)
+double json_reader::get_value<double>(const json_pointer& ptr)
 {
-    if (const auto* value = rapidjson::Pointer(path.c_str()).Get(document);
+    if (const auto* value = ptr.pointer.Get(document);
+        value && value->GetType() == rapidjson::kNumberType)
+    {
+        return value->GetDouble();
+    }
+
+    throw std::out_of_range("Number not found in " + ptr.path());
+}
+
+template <>
+bool json_reader::get_value<bool>(const json_pointer& ptr)
+{
+    if (const auto* value = ptr.pointer.Get(document);
         value &&
         (value->GetType() == rapidjson::kFalseType || value->GetType() == rapidjson::kTrueType))
     {
         return value->GetBool();
     }
 
-    throw std::out_of_range("Bool not found in " + path);
+    throw std::out_of_range("Bool not found in " + ptr.path());
 }
 
 template <>
-std::string json_reader::get_value<std::string>(const std::string& path)
+std::string json_reader::get_value<std::string>(const json_pointer& ptr)
 {
-    if (const auto* value = rapidjson::Pointer(path.c_str()).Get(document);
+    if (const auto* value = ptr.pointer.Get(document);
         value && value->GetType() == rapidjson::kStringType)
     {
         return value->GetString();
     }
 
-    throw std::out_of_range("String not found in " + path);
+    throw std::out_of_range("String not found in " + ptr.path());
+}
+
+template <>
+std::string_view json_reader::get_value<std::string_view>(const json_pointer& ptr)
+{
+    if (const auto* value = ptr.pointer.Get(document);
+        value && value->GetType() == rapidjson::kStringType)
+    {
+        return {value->GetString(), value->GetStringLength()};
+    }
+
+    throw std::out_of_range("String not found in " + ptr.path());
 }
 
 template <>
-std::vector<std::string> json_reader::get_value<std::vector<std::string>>(const std::string& path)
+std::vector<std::string> json_reader::get_value<std::vector<std::string>>(const json_pointer& ptr)
 {
-    if (const auto value = rapidjson::Pointer(path.c_str()).Get(document);
+    if (const auto value = ptr.pointer.Get(document);
         value && value->GetType() == rapidjson::kArrayType)
     {
         std::vector<std::string> result;
@@ -124,7 +152,7 @@ std::vector<std::string> json_reader::get_value<std::vector<std::string>>(const
             if (!element.IsString())
             {
                 throw std::invalid_argument("Expected string but found other in array under " +
-                                            path);
+                                            ptr.path());
             }
             result.emplace_back(element.GetString());
         }
@@ -132,7 +160,7 @@ std::vector<std::string> json_reader::get_value<std::vector<std::string>>(const
         return result;
     }
 
-    throw std::out_of_range("Array not found in " + path);
+    throw std::out_of_range("Array not found in " + ptr.path());
 }
 
 std::vector<std::string> json_reader::get_attributes()
@@ -151,9 +179,9 @@ std::vector<std::string> json_reader::get_attributes()
     return attrs;
 }
 
-std::string json_reader::get_json_as_string(const std::string& path)
+std::string json_reader::get_json_as_string(const json_pointer& ptr)
 {
-    if (const auto* value = rapidjson::Pointer(path.c_str()).Get(document); value)
+    if (const auto* value = ptr.pointer.Get(document); value)
     {
         rapidjson::StringBuffer buffer;
         buffer.Clear();
@@ -165,7 +193,7 @@ std::string json_reader::get_json_as_string(const std::string& path)
         }
     }
 
-    throw std::out_of_range("No value set in " + path);
+    throw std::out_of_range("No value set in " + ptr.path());
 }
 
 std::string json_reader::as_string() const
@@ -178,108 +206,91 @@ std::string json_reader::as_string() const
 }
 
 template <>
-void json_reader::set<int>(const std::string& path, const int& value)
+void json_reader::set<int>(const json_pointer& ptr, const int& value)
 {
-    rapidjson::Pointer(path.c_str()).Create(document);
-    if (auto* val = rapidjson::Pointer(path.c_str()).Get(document); val)
-    {
-        val->SetInt(value);
-        return;
-    }
-
-    throw std::out_of_range("Error setting integer under " + path);
+    // Created, if missing, and walked only once
+    auto& val = ptr.pointer.Create(document);
+    val.SetInt(value);
 }
 
 template <>
-void json_reader::set<bool>(const std::string& path, const bool& value)
+void json_reader::set<double>(const json_pointer& ptr, const double& value)
 {
-    rapidjson::Pointer(path.c_str()).Create(document);
-    if (auto* val = rapidjson::Pointer(path.c_str()).Get(document); val)
-    {
-        val->SetBool(value);
-        return;
-    }
-
-    throw std::out_of_range("Error setting integer under " + path);
+    auto& val = ptr.pointer.Create(document);
+    val.SetDouble(value);
 }
 
 template <>
-void json_reader::set<std::string>(const std::string& path, const std::string& value)
+void json_reader::set<bool>(const json_pointer& ptr, const bool& value)
 {
-    rapidjson::Pointer(path.c_str()).Create(document);
-    if (auto* val = rapidjson::Pointer(path.c_str()).Get(document); val)
-    {
-        val->SetString(value.c_str(), value.size(), document.GetAllocator());
-        return;
-    }
+    auto& val = ptr.pointer.Create(document);
+    val.SetBool(value);
+}
 
-    throw std::out_of_range("Error setting string under " + path);
+template <>
+void json_reader::set<std::string>(const json_pointer& ptr, const std::string& value)
+{
+    set<std::string_view>(ptr, value);
 }
 
 template <>
-void json_reader::set<json_reader>(const std::string& path, const json_reader& value)
+void json_reader::set<std::string_view>(const json_pointer& ptr, const std::string_view& value)
 {
-    rapidjson::Pointer(path.c_str()).Create(document);
-    if (auto* val = rapidjson::Pointer(path.c_str()).Get(document); val)
-    {
-        val->CopyFrom(value.document, document.GetAllocator());
-        return;
-    }
+    auto& val = ptr.pointer.Create(document);
+    val.SetString(value.data(), rapidjson::SizeType(value.size()), document.GetAllocator());
+}
 
-    throw std::out_of_range("Error setting object under " + path);
+template <>
+void json_reader::set<json_reader>(const json_pointer& ptr, const json_reader& value)
+{
+    auto& val = ptr.pointer.Create(document);
+    val.CopyFrom(value.document, document.GetAllocator());
 }
 
 template <>
-void json_reader::set<std::vector<std::string>>(const std::string& path,
+void json_reader::set<std::vector<std::string>>(const json_pointer& ptr,
                                                 const std::vector<std::string>& values)
 {
-    rapidjson::Pointer(path.c_str()).Create(document);
-    if (auto* val = rapidjson::Pointer(path.c_str()).Get(document); val)
+    auto& val = ptr.pointer.Create(document);
+    val.SetArray();
+    for (const auto& value : values)
     {
-        val->SetArray();
-        for (const auto& value : values)
-        {
-            rapidjson::Value v;
-            v.SetString(value.c_str(), value.size(), document.GetAllocator());
-            val->PushBack(v, document.GetAllocator());
-        }
-        return;
+        rapidjson::Value v;
+        v.SetString(value.c_str(), value.size(), document.GetAllocator());
+        val.PushBack(v, document.GetAllocator());
     }
-
-    throw std::out_of_range("Error setting object under " + path);
 }
 
-bool json_reader::is_present(const std::string& path)
+bool json_reader::is_present(const json_pointer& ptr)
 {
-    const rapidjson::Pointer ptr{path.c_str()};
-    return ptr.IsValid() && ptr.Get(document) != nullptr;
+    return ptr.is_valid() && ptr.pointer.Get(document) != nullptr;
 }
 
-bool json_reader::is_string(const std::string& path)
+bool json_reader::is_string(const json_pointer& ptr)
 {
-    if (const rapidjson::Pointer ptr{path.c_str()}; ptr.IsValid())
+    if (ptr.is_valid())
     {
-        const auto* val = ptr.Get(document);
+        const auto* val = ptr.pointer.Get(document);
         return val && val->GetType() == rapidjson::kStringType;
     }
 
     return false;
 }
 
-bool json_reader::is_number(const std::string& path)
+bool json_reader::is_number(const json_pointer& ptr)
 {
-    if (const rapidjson::Pointer ptr{path.c_str()}; ptr.IsValid())
+    if (ptr.is_valid())
     {
-        const auto* val = ptr.Get(document);
+        const auto* val = ptr.pointer.Get(document);
         return val && val->GetType() == rapidjson::kNumberType;
     }
 
     return false;
 }
 
-void json_reader::erase(const std::string& path)
+void json_reader::erase(const json_pointer& ptr)
 {
-    rapidjson::Pointer(path.c_str()).Erase(document);
+    ptr.pointer.Erase(document);
 }
 
 }  // namespace traffic
@@ -1,13 +1,33 @@
 #pragma once
 
 #include <iostream>
+#include <string_view>
 #include <vector>
 
 #include "rapidjson/document.h"
+#include "rapidjson/pointer.h"
 #include "script_structs.hpp"
 
 namespace traffic
 {
+/**
+ * A json path tokenized once, to be used on any number of documents.
+ */
+class json_pointer
+{
+public:
+    explicit json_pointer(const std::string& path) : text(path), pointer(text.c_str()) {}
+
+    const std::string& path() const { return text; }
+    bool is_valid() const { return pointer.IsValid(); }
+
+private:
+    friend class json_reader;
+
+    std::string text;
+    rapidjson::Pointer pointer;
+};
+
 class json_reader
 {
 public:
@@ -15,31 +35,54 @@ public:
     ~json_reader() = default;
     json_reader(const std::string& json, const std::string& schema_str);
     json_reader(const json_reader& other);
+    json_reader(json_reader&& other) noexcept;
     friend void swap(json_reader& first, json_reader& second) noexcept;
     json_reader& operator=(json_reader other);
     bool operator==(const json_reader& other) const;
 
+    // Paths given as text are tokenized on every call. Those used again and again are better
+    // tokenized once into a json_pointer
     template <typename t>
     t get_value(const std::string& path)
     {
-        throw std::invalid_argument("Type not implemented when asked for " + path);
+        return get_value<t>(json_pointer(path));
+    }
+
+    template <typename t>
+    t get_value(const json_pointer& ptr)
+    {
+        throw std::invalid_argument("Type not implemented when asked for " + ptr.path());
+    }
+
+    template <typename t>
+    void set(const std::string& path, const t& value)
+    {
+        set<t>(json_pointer(path), value);
     }
 
     template <typename t>
-    void set(const std::string& path, const t&)
+    void set(const json_pointer& ptr, const t&)
     {
-        throw std::invalid_argument("Type not implemented when asked for " + path);
+        throw std::invalid_argument("Type not implemented when asked for " + ptr.path());
     }
 
-    void erase(const std::string& path);
+    void erase(const std::string& path) { erase(json_pointer(path)); }
+    void erase(const json_pointer& ptr);
 
-    bool is_present(const std::string& path);
+    bool is_present(const std::string& path) { return is_present(json_pointer(path)); }
+    bool is_present(const json_pointer& ptr);
     std::vector<std::string> get_attributes();
-    std::string get_json_as_string(const std::string& path);
+    std::string get_json_as_string(const std::string& path)
+    {
+        return get_json_as_string(json_pointer(path));
+    }
+    std::string get_json_as_string(const json_pointer& ptr);
     std::string as_string() const;
 
-    bool is_string(const std::string& path);
-    bool is_number(const std::string& path);
+    bool is_string(const std::string& path) { return is_string(json_pointer(path)); }
+    bool is_string(const json_pointer& ptr);
+    bool is_number(const std::string& path) { return is_number(json_pointer(path)); }
+    bool is_number(const json_pointer& ptr);
 
 private:
     explicit json_reader(const rapidjson::Value* value);
@@ -49,34 +92,47 @@ private:
 };
 
 template <>
-json_reader json_reader::get_value<json_reader>(const std::string& path);
+json_reader json_reader::get_value<json_reader>(const json_pointer& ptr);
+
+template <>
+int json_reader::get_value<int>(const json_pointer& ptr);
+
+template <>
+double json_reader::get_value<double>(const json_pointer& ptr);
+
+template <>
+bool json_reader::get_value<bool>(const json_pointer& ptr);
+
+template <>
+std::string json_reader::get_value<std::string>(const json_pointer& ptr);
 
+// Valid as long as the reader and the value it points to
 template <>
-int json_reader::get_value<int>(const std::string& path);
+std::string_view json_reader::get_value<std::string_view>(const json_pointer& ptr);
 
 template <>
-bool json_reader::get_value<bool>(const std::string& path);
+std::vector<std::string> json_reader::get_value<std::vector<std::string>>(const json_pointer& ptr);
 
 template <>
-std::string json_reader::get_value<std::string>(const std::string& path);
+void json_reader::set<int>(const json_pointer& ptr, const int& value);
 
 template <>
-std::vector<std::string> json_reader::get_value<std::vector<std::string>>(const std::string& path);
+void json_reader::set<double>(const json_pointer& ptr, const double& value);
 
 template <>
-void json_reader::set<int>(const std::string& path, const int& value);
+void json_reader::set<bool>(const json_pointer& ptr, const bool& value);
 
 template <>
-void json_reader::set<bool>(const std::string& path, const bool& value);
+void json_reader::set<std::string>(const json_pointer& ptr, const std::string& value);
 
 template <>
-void json_reader::set<std::string>(const std::string& path, const std::string& value);
+void json_reader::set<std::string_view>(const json_pointer& ptr, const std::string_view& value);
 
 template <>
-void json_reader::set<json_reader>(const std::string& path, const json_reader& value);
+void json_reader::set<json_reader>(const json_pointer& ptr, const json_reader& value);
 
 template <>
-void json_reader::set<std::vector<std::string>>(const std::string& path,
+void json_reader::set<std::vector<std::string>>(const json_pointer& ptr,
                                                 const std::vector<std::string>& value);
 
 }  // namespace traffic
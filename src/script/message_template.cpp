@@ -0,0 +1,88 @@
+#include "message_template.hpp"
+
+#include <algorithm>
+
+namespace traffic
+{
+text_template::text_template(const std::string& text)
+{
+    std::size_t literal{0};
+    std::size_t open = text.find('<');
+    while (open != std::string::npos)
+    {
+        const std::size_t close = text.find('>', open + 1);
+        if (close == std::string::npos)
+        {
+            break;
+        }
+        // The closest opening one is the one that counts
+        if (const std::size_t next = text.find('<', open + 1); next < close)
+        {
+            open = next;
+            continue;
+        }
+
+        if (open > literal)
+        {
+            segments.push_back({text.substr(literal, open - literal), false});
+        }
+        segments.push_back({text.substr(open + 1, close - open - 1), true});
+        ++placeholders;
+        literal = close + 1;
+        open = text.find('<', literal);
+    }
+
+    if (literal < text.size())
+    {
+        segments.push_back({text.substr(literal), false});
+    }
+}
+
+nghttp2::asio_http2::header_map build_request_headers(const std::size_t body_size,
+                                                      const msg_headers& h)
+{
+    nghttp2::asio_http2::header_map map = {{CONTENT_TYPE, {APP_JSON, false}},
+                                           {CONTENT_LENGTH, {std::to_string(body_size), false}}};
+
+    for (const auto& [k, v] : h)
+    {
+        map.emplace(k, nghttp2::asio_http2::header_value{v, false});
+    }
+
+    return map;
+}
+
+std::shared_ptr<const message_template> compile_message(const message& m)
+{
+    auto compiled = std::make_shared<message_template>();
+    compiled->body_size = m.body.size();
+    compiled->needs_body = !m.sfa.body_fields.empty();
+    compiled->needs_headers = !m.sfa.headers.empty();
+    compiled->url = text_template(m.url);
+    compiled->body = text_template(m.body);
+    for (const auto& [id, field] : m.sfa.body_fields)
+    {
+        compiled->saved_fields.emplace_back(field.path);
+    }
+    for (const auto& [id, field] : m.atb)
+    {
+        compiled->added_fields.emplace_back(field.path);
+    }
+
+    const bool static_headers =
+        std::none_of(m.headers.begin(), m.headers.end(), [](const auto& h)
+                     { return has_placeholders(h.first) || has_placeholders(h.second); });
+    if (static_headers)
+    {
+        compiled->headers = build_request_headers(m.body.size(), m.headers);
+        return compiled;
+    }
+
+    for (const auto& [k, v] : m.headers)
+    {
+        compiled->dynamic_headers.emplace_back(text_template(k), text_template(v));
+        compiled->dynamic_header_names |= has_placeholders(k);
+    }
+    return compiled;
+}
+}  // namespace traffic
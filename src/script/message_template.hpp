@@ -0,0 +1,110 @@
+#pragma once
+
+#include <nghttp2/asio_http2.h>
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "json_reader.hpp"
+#include "script_structs.hpp"
+
+namespace traffic
+{
+inline static const std::string CONTENT_TYPE = "content-type";
+inline static const std::string CONTENT_LENGTH = "content-length";
+inline static const std::string APP_JSON = "application/json";
+
+/**
+ * Text with <placeholders>, split once into literal chunks and the names of
+ * the placeholders between them, so that rendering it is a single pass.
+ */
+class text_template
+{
+public:
+    text_template() = default;
+    explicit text_template(const std::string& text);
+
+    bool is_static() const { return placeholders == 0; }
+
+    // Overwrites the output, reusing its buffer. The lookup gives the value of a name, or
+    // nothing, and placeholders without a value are left as they are
+    template <typename String, typename Lookup>
+    void render(String& out, const Lookup& lookup) const;
+
+private:
+    struct segment
+    {
+        std::string text;
+        bool placeholder;
+    };
+
+    std::vector<segment> segments;
+    std::size_t placeholders = 0;
+};
+
+template <typename String, typename Lookup>
+void text_template::render(String& out, const Lookup& lookup) const
+{
+    out.clear();
+    for (const auto& s : segments)
+    {
+        if (!s.placeholder)
+        {
+            out.append(s.text);
+        }
+        else if (const auto value = lookup(std::string_view(s.text)))
+        {
+            out.append(*value);
+        }
+        else
+        {
+            out.append(1, '<').append(s.text).append(1, '>');
+        }
+    }
+}
+
+/**
+ * The parts of the requests of a message that are known when the script is
+ * loaded, built once and shared by all the copies of the script. Whatever may
+ * change from one request to the next is left out, and rendered on every send.
+ */
+struct message_template
+{
+    // content-type, content-length and the custom headers, unless any has a placeholder
+    std::optional<nghttp2::asio_http2::header_map> headers;
+    // Body size the content-length in the headers is for
+    std::size_t body_size = 0;
+    // Rendered when the message is about to be sent, with the values the script has then
+    text_template url;
+    text_template body;
+    // Every custom header, in the order of the message, when any has a placeholder
+    std::vector<std::pair<text_template, text_template>> dynamic_headers;
+    // Then the names may change too, and the headers are sorted again
+    bool dynamic_header_names = false;
+    // Whether fields are saved from the body or the headers of the answers. Otherwise,
+    // only their status code is checked, and the rest is not even kept
+    bool needs_body = true;
+    bool needs_headers = true;
+    // Paths of the fields saved from the answer and of those added to the body, in the
+    // order of their maps in the message
+    std::vector<json_pointer> saved_fields;
+    std::vector<json_pointer> added_fields;
+};
+
+// Headers of a request with a body of the given size
+nghttp2::asio_http2::header_map build_request_headers(const std::size_t body_size,
+                                                      const msg_headers& h);
+
+std::shared_ptr<const message_template> compile_message(const message& m);
+
+// True when the text may have a <placeholder>, replaced once the script is running
+inline bool has_placeholders(const std::string& text)
+{
+    return text.find('<') != std::string::npos;
+}
+}  // namespace traffic
@@ -1,6 +1,5 @@
 #include "script.hpp"
 
-#include <boost/algorithm/string.hpp>
 #include <deque>
 #include <exception>
 #include <fstream>
@@ -8,16 +7,66 @@
 #include <map>
 #include <optional>
 #include <set>
+#include <string_view>
 #include <vector>
 
 #include "json_reader.hpp"
+#include "message_template.hpp"
 #include "script_functions.hpp"
 #include "script_reader.hpp"
 #include "tracer.hpp"
 
 namespace traffic
 {
-script::script(const std::string& path)
+namespace
+{
+// Throws as std::map::at does, so that a missing value fails the request
+template <typename Map>
+const auto& saved_value(const Map& map, const std::string& id)
+{
+    if (const auto found = map.find(std::string_view(id)); found != map.end())
+    {
+        return found->second;
+    }
+    throw std::out_of_range("Nothing saved as " + id);
+}
+}  // namespace
+
+script::script(script_arena_ptr a)
+    : arena(std::move(a)),
+      url(arena->resource()),
+      body(arena->resource()),
+      range_values(arena->resource()),
+      saved_headers(arena->resource()),
+      saved_strs(arena->resource()),
+      saved_ints(arena->resource()),
+      saved_jsons(arena->resource())
+{
+}
+
+script::script(const script& other) : script(acquire_script_arena())
+{
+    definition = other.definition;
+    step = other.step;
+    // Copied into the arena of this one
+    url = other.url;
+    body = other.body;
+    headers = other.headers;
+    own_url = other.own_url;
+    own_body = other.own_body;
+    own_headers = other.own_headers;
+    endpoint_key = other.endpoint_key;
+    chosen_endpoint = other.chosen_endpoint;
+    range_values = other.range_values;
+    saved_headers = other.saved_headers;
+    saved_strs = other.saved_strs;
+    saved_ints = other.saved_ints;
+    saved_jsons = other.saved_jsons;
+    span = other.span;
+    sleep_span = other.sleep_span;
+}
+
+script::script(const std::string& path) : script(acquire_script_arena())
 {
     std::ifstream json_file(path);
     if (!json_file)
@@ -32,7 +81,7 @@ script::script(const std::string& path)
     build(json_str);
 }
 
-script::script(const json_reader& input_json)
+script::script(const json_reader& input_json) : script(acquire_script_arena())
 {
     build(input_json.as_string());
 }
@@ -46,13 +95,20 @@ script::~script()
     }
 }
 
-void script::validate_members() const
+void script::validate(const script_definition& def)
 {
     std::set<std::string, std::less<>> unique_ids;
-    check_repeated(unique_ids, vars);
-    check_repeated(unique_ids, ranges);
+    check_repeated(unique_ids, def.vars);
+    check_repeated(unique_ids, def.ranges);
+
+    if (const auto& variable = def.server.selection.variable;
+        def.server.selection.policy == endpoint_policy::HASH && unique_ids.count(variable) == 0)
+    {
+        throw std::invalid_argument("Endpoints must be hashed on a range or a variable, not '" +
+                                    variable + "'");
+    }
 
-    for (const auto& m : messages)
+    for (const auto& m : def.messages)
     {
         for (const std::string forbidden : {"content_type", "content_length"})
         {
@@ -68,18 +124,30 @@ void script::validate_members() const
 void script::build(const std::string& input_json)
 {
     script_reader sr{input_json};
-    ranges = sr.build_ranges();
-    messages = sr.build_messages();
-    server = sr.build_server_info();
-    timeout_ms = sr.build_timeout();
-    vars = sr.build_variables();
-    validate_members();
+    auto def = std::make_shared<script_definition>();
+    def->ranges = sr.build_ranges();
+    const auto messages = sr.build_messages();
+    def->messages.assign(messages.begin(), messages.end());
+    def->server = sr.build_server_info();
+    def->timeout_ms = sr.build_timeout();
+    def->load_profile = sr.build_load_profile();
+    def->vars = sr.build_variables();
+    validate(*def);
+
+    for (auto& m : def->messages)
+    {
+        m.compiled = compile_message(m);
+    }
+    definition = std::move(def);
+
+    // With the variables only. Copies take it as it is, unless they have ranges
+    render();
 }
 
 std::vector<std::string> script::get_message_names() const
 {
     std::vector<std::string> res;
-    for (const auto& m : messages)
+    for (const auto& m : definition->messages)
     {
         res.push_back(m.id);
     }
@@ -87,26 +155,35 @@ std::vector<std::string> script::get_message_names() const
     return res;
 }
 
-bool script::save_from_answer(const answer_type& answer, const msg_modifier& sfa)
+bool script::save_from_answer(const answer_type& answer, const message& m)
 {
     try
     {
-        save_headers(sfa.headers, answer.headers, vars);
+        save_headers(m.sfa.headers, answer.headers, saved_headers);
+        if (m.sfa.body_fields.empty())
+        {
+            return true;
+        }
 
-        for (const auto& [id, mm] : sfa.body_fields)
+        // Parsed once for all the fields, and not validated, as any json would do
+        json_reader ans_json{answer.body, ""};
+        auto path = m.compiled->saved_fields.begin();
+        for (const auto& [id, mm] : m.sfa.body_fields)
         {
-            json_reader ans_json{answer.body, "{}"};
+            const auto& ptr = *path++;
             if (mm.value_type == "string")
             {
-                saved_strs[id] = ans_json.get_value<std::string>(mm.path);
+                // Copied straight from the answer into the arena
+                assign(saved_strs, id, ans_json.get_value<std::string_view>(ptr));
             }
             else if (mm.value_type == "int")
             {
-                saved_ints[id] = ans_json.get_value<int>(mm.path);
+                assign(saved_ints, id, ans_json.get_value<int>(ptr));
             }
             else if (mm.value_type == "object")
             {
-                saved_jsons[id] = ans_json.get_value<json_reader>(mm.path);
+                // Copied out of the answer once, and moved into place
+                assign(saved_jsons, id, ans_json.get_value<json_reader>(ptr));
             }
         }
     }
@@ -117,33 +194,41 @@ bool script::save_from_answer(const answer_type& answer, const msg_modifier& sfa
     return true;
 }
 
-bool script::add_to_request(const std::map<std::string, body_modifier, std::less<>>& atb,
-                            message& m)
+bool script::add_to_request(const message& m)
 {
-    std::string str_modif_body = m.body.empty() ? "{}" : m.body;
-    json_reader modified_body(str_modif_body, "{}");
+    if (m.atb.empty())
+    {
+        return true;
+    }
+
+    const auto current = get_next_body();
+    std::string str_modif_body = current.empty() ? "{}" : std::string(current);
+    json_reader modified_body(str_modif_body, "");
 
     try
     {
-        for (const auto& [id, mm] : atb)
+        auto path = m.compiled->added_fields.begin();
+        for (const auto& [id, mm] : m.atb)
         {
+            const auto& ptr = *path++;
             if (mm.value_type == "string")
             {
-                modified_body.set(mm.path, saved_strs.at(id));
+                modified_body.set<std::string_view>(ptr, saved_value(saved_strs, id));
             }
             else if (mm.value_type == "int")
             {
-                modified_body.set(mm.path, saved_ints.at(id));
+                modified_body.set(ptr, saved_value(saved_ints, id));
             }
             else if (mm.value_type == "object")
             {
-                modified_body.set(mm.path, saved_jsons.at(id));
+                modified_body.set(ptr, saved_value(saved_jsons, id));
             }
         }
 
         if (str_modif_body = modified_body.as_string(); str_modif_body != "{}")
         {
-            m.body = str_modif_body;
+            body = str_modif_body;
+            own_body = true;
         }
     }
     catch (const std::out_of_range&)
@@ -154,26 +239,83 @@ bool script::add_to_request(const std::map<std::string, body_modifier, std::less
     return true;
 }
 
-void replace_in_message(const std::string& old_str, const std::string& new_str, message& m)
+void script::render()
 {
-    std::string str_to_replace = "<" + old_str + ">";
-    boost::replace_all(m.body, str_to_replace, new_str);
-    boost::replace_all(m.url, str_to_replace, new_str);
+    const auto& m = next();
+    own_url = false;
+    own_body = false;
+    own_headers = false;
+    if (!m.compiled)
+    {
+        return;
+    }
 
-    traffic::msg_headers new_headers;
-    for (std::pair<std::string, std::string> p : m.headers)
+    // Ranges and variables first: they were set when the script started, and a header
+    // saved later under the same name does not replace them
+    const auto lookup = [this](const std::string_view name) -> std::optional<std::string_view>
     {
-        boost::replace_all(p.first, str_to_replace, new_str);
-        boost::replace_all(p.second, str_to_replace, new_str);
-        new_headers.insert(p);
+        if (const auto r = range_values.find(name); r != range_values.end())
+        {
+            return r->second;
+        }
+        if (const auto v = definition->vars.find(name); v != definition->vars.end())
+        {
+            return v->second;
+        }
+        if (const auto h = saved_headers.find(name); h != saved_headers.end())
+        {
+            return h->second;
+        }
+        return std::nullopt;
+    };
+
+    // Always from the text of the script, so that rendering it again takes the latest values
+    const auto& compiled = *m.compiled;
+    if (!compiled.url.is_static())
+    {
+        compiled.url.render(url, lookup);
+        own_url = true;
+    }
+    if (!compiled.body.is_static())
+    {
+        compiled.body.render(body, lookup);
+        own_body = true;
+    }
+
+    // Headers without placeholders are already in the template
+    if (compiled.headers)
+    {
+        return;
+    }
+    own_headers = true;
+    if (!compiled.dynamic_header_names)
+    {
+        // Same names, so assigning them reuses the nodes of the last message
+        headers = m.headers;
+        auto header = headers.begin();
+        for (const auto& [k, v] : compiled.dynamic_headers)
+        {
+            v.render(header->second, lookup);
+            ++header;
+        }
+        return;
+    }
+
+    headers.clear();
+    std::string k;
+    std::string v;
+    for (const auto& [key, value] : compiled.dynamic_headers)
+    {
+        key.render(k, lookup);
+        value.render(v, lookup);
+        headers.emplace(k, v);
     }
-    m.headers = std::move(new_headers);
 }
 
 bool script::process_next(const answer_type& last_answer)
 {
     // TODO: if this is an error, validation should fail. Rethink
-    if (!save_from_answer(last_answer, messages.front().sfa))
+    if (!save_from_answer(last_answer, next()))
     {
         if (span)
         {
@@ -182,25 +324,16 @@ bool script::process_next(const answer_type& last_answer)
         return false;
     }
 
-    messages.pop_front();
-
-    auto& next_msg = messages.front();
-    if (!add_to_request(next_msg.atb, next_msg))
-    {
-        return false;
-    }
-
-    for (const auto& [k, v] : vars)
-    {
-        replace_in_message(k, v, next_msg);
-    }
+    ++step;
 
-    return true;
+    // With the headers just saved from the answer too
+    render();
+    return add_to_request(next());
 }
 
 bool script::validate_answer(const answer_type& last_answer) const
 {
-    return last_answer.result_code == messages.front().pass_code;
+    return last_answer.result_code == next().pass_code;
 }
 
 bool script::post_process(const answer_type& last_answer)
@@ -208,27 +341,29 @@ bool script::post_process(const answer_type& last_answer)
     return !is_last() && process_next(last_answer);
 }
 
-void script::replace_in_messages(const std::string& old_str, const std::string& new_str)
-{
-    for (auto& m : messages)
-    {
-        replace_in_message(old_str, new_str, m);
-    }
-}
-
 void script::parse_ranges(const std::map<std::string, int64_t, std::less<>>& current)
 {
     for (const auto& [k, v] : current)
     {
-        replace_in_messages(k, std::to_string(v));
+        const auto& value = assign(range_values, k, std::to_string(v));
+        if (k == definition->server.selection.variable)
+        {
+            endpoint_key = value;
+        }
+    }
+    // The rest of the messages are rendered when their turn comes
+    if (!definition->ranges.empty())
+    {
+        render();
     }
 }
 
 void script::parse_variables()
 {
-    for (const auto& [k, v] : vars)
+    const auto& vars = definition->vars;
+    if (const auto v = vars.find(definition->server.selection.variable); v != vars.end())
     {
-        replace_in_messages(k, v);
+        endpoint_key = v->second;
     }
 }
 
@@ -1,10 +1,16 @@
 #include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string_view>
 #include <utility>
 #include <vector>
 
 #include "json_reader.hpp"
+#include "load_profile.hpp"
 #include "opentelemetry/nostd/shared_ptr.h"
 #include "opentelemetry/trace/tracer.h"
+#include "script_arena.hpp"
 #include "script_structs.hpp"
 
 #pragma once
@@ -14,26 +20,64 @@ namespace otel_trace = opentelemetry::trace;
 
 namespace traffic
 {
+/**
+ * What the script file defines, read, validated and compiled once, and
+ * shared by every running copy of the script, which never changes it.
+ */
+struct script_definition
+{
+    std::vector<message> messages;
+    range_type ranges;
+    server_info server;
+    int timeout_ms;
+    std::shared_ptr<const config::load_profile> load_profile;
+    std::map<std::string, std::string, std::less<>> vars;
+};
+
+/**
+ * A running copy of a script: the shared definition, and the state of this
+ * copy along its flow. Copying it only copies that state, so a fresh copy of
+ * a loaded script is cheap. The state lives in an arena of its own, released
+ * at once with the script.
+ */
 class script
 {
 public:
     script() = delete;
     explicit script(const std::string& path);
     explicit script(const json_reader& input_json);
+    script(const script& other);
+    script& operator=(const script& other) = delete;
 
     ~script();
 
-    const std::string& get_next_url() const { return messages.front().url; };
-    const std::string& get_next_body() const { return messages.front().body; };
-    const std::string& get_next_method() const { return messages.front().method; };
-    const std::string& get_next_msg_name() const { return messages.front().id; };
-    const msg_headers& get_next_headers() const { return messages.front().headers; };
-
-    const range_type& get_ranges() const { return ranges; };
-    const std::string& get_server_dns() const { return server.dns; };
-    const std::string& get_server_port() const { return server.port; };
-    bool is_server_secure() const { return server.secure; };
-    int get_timeout_ms() const { return timeout_ms; };
+    // Valid until the script moves on to the next message
+    std::string_view get_next_url() const { return own_url ? url : view(next().url); };
+    std::string_view get_next_body() const { return own_body ? body : view(next().body); };
+    const std::string& get_next_method() const { return next().method; };
+    const std::string& get_next_msg_name() const { return next().id; };
+    const msg_headers& get_next_headers() const { return own_headers ? headers : next().headers; };
+    const message_template* get_next_template() const { return next().compiled.get(); }
+
+    const range_type& get_ranges() const { return definition->ranges; };
+    const std::string& get_server_dns() const { return definition->server.dns; };
+    const std::string& get_server_port() const { return definition->server.port; };
+    bool is_server_secure() const { return definition->server.secure; };
+    const std::vector<endpoint>& get_endpoints() const { return definition->server.endpoints; };
+    const endpoint_selection& get_endpoint_selection() const
+    {
+        return definition->server.selection;
+    };
+    // Value of the variable endpoints are hashed on, once ranges and variables are parsed
+    const std::string& get_endpoint_key() const { return endpoint_key; };
+    // Endpoint the script was sent to, so that all its requests go to the same one
+    std::optional<std::size_t> get_endpoint() const { return chosen_endpoint; };
+    void set_endpoint(const std::size_t e) { chosen_endpoint = e; };
+    int get_timeout_ms() const { return definition->timeout_ms; };
+    const std::shared_ptr<const config::load_profile>& get_load_profile() const
+    {
+        return definition->load_profile;
+    };
 
     bool post_process(const answer_type& last_answer);
     bool validate_answer(const answer_type& last_answer) const;
@@ -50,25 +94,50 @@ public:
     const otel_std::shared_ptr<otel_trace::Span>& get_span() const { return span; };
 
 private:
-    void validate_members() const;
+    // With its containers in the arena, and nothing else
+    explicit script(script_arena_ptr a);
+
+    static void validate(const script_definition& def);
+    static std::string_view view(const std::string& s) { return s; }
     void build(const std::string& input_json);
 
+    const message& next() const { return definition->messages[step]; }
     bool process_next(const answer_type& last_answer);
-    bool save_from_answer(const answer_type& answer, const msg_modifier& sfa);
-    bool add_to_request(const std::map<std::string, body_modifier, std::less<>>& atb, message& m);
-
-    bool is_last() const { return messages.size() == 1; };
-    void replace_in_messages(const std::string& old_str, const std::string& new_str);
-
-    std::deque<message> messages;
-    range_type ranges;
-    server_info server;
-    int timeout_ms;
-
-    std::map<std::string, std::string, std::less<>> vars;
-    std::map<std::string, std::string, std::less<>> saved_strs;
-    std::map<std::string, int, std::less<>> saved_ints;
-    std::map<std::string, json_reader, std::less<>> saved_jsons;
+    // Both with the paths compiled for the message
+    bool save_from_answer(const answer_type& answer, const message& m);
+    bool add_to_request(const message& m);
+
+    bool is_last() const { return step + 1 == definition->messages.size(); };
+    // Fills the placeholders of the next message with the values of the ranges and the
+    // variables
+    void render();
+
+    // First, so that it is released after everything allocated in it
+    script_arena_ptr arena;
+
+    std::shared_ptr<const script_definition> definition;
+    // Index of the next message of the flow
+    std::size_t step = 0;
+    // The parts of the next message that were rendered or changed, and are used instead of
+    // those of the definition. Their buffers are reused along the flow
+    arena_string url;
+    arena_string body;
+    msg_headers headers;
+    bool own_url = false;
+    bool own_body = false;
+    bool own_headers = false;
+
+    std::string endpoint_key;
+    std::optional<std::size_t> chosen_endpoint;
+
+    // Values the ranges take in this script
+    arena_map<arena_string> range_values;
+    // Headers saved from the answers. Variables of the same name win over them
+    arena_map<arena_string> saved_headers;
+    arena_map<arena_string> saved_strs;
+    arena_map<int> saved_ints;
+    // Their nodes only, the documents have allocators of their own
+    arena_map<json_reader> saved_jsons;
 
     otel_std::shared_ptr<otel_trace::Span> span;
     otel_std::shared_ptr<otel_trace::Span> sleep_span;
@@ -0,0 +1,93 @@
+#include "script_arena.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <new>
+
+namespace traffic
+{
+namespace
+{
+// Enough for the state of most scripts, rendered bodies aside
+constexpr std::size_t initial_arena_size{1024};
+// Beyond that, a script takes the rest from the heap every time
+constexpr std::size_t max_arena_size{64 * 1024};
+// Arenas kept for the next scripts. The rest are freed
+constexpr std::size_t max_free_arenas{1024};
+
+struct arena_free_list
+{
+    std::mutex mtx;
+    std::vector<std::unique_ptr<script_arena>> arenas;
+};
+
+// Never destroyed, so that scripts freed while the program exits still find it
+arena_free_list& free_list()
+{
+    static auto* list = new arena_free_list;
+    return *list;
+}
+}  // namespace
+
+script_arena::script_arena(const std::size_t size) : buffer(size)
+{
+    memory.emplace(buffer.data(), buffer.size(), &overflow);
+}
+
+void script_arena::reset()
+{
+    memory.reset();
+    if (overflow.allocated > 0 && buffer.size() < max_arena_size)
+    {
+        buffer.resize(std::min(max_arena_size, buffer.size() + overflow.allocated));
+    }
+    overflow.allocated = 0;
+    memory.emplace(buffer.data(), buffer.size(), &overflow);
+}
+
+void* script_arena::overflow_resource::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+    allocated += bytes;
+    return ::operator new(bytes, std::align_val_t(alignment));
+}
+
+void script_arena::overflow_resource::do_deallocate(void* p, std::size_t bytes,
+                                                    std::size_t alignment)
+{
+    ::operator delete(p, bytes, std::align_val_t(alignment));
+}
+
+bool script_arena::overflow_resource::do_is_equal(
+    const std::pmr::memory_resource& other) const noexcept
+{
+    return this == &other;
+}
+
+void script_arena_recycler::operator()(script_arena* arena) const
+{
+    std::unique_ptr<script_arena> owned(arena);
+    // Released outside the lock: whatever did not fit in the buffer goes back to the heap
+    owned->reset();
+    auto& list = free_list();
+    std::scoped_lock guard(list.mtx);
+    if (list.arenas.size() < max_free_arenas)
+    {
+        list.arenas.push_back(std::move(owned));
+    }
+}
+
+script_arena_ptr acquire_script_arena()
+{
+    auto& list = free_list();
+    {
+        std::scoped_lock guard(list.mtx);
+        if (!list.arenas.empty())
+        {
+            script_arena_ptr arena(list.arenas.back().release());
+            list.arenas.pop_back();
+            return arena;
+        }
+    }
+    return script_arena_ptr(new script_arena(initial_arena_size));
+}
+}  // namespace traffic
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace traffic
+{
+/**
+ * Memory for the state of a running script. Whatever it renders or saves
+ * from the answers is carved out of a single buffer, and all of it is given
+ * back at once when the script is over. Arenas are recycled, and their buffer
+ * grows to what the scripts needed, so most scripts never reach malloc.
+ */
+class script_arena
+{
+public:
+    explicit script_arena(const std::size_t size);
+
+    script_arena(const script_arena&) = delete;
+    script_arena& operator=(const script_arena&) = delete;
+
+    std::pmr::memory_resource* resource() { return &*memory; }
+    std::size_t capacity() const { return buffer.size(); }
+
+    // Forgets everything allocated, and makes room for what did not fit in the buffer
+    void reset();
+
+private:
+    // Takes what does not fit in the buffer from the heap, and counts it
+    class overflow_resource : public std::pmr::memory_resource
+    {
+    public:
+        std::size_t allocated = 0;
+
+    private:
+        void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+        void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+    };
+
+    std::vector<std::byte> buffer;
+    overflow_resource overflow;
+    std::optional<std::pmr::monotonic_buffer_resource> memory;
+};
+
+// Gives the arena back to the free list once its script is gone
+struct script_arena_recycler
+{
+    void operator()(script_arena* arena) const;
+};
+
+using script_arena_ptr = std::unique_ptr<script_arena, script_arena_recycler>;
+
+// An arena given back by a script, or a new one. From any thread
+script_arena_ptr acquire_script_arena();
+
+using arena_string = std::pmr::string;
+template <typename T>
+using arena_map = std::pmr::map<arena_string, T, std::less<>>;
+
+// Arena strings cannot be compared with std::string, so their maps are searched by view
+template <typename Map, typename Value>
+auto& assign(Map& map, const std::string_view key, Value&& value)
+{
+    if (const auto found = map.find(key); found != map.end())
+    {
+        found->second = std::forward<Value>(value);
+        return found->second;
+    }
+    return map.emplace(key, std::forward<Value>(value)).first->second;
+}
+}  // namespace traffic
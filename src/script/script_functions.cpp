@@ -10,21 +10,6 @@
 
 namespace traffic
 {
-void save_headers(const std::map<std::string, std::string, std::less<>>& headers2save,
-                  const nghttp2::asio_http2::header_map& answer_headers,
-                  std::map<std::string, std::string, std::less<>>& vars)
-{
-    for (const auto& [id, header_field] : headers2save)
-    {
-        const auto& header_to_save = answer_headers.find(header_field);
-        if (header_to_save == answer_headers.end())
-        {
-            throw std::out_of_range("Header " + header_field + " not found.");
-        }
-        vars.insert_or_assign(id, header_to_save->second.value);
-    }
-}
-
 void save_body_fields(const std::map<std::string, std::string, std::less<>>& fields2save,
                       const std::string& body_str,
                       std::map<std::string, std::string, std::less<>>& vars)
@@ -4,8 +4,11 @@
 
 #include <map>
 #include <set>
+#include <stdexcept>
 #include <string>
 
+#include "script_arena.hpp"
+
 namespace traffic
 {
 template <typename T>
@@ -22,9 +25,21 @@ void check_repeated(std::set<std::string, std::less<>>& unique_ids,
     }
 }
 
+// Into a map of strings, of the arena of a script or not
+template <typename Map>
 void save_headers(const std::map<std::string, std::string, std::less<>>& headers2save,
-                  const nghttp2::asio_http2::header_map& answer_headers,
-                  std::map<std::string, std::string, std::less<>>& vars);
+                  const nghttp2::asio_http2::header_map& answer_headers, Map& vars)
+{
+    for (const auto& [id, header_field] : headers2save)
+    {
+        const auto& header_to_save = answer_headers.find(header_field);
+        if (header_to_save == answer_headers.end())
+        {
+            throw std::out_of_range("Header " + header_field + " not found.");
+        }
+        assign(vars, id, header_to_save->second.value);
+    }
+}
 
 void save_body_fields(const std::map<std::string, std::string, std::less<>>& fields2save,
                       const std::string& body_str,
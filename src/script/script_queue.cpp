@@ -1,5 +1,7 @@
 #include "script_queue.hpp"
 
+#include <algorithm>
+#include <limits>
 #include <optional>
 
 namespace traffic
@@ -8,14 +10,16 @@ void script_queue::update_currents_in_range(const range_type& ranges)
 {
     for (const auto& [k, v] : ranges)
     {
+        const int64_t first = v.first + range_offset % (int64_t(v.second) - v.first + 1);
         const auto& current = current_in_range.find(k);
         if (current == current_in_range.end())
         {
-            current_in_range.try_emplace(k, v.first);
+            current_in_range.try_emplace(k, first);
         }
         else
         {
-            current_in_range[k] = current->second + 1 <= v.second ? current->second + 1 : v.first;
+            const int64_t next = current->second + range_stride;
+            current_in_range[k] = next <= v.second ? next : first;
         }
     }
 }
@@ -31,8 +35,9 @@ std::shared_ptr<script> script_queue::get_next_script()
         return s;
     }
 
-    if (!window_closed)
+    if (!window_closed && (!max_in_flight || in_flight < max_in_flight))
     {
+        // Only the state is copied, the definition is shared with the loaded script
         auto script_to_start = std::make_shared<script>(*new_script);
         update_currents_in_range(script_to_start->get_ranges());
         script_to_start->parse_ranges(current_in_range);
@@ -45,6 +50,21 @@ std::shared_ptr<script> script_queue::get_next_script()
     return nullptr;
 }
 
+int64_t script_queue::get_room() const
+{
+    read_lock rd_lock(rw_mutex);
+    const auto waiting = int64_t(scripts.size());
+    if (window_closed)
+    {
+        return waiting;
+    }
+    if (!max_in_flight)
+    {
+        return std::numeric_limits<int64_t>::max();
+    }
+    return waiting + std::max<int64_t>(0, max_in_flight - in_flight);
+}
+
 void script_queue::enqueue_script(std::shared_ptr<script>&& s, const answer_type& last_answer)
 {
     if (!s->post_process(last_answer))
@@ -21,6 +21,14 @@ class script_queue : public script_queue_if
 public:
     script_queue() = delete;
     explicit script_queue(const script& s) : new_script(std::make_unique<script>(s)) {}
+    /**
+     * Queue for one of count engine shards. Range values are strided among the
+     * shards, so that each of them uses a different subset of every range.
+     */
+    script_queue(const script& s, const int64_t index, const int64_t count)
+        : new_script(std::make_unique<script>(s)), range_offset(index), range_stride(count)
+    {
+    }
     ~script_queue() override = default;
 
     std::shared_ptr<script> get_next_script() override;
@@ -29,6 +37,10 @@ public:
     bool has_pending_scripts() const override { return in_flight != 0; };
     void close_window() override { window_closed.store(true); };
     bool is_window_closed() override { return window_closed.load(); }
+    int64_t get_room() const override;
+
+    // No new scripts are started while max scripts are in flight. 0 means no limit
+    void set_max_in_flight(const int64_t max) { max_in_flight = max; }
 
 private:
     void update_currents_in_range(const range_type& ranges);
@@ -37,6 +49,9 @@ private:
     std::deque<std::shared_ptr<script>> scripts;
     std::atomic<int64_t> in_flight{0};
     std::atomic<bool> window_closed{false};
+    int64_t max_in_flight{0};
+    int64_t range_offset{0};
+    int64_t range_stride{1};
     mutable mutex_type rw_mutex;
 
 protected:
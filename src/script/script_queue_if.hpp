@@ -16,5 +16,8 @@ public:
     virtual bool has_pending_scripts() const = 0;
     virtual void close_window() = 0;
     virtual bool is_window_closed() = 0;
+    // Scripts that can be served right now: those waiting for their next request, plus
+    // the new ones that can be started without exceeding the limit
+    virtual int64_t get_room() const = 0;
 };
 }  // namespace traffic
@@ -142,10 +142,47 @@ body_modifier script_reader::build_body_modifier()
 server_info script_reader::build_server_info()
 {
     server_info server;
-    server.dns = json_rdr.get_value<std::string>("/dns");
-    server.port = json_rdr.get_value<std::string>("/port");
     server.secure = json_rdr.is_present("/secure") ? json_rdr.get_value<bool>("/secure") : false;
+    if (!json_rdr.is_present("/endpoints"))
+    {
+        server.dns = json_rdr.get_value<std::string>("/dns");
+        server.port = json_rdr.get_value<std::string>("/port");
+        server.endpoints.push_back({server.dns, server.port, 1});
+        return server;
+    }
+
+    for (std::size_t i = 0; json_rdr.is_present("/endpoints/" + std::to_string(i)); ++i)
+    {
+        const std::string path = "/endpoints/" + std::to_string(i);
+        endpoint ep{json_rdr.get_value<std::string>(path + "/dns"),
+                    json_rdr.get_value<std::string>(path + "/port"), 1};
+        if (json_rdr.is_present(path + "/weight"))
+        {
+            const auto weight = json_rdr.get_value<int>(path + "/weight");
+            if (weight < 1 || unsigned(weight) > max_endpoint_weight)
+            {
+                throw std::invalid_argument("Weight of " + path + " must be from 1 to " +
+                                            std::to_string(max_endpoint_weight));
+            }
+            ep.weight = unsigned(weight);
+        }
+        server.endpoints.push_back(std::move(ep));
+    }
+    server.dns = server.endpoints.front().dns;
+    server.port = server.endpoints.front().port;
 
+    if (json_rdr.is_present("/endpoint_selection"))
+    {
+        if (json_rdr.get_value<std::string>("/endpoint_selection/policy") == "hash")
+        {
+            server.selection.policy = endpoint_policy::HASH;
+        }
+        if (json_rdr.is_present("/endpoint_selection/variable"))
+        {
+            server.selection.variable =
+                json_rdr.get_value<std::string>("/endpoint_selection/variable");
+        }
+    }
     return server;
 }
 
@@ -154,6 +191,41 @@ int script_reader::build_timeout()
     return json_rdr.get_value<int>("/timeout");
 }
 
+std::shared_ptr<const config::load_profile> script_reader::build_load_profile()
+{
+    if (!json_rdr.is_present("/load_profile"))
+    {
+        return nullptr;
+    }
+
+    script_reader sr_profile{json_rdr.get_value<json_reader>("/load_profile")};
+    auto& lp = sr_profile.json_rdr;
+    const auto shape = lp.get_value<std::string>("/shape");
+    if (shape == "ramp")
+    {
+        return std::make_shared<config::load_profile>(config::load_profile::ramp(
+            lp.get_value<double>("/from"), lp.get_value<double>("/to"),
+            lp.get_value<double>("/seconds")));
+    }
+    if (shape == "step")
+    {
+        return std::make_shared<config::load_profile>(config::load_profile::step(
+            lp.get_value<double>("/from"), lp.get_value<double>("/to"),
+            lp.get_value<double>("/at")));
+    }
+    if (shape == "stairs")
+    {
+        return std::make_shared<config::load_profile>(config::load_profile::staircase(
+            lp.get_value<double>("/from"), lp.get_value<double>("/increment"),
+            lp.get_value<double>("/every"), lp.get_value<double>("/to")));
+    }
+
+    return std::make_shared<config::load_profile>(
+        config::load_profile::sine(lp.get_value<double>("/mean"),
+                                   lp.get_value<double>("/amplitude"),
+                                   lp.get_value<double>("/period")));
+}
+
 std::map<std::string, std::string, std::less<>> script_reader::build_variables()
 {
     std::map<std::string, std::string, std::less<>> vars;
@@ -1,8 +1,10 @@
 #pragma once
 
 #include <map>
+#include <memory>
 
 #include "json_reader.hpp"
+#include "load_profile.hpp"
 
 namespace traffic
 {
@@ -13,6 +15,7 @@ public:
 
     server_info build_server_info();
     int build_timeout();
+    std::shared_ptr<const config::load_profile> build_load_profile();
     range_type build_ranges();
     std::deque<message> build_messages();
     message build_message(std::string_view m);
@@ -12,10 +12,12 @@ const std::string schema = R"(
   "required": [
     "flow",
     "messages",
-    "dns",
-    "port",
     "timeout"
   ],
+  "oneOf": [
+    {"required": ["dns", "port"]},
+    {"required": ["endpoints"]}
+  ],
   "additionalProperties": false,
   "properties": {
     "dns": {
@@ -24,12 +26,58 @@ const std::string schema = R"(
     "port": {
       "type": "string"
     },
+    "endpoints": {
+      "type": "array",
+      "minItems": 1,
+      "items": {
+        "type": "object",
+        "required": ["dns", "port"],
+        "additionalProperties": false,
+        "properties": {
+          "dns": {"type": "string"},
+          "port": {"type": "string"},
+          "weight": {"type": "integer", "minimum": 1, "maximum": 1000}
+        }
+      }
+    },
+    "endpoint_selection": {
+      "type": "object",
+      "required": ["policy"],
+      "additionalProperties": false,
+      "properties": {
+        "policy": {
+          "type": "string",
+          "enum": ["weighted-round-robin", "hash"]
+        },
+        "variable": {"type": "string"}
+      }
+    },
     "secure": {
       "type": "boolean"
     },
     "timeout": {
       "type": "integer"
     },
+    "load_profile": {
+      "type": "object",
+      "required": ["shape"],
+      "additionalProperties": false,
+      "properties": {
+        "shape": {
+          "type": "string",
+          "enum": ["ramp", "step", "stairs", "sine"]
+        },
+        "from": {"type": "number", "minimum": 0},
+        "to": {"type": "number", "minimum": 0},
+        "seconds": {"type": "number", "exclusiveMinimum": 0},
+        "at": {"type": "number", "exclusiveMinimum": 0},
+        "increment": {"type": "number", "exclusiveMinimum": 0},
+        "every": {"type": "number", "exclusiveMinimum": 0},
+        "mean": {"type": "number", "exclusiveMinimum": 0},
+        "amplitude": {"type": "number", "minimum": 0},
+        "period": {"type": "number", "exclusiveMinimum": 0}
+      }
+    },
     "variables": {
       "type": "object",
       "minProperties": 1,
@@ -4,7 +4,10 @@
 
 #include <deque>
 #include <map>
+#include <memory>
 #include <optional>
+#include <string>
+#include <vector>
 
 namespace nghttp2::asio_http2
 {
@@ -17,6 +20,8 @@ static inline bool operator==(const nghttp2::asio_http2::header_value& lhs,
 
 namespace traffic
 {
+struct message_template;
+
 // name_to_overwrite(min, max)
 using range_type = std::map<std::string, std::pair<int, int>, std::less<>>;
 using msg_headers = std::map<std::string, std::string, std::less<>>;
@@ -66,12 +71,41 @@ struct message
 
     msg_modifier sfa;
     std::map<std::string, body_modifier, std::less<>> atb;
+
+    // Built when the script is loaded
+    std::shared_ptr<const message_template> compiled;
+};
+
+// Highest weight an endpoint may take
+constexpr unsigned max_endpoint_weight{1000};
+
+// One of the replicas traffic is spread over, receiving a share proportional to its weight
+struct endpoint
+{
+    std::string dns;
+    std::string port;
+    unsigned weight = 1;
+};
+
+enum class endpoint_policy
+{
+    WEIGHTED_ROUND_ROBIN,
+    HASH  // consistent hash on the value a script takes for a range or a variable
+};
+
+struct endpoint_selection
+{
+    endpoint_policy policy = endpoint_policy::WEIGHTED_ROUND_ROBIN;
+    std::string variable;
 };
 
 struct server_info
 {
+    // Of the first endpoint
     std::string dns;
     std::string port;
     bool secure;
+    std::vector<endpoint> endpoints;
+    endpoint_selection selection;
 };
 }  // namespace traffic
@@ -0,0 +1,195 @@
+#include "arrival.hpp"
+
+#include <cmath>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+
+namespace engine
+{
+double random_source::uniform()
+{
+    // splitmix64
+    state += 0x9E3779B97F4A7C15ULL;
+    uint64_t z = state;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z = z ^ (z >> 31);
+    return double((z >> 11) + 1) * 0x1.0p-53;
+}
+
+poisson_arrival::poisson_arrival(uint64_t seed) : rnd(seed), gaps(block_size), next(block_size) {}
+
+void poisson_arrival::refill()
+{
+    double sum{0};
+    for (auto& gap : gaps)
+    {
+        gap = -std::log(rnd.uniform());
+        sum += gap;
+    }
+
+    const double scale = double(gaps.size()) / sum;
+    for (auto& gap : gaps)
+    {
+        gap *= scale;
+    }
+    next = 0;
+}
+
+double poisson_arrival::next_gap()
+{
+    if (next == gaps.size())
+    {
+        refill();
+    }
+    return gaps[next++];
+}
+
+jittered_arrival::jittered_arrival(double jitter, uint64_t seed)
+    : rnd(seed), jitter(jitter), last_offset(0)
+{
+}
+
+double jittered_arrival::next_gap()
+{
+    const double offset = (rnd.uniform() - 0.5) * jitter;
+    const double gap = 1.0 + offset - last_offset;
+    last_offset = offset;
+    return gap;
+}
+
+trace_arrival::trace_arrival(const std::vector<double>& trace) : gaps(trace), next(0)
+{
+    const double mean = std::accumulate(gaps.begin(), gaps.end(), 0.0) / double(gaps.size());
+    for (auto& gap : gaps)
+    {
+        gap /= mean;
+    }
+}
+
+double trace_arrival::next_gap()
+{
+    if (next == gaps.size())
+    {
+        next = 0;
+    }
+    return gaps[next++];
+}
+
+std::unique_ptr<arrival> make_arrival(const config::arrival_config& cfg)
+{
+    switch (cfg.mode)
+    {
+        case config::arrival_mode::POISSON:
+            return std::make_unique<poisson_arrival>(cfg.seed);
+        case config::arrival_mode::JITTER:
+            return std::make_unique<jittered_arrival>(cfg.jitter, cfg.seed);
+        case config::arrival_mode::TRACE:
+            return std::make_unique<trace_arrival>(cfg.trace);
+        default:
+            return std::make_unique<constant_arrival>();
+    }
+}
+
+std::vector<double> read_trace(const std::string& path)
+{
+    std::ifstream trace_file(path);
+    if (!trace_file)
+    {
+        throw std::invalid_argument("Trace file " + path + " not found.");
+    }
+
+    std::vector<double> trace;
+    double sum{0};
+    std::string line;
+    while (std::getline(trace_file, line))
+    {
+        if (line.empty() || line.front() == '#')
+        {
+            continue;
+        }
+
+        std::istringstream ss(line);
+        double gap{0};
+        if (!(ss >> gap) || gap < 0)
+        {
+            throw std::invalid_argument("Wrong inter-arrival time in trace " + path + ": " + line);
+        }
+        trace.push_back(gap);
+        sum += gap;
+    }
+
+    if (trace.empty() || sum <= 0)
+    {
+        throw std::invalid_argument("Trace " + path + " does not contain any inter-arrival time.");
+    }
+
+    return trace;
+}
+
+config::arrival_config parse_arrival(const std::string& definition, uint64_t seed)
+{
+    config::arrival_config cfg;
+    cfg.seed = seed;
+
+    const auto separator = definition.find(':');
+    const std::string mode = definition.substr(0, separator);
+    const std::string arg = separator == std::string::npos ? "" : definition.substr(separator + 1);
+
+    if (mode == "constant")
+    {
+        cfg.mode = config::arrival_mode::CONSTANT;
+    }
+    else if (mode == "poisson")
+    {
+        cfg.mode = config::arrival_mode::POISSON;
+    }
+    else if (mode == "jitter")
+    {
+        cfg.mode = config::arrival_mode::JITTER;
+        try
+        {
+            cfg.jitter = std::stod(arg);
+        }
+        catch (const std::logic_error&)
+        {
+            throw std::invalid_argument("Jitter needs a fraction of the period, e.g. jitter:0.5");
+        }
+
+        if (cfg.jitter < 0 || cfg.jitter > 1)
+        {
+            throw std::invalid_argument("Jitter must be between 0 and 1.");
+        }
+    }
+    else if (mode == "trace")
+    {
+        cfg.mode = config::arrival_mode::TRACE;
+        cfg.trace = read_trace(arg);
+    }
+    else
+    {
+        throw std::invalid_argument("Unknown arrival mode: " + definition);
+    }
+
+    return cfg;
+}
+
+std::string to_string(const config::arrival_config& cfg)
+{
+    switch (cfg.mode)
+    {
+        case config::arrival_mode::POISSON:
+            return "poisson (seed " + std::to_string(cfg.seed) + ")";
+        case config::arrival_mode::JITTER:
+            return "jitter " + std::to_string(cfg.jitter) + " (seed " + std::to_string(cfg.seed) +
+                   ")";
+        case config::arrival_mode::TRACE:
+            return "trace replay (" + std::to_string(cfg.trace.size()) + " gaps)";
+        default:
+            return "constant";
+    }
+}
+
+}  // namespace engine
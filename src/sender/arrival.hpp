@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "params.hpp"
+
+namespace engine
+{
+/**
+ * An arrival process decides how far apart two consecutive requests are.
+ * Gaps are expressed in units of the configured period (mean of 1.0), so
+ * the sender only needs to scale them and the long-run rate stays exact.
+ * None of the implementations allocate once constructed.
+ */
+class arrival
+{
+public:
+    virtual ~arrival() = default;
+
+    virtual double next_gap() = 0;
+};
+
+/**
+ * Small, reproducible random source. Unlike std distributions, the sequence
+ * it produces for a given seed does not depend on the standard library.
+ */
+class random_source
+{
+public:
+    explicit random_source(uint64_t seed) : state(seed) {}
+
+    // Uniform double in (0, 1]
+    double uniform();
+
+private:
+    uint64_t state;
+};
+
+class constant_arrival : public arrival
+{
+public:
+    double next_gap() override { return 1.0; }
+};
+
+/**
+ * Exponential inter-arrival times. Samples are precomputed in blocks whose
+ * sum is normalized to the block size, so every block keeps the exact rate.
+ */
+class poisson_arrival : public arrival
+{
+public:
+    static constexpr std::size_t block_size = 1024;
+
+    explicit poisson_arrival(uint64_t seed);
+
+    double next_gap() override;
+
+private:
+    void refill();
+
+    random_source rnd;
+    std::vector<double> gaps;
+    std::size_t next;
+};
+
+/**
+ * Every request is moved randomly up to +-jitter/2 periods around its nominal
+ * time. As the nominal grid is kept, the drift never accumulates.
+ */
+class jittered_arrival : public arrival
+{
+public:
+    jittered_arrival(double jitter, uint64_t seed);
+
+    double next_gap() override;
+
+private:
+    random_source rnd;
+    double jitter;
+    double last_offset;
+};
+
+/**
+ * Replays a recorded sequence of inter-arrival gaps in a loop. The trace is
+ * normalized to a mean of 1.0 so that it gives the shape and -r the rate.
+ */
+class trace_arrival : public arrival
+{
+public:
+    explicit trace_arrival(const std::vector<double>& trace);
+
+    double next_gap() override;
+
+private:
+    std::vector<double> gaps;
+    std::size_t next;
+};
+
+std::unique_ptr<arrival> make_arrival(const config::arrival_config& cfg);
+
+/**
+ * Builds an arrival configuration from its command line definition:
+ * constant | poisson | jitter:<fraction> | trace:<path>
+ * Throws std::invalid_argument when the definition is not valid.
+ */
+config::arrival_config parse_arrival(const std::string& definition, uint64_t seed);
+
+std::vector<double> read_trace(const std::string& path);
+
+std::string to_string(const config::arrival_config& cfg);
+
+}  // namespace engine
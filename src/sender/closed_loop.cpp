@@ -0,0 +1,85 @@
+#include "closed_loop.hpp"
+
+#include "client.hpp"
+#include "params.hpp"
+
+using namespace std::chrono;
+
+namespace engine
+{
+closed_loop::closed_loop(boost::asio::io_context& io_ctx,
+                         std::unique_ptr<http2_client::client>&& c,
+                         std::shared_ptr<config::params> params, const std::size_t concurrency,
+                         std::promise<void>&& p)
+    : io_ctx(io_ctx),
+      timer(io_ctx),
+      client(std::move(c)),
+      params(params),
+      prom(std::move(p)),
+      pending_retries(0),
+      finished(false)
+{
+    // Completions come from the connection threads, so they are moved to our own io_context
+    client->set_completion_handler(
+        [this](bool sent)
+        { boost::asio::post(this->io_ctx, [this, sent]() { on_completion(sent); }); });
+
+    boost::asio::post(io_ctx,
+                      [this, concurrency]()
+                      {
+                          for (std::size_t i = 0; i < concurrency; ++i)
+                          {
+                              client->send();
+                          }
+                          check();
+                      });
+}
+
+void closed_loop::on_completion(const bool sent)
+{
+    if (finished)
+    {
+        return;
+    }
+
+    if (sent)
+    {
+        client->send();
+    }
+    else
+    {
+        ++pending_retries;
+    }
+}
+
+void closed_loop::check()
+{
+    const bool in_window = steady_clock::now() - params->init_time < seconds(params->duration);
+    if (!in_window)
+    {
+        client->close_window();
+        if (client->has_finished())
+        {
+            finished = true;
+            prom.set_value();
+            return;
+        }
+    }
+
+    for (; pending_retries > 0; --pending_retries)
+    {
+        client->send();
+    }
+
+    timer.expires_after(check_period);
+    timer.async_wait(
+        [this](const boost::system::error_code& e)
+        {
+            if (!e)
+            {
+                check();
+            }
+        });
+}
+
+}  // namespace engine
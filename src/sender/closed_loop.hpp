@@ -0,0 +1,51 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <cstddef>
+#include <future>
+#include <memory>
+
+namespace config
+{
+class params;
+}
+namespace http2_client
+{
+class client;
+}
+
+namespace engine
+{
+/**
+ * Closed-loop driver: instead of following a rate, it keeps a fixed number of
+ * requests (virtual users) in flight. As soon as one of them is over, the next
+ * step of its script, or a new script, is sent. Requests that could not even
+ * be sent (e.g. while reconnecting) are retried in the next check of the
+ * window, so that a broken connection does not turn into a busy loop.
+ */
+class closed_loop
+{
+public:
+    closed_loop() = delete;
+    closed_loop(boost::asio::io_context& io_ctx, std::unique_ptr<http2_client::client>&& c,
+                std::shared_ptr<config::params> params, const std::size_t concurrency,
+                std::promise<void>&& p);
+
+    ~closed_loop() = default;
+
+    static constexpr std::chrono::milliseconds check_period{100};
+
+private:
+    void on_completion(const bool sent);
+    void check();
+
+    boost::asio::io_context& io_ctx;
+    boost::asio::steady_timer timer;
+    std::unique_ptr<http2_client::client> client;
+    std::shared_ptr<config::params> params;
+    std::promise<void> prom;
+    // Users whose last request could not be sent, waiting for the next check
+    std::size_t pending_retries;
+    bool finished;
+};
+}  // namespace engine
@@ -0,0 +1,181 @@
+#include "rate_search.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+double to_number(const std::string& key, const std::string& value)
+{
+    try
+    {
+        std::size_t read{0};
+        const double number = std::stod(value, &read);
+        if (read == value.size())
+        {
+            return number;
+        }
+    }
+    catch (const std::logic_error&)
+    {
+    }
+    throw std::invalid_argument("Wrong value for " + key + " in search: " + value);
+}
+}  // namespace
+
+namespace engine
+{
+rate_search::rate_search(const search_config& cfg)
+    : cfg(cfg),
+      rate(cfg.start_rate),
+      lower(0),
+      upper(std::numeric_limits<double>::infinity()),
+      done(false),
+      period(0),
+      ok(0),
+      failed(0),
+      sent_rate(0),
+      latency_ms(0)
+{
+}
+
+double rate_search::on_period(const period_result& r)
+{
+    if (done || ++period <= cfg.warmup_periods)
+    {
+        return rate;
+    }
+
+    ok += r.ok;
+    failed += r.failed;
+    sent_rate += r.sent_rate;
+    latency_ms = std::max(latency_ms, r.latency_ms);
+    if (period == cfg.warmup_periods + cfg.periods)
+    {
+        finish_step();
+    }
+    return rate;
+}
+
+void rate_search::finish_step()
+{
+    const auto finished = ok + failed;
+    const double success = finished > 0 ? double(ok) / double(finished) : 0;
+    const double mean_sent_rate = sent_rate / cfg.periods;
+    const bool passed = success >= cfg.objectives.min_success &&
+                        latency_ms <= cfg.objectives.max_latency_ms &&
+                        mean_sent_rate >= min_sent_fraction * rate;
+    steps.push_back({rate, mean_sent_rate, success, latency_ms, passed});
+
+    (passed ? lower : upper) = rate;
+    if (std::isinf(upper))
+    {
+        rate *= 2;
+    }
+    else if (upper - lower <= std::max(cfg.precision * upper, min_interval))
+    {
+        done = true;
+        rate = lower;
+    }
+    else
+    {
+        rate = (lower + upper) / 2;
+    }
+
+    period = 0;
+    ok = 0;
+    failed = 0;
+    sent_rate = 0;
+    latency_ms = 0;
+}
+
+void rate_search::report(std::ostream& out) const
+{
+    std::ostringstream latency_header;
+    latency_header << "P" << cfg.objectives.percentile * 100 << "(ms)";
+
+    out << std::setw(6) << "Step" << std::setw(15) << "Rate(req/s)" << std::setw(15) << "Sent/s"
+        << std::setw(15) << "Success" << std::setw(15) << latency_header.str() << std::setw(10)
+        << "Result" << std::endl;
+    for (std::size_t i = 0; i < steps.size(); ++i)
+    {
+        const auto& s = steps[i];
+        out << std::setw(6) << i + 1 << std::setw(15) << s.rate << std::setw(15) << s.sent_rate
+            << std::setw(15) << s.success << std::setw(15) << s.latency_ms << std::setw(10)
+            << (s.passed ? "OK" : "FAIL") << std::endl;
+    }
+
+    if (lower == 0)
+    {
+        out << "No rate met the objectives" << std::endl;
+    }
+    else if (done)
+    {
+        out << "Max sustainable rate: " << lower << " req/s" << std::endl;
+    }
+    else
+    {
+        out << "Search not finished. Highest rate meeting the objectives: " << lower << " req/s"
+            << std::endl;
+    }
+}
+
+search_config parse_search(const std::string& definition)
+{
+    search_config cfg;
+    std::istringstream fields(definition);
+    std::string field;
+    while (std::getline(fields, field, ','))
+    {
+        const auto separator = field.find('=');
+        if (separator == std::string::npos)
+        {
+            throw std::invalid_argument("Search fields must be key=value: " + field);
+        }
+        const std::string key = field.substr(0, separator);
+        const double value = to_number(key, field.substr(separator + 1));
+
+        if (key == "success" && value > 0 && value <= 1)
+        {
+            cfg.objectives.min_success = value;
+        }
+        else if (key == "start" && value > 0)
+        {
+            cfg.start_rate = value;
+        }
+        else if (key == "warmup" && value >= 0)
+        {
+            cfg.warmup_periods = int(value);
+        }
+        else if (key == "periods" && value >= 1)
+        {
+            cfg.periods = int(value);
+        }
+        else if (key == "precision" && value > 0 && value < 1)
+        {
+            cfg.precision = value;
+        }
+        else if (key.size() > 1 && key[0] == 'p' &&
+                 std::isdigit(static_cast<unsigned char>(key[1])) && value > 0)
+        {
+            const double percentile = to_number(key, key.substr(1));
+            if (percentile <= 0 || percentile > 100)
+            {
+                throw std::invalid_argument("Wrong percentile in search: " + key);
+            }
+            cfg.objectives.percentile = percentile / 100;
+            cfg.objectives.max_latency_ms = value;
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown or out of range search field: " + field);
+        }
+    }
+    return cfg;
+}
+
+}  // namespace engine
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace engine
+{
+// Service level objectives a rate has to meet to be considered sustainable
+struct slo
+{
+    // Fraction of the finished requests answered successfully (timeouts count as failures)
+    double min_success = 0.99;
+    // Latency percentile (0 to 1) checked against max_latency_ms
+    double percentile = 0.99;
+    double max_latency_ms = std::numeric_limits<double>::infinity();
+};
+
+struct search_config
+{
+    slo objectives;
+    double start_rate = 10;  // req/s
+    // Stats periods a rate is kept before being evaluated, and evaluated periods
+    int warmup_periods = 1;
+    int periods = 1;
+    // The search is over when the bounds are closer than this fraction of the upper one
+    double precision = 0.05;
+};
+
+// What was measured in one stats period
+struct period_result
+{
+    double sent_rate;  // req/s
+    int64_t ok;
+    int64_t failed;     // error answers and timeouts
+    double latency_ms;  // at the percentile of the objectives
+};
+
+/**
+ * Looks for the highest rate meeting the objectives: the rate is doubled
+ * while it meets them, and then the interval between the last good rate and
+ * the first bad one is bisected. The caller feeds the figures of every stats
+ * period and applies the rate returned, so the traffic never stops.
+ */
+class rate_search
+{
+public:
+    struct step
+    {
+        double rate;
+        double sent_rate;
+        double success;
+        double latency_ms;
+        bool passed;
+    };
+
+    // A rate is not sustained if the sender could not even generate this fraction of it
+    static constexpr double min_sent_fraction = 0.9;
+    // Bounds closer than this (req/s) end the search, even if no rate met the objectives
+    static constexpr double min_interval = 1;
+
+    explicit rate_search(const search_config& cfg);
+
+    // Accounts one stats period and returns the rate to be used from now on
+    double on_period(const period_result& r);
+
+    const search_config& get_config() const { return cfg; }
+    double get_rate() const { return rate; }
+    // Highest rate that met the objectives, 0 if none did
+    double get_best() const { return lower; }
+    bool is_done() const { return done; }
+    const std::vector<step>& get_steps() const { return steps; }
+
+    void report(std::ostream& out) const;
+
+private:
+    void finish_step();
+
+    search_config cfg;
+    double rate;
+    double lower;
+    double upper;
+    bool done;
+
+    int period;
+    int64_t ok;
+    int64_t failed;
+    double sent_rate;
+    double latency_ms;
+    std::vector<step> steps;
+};
+
+/**
+ * Builds a search configuration from its command line definition, a comma
+ * separated list of key=value, all of them optional:
+ * success=<fraction>,p<percentile>=<ms>,start=<req/s>,warmup=<periods>,
+ * periods=<periods>,precision=<fraction>, e.g. success=0.999,p99=50,start=100
+ * Throws std::invalid_argument when the definition is not valid.
+ */
+search_config parse_search(const std::string& definition);
+
+}  // namespace engine
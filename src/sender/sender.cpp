@@ -1,27 +1,52 @@
 #include "sender.hpp"
 
-#include <boost/bind/bind.hpp>
+#include <algorithm>
+#include <cmath>
 
+#include "arrival.hpp"
 #include "client_impl.hpp"
 #include "params.hpp"
+#include "stats_if.hpp"
 #include "timer.hpp"
 
 using namespace std::chrono;
 
+namespace
+{
+constexpr double max_idle_ns = 100e6;
+// Wait until checking again whether the client has room for requests already due
+constexpr double held_back_ns = 1e6;
+}
+
 namespace engine
 {
 sender::sender(std::unique_ptr<engine::timer>&& t, std::unique_ptr<http2_client::client>&& c,
-               std::shared_ptr<config::params> params, std::promise<void>&& p)
-    : timer(std::move(t)), counter(0), client(std::move(c)), params(params), prom(std::move(p))
+               std::shared_ptr<config::params> params, std::promise<void>&& p,
+               std::shared_ptr<stats::stats_if> st)
+    : timer(std::move(t)),
+      arrival(make_arrival(params->arrival)),
+      expected_requests(params->phase),
+      profile_segment(0),
+      next_deadline(params->profile.time_of(expected_requests, profile_segment) * 1e9),
+      planned_wakeup(next_deadline),
+      batch(max_batch),
+      pending_rate(-1),
+      stopped(false),
+      client(std::move(c)),
+      params(params),
+      prom(std::move(p)),
+      stats(std::move(st))
 {
-    timer->async_wait(boost::bind(&sender::send, this));
+    timer->async_wait([this](const boost::system::error_code&) { send(); });
 }
 
+sender::~sender() = default;
+
 bool sender::still_in_window()
 {
     int seconds_since_start = duration_cast<seconds>(steady_clock::now() - params->init_time)
                                   .count();  // pass this one to microseconds
-    bool in_window = seconds_since_start < params->duration;
+    bool in_window = !stopped && seconds_since_start < params->duration;
     if (!in_window)
     {
         client->close_window();
@@ -30,29 +55,82 @@ bool sender::still_in_window()
     return in_window;
 }
 
-bool sender::continue_sending()
-{
-    return still_in_window() || !client->has_finished();
-}
-
 void sender::send()
 {
-    if (continue_sending())
-    {
-        ++counter;
-        steady_clock::time_point future_time =
-            (params->init_time + std::chrono::microseconds(params->wait_time * counter.load()));
-        auto elapsed = duration_cast<microseconds>(future_time - steady_clock::now()).count();
-        timer->expires_after(microseconds(elapsed));
-        timer->async_wait(boost::bind(&sender::send, this));
-    }
-    else
+    const bool in_window = still_in_window();
+    if (!in_window && client->has_finished())
     {
         prom.set_value();
         return;
     }
 
-    client->send();
+    const double elapsed =
+        duration_cast<duration<double, std::nano>>(steady_clock::now() - params->init_time)
+            .count();
+    if (const double rate = pending_rate.exchange(-1); rate >= 0)
+    {
+        params->profile = params->profile.switched(elapsed / 1e9, rate);
+        profile_segment = 0;
+        next_deadline = params->profile.time_of(expected_requests, profile_segment) * 1e9;
+    }
+
+    // When the client has no room, due requests keep their planned time and wait for it
+    const std::size_t room = std::min(max_batch, client->get_room());
+    std::size_t due{0};
+    while (due < room && next_deadline <= elapsed)
+    {
+        batch[due++] = next_deadline;
+        expected_requests += arrival->next_gap();
+        next_deadline = params->profile.time_of(expected_requests, profile_segment) * 1e9;
+    }
+
+    // If the profile dropped to 0 for good, ongoing scripts still need to be finished
+    if (!due && !in_window && std::isinf(next_deadline))
+    {
+        batch[due++] = elapsed;
+    }
+
+    // Wake up from time to time even if nothing is due, to check the window
+    double wait = std::max(std::min(next_deadline - elapsed, max_idle_ns), params->tick * 1e3);
+    // The lag of a sender falling behind also counts the time its requests have been due
+    const double lag = std::max(0.0, elapsed - planned_wakeup);
+    planned_wakeup = elapsed + wait;
+    if (due == max_batch)
+    {
+        wait = 0;
+        planned_wakeup = std::min(next_deadline, elapsed);
+    }
+    else if (next_deadline <= elapsed)
+    {
+        wait = std::max(wait, held_back_ns);
+        planned_wakeup = elapsed + wait;
+    }
+    timer->expires_after(nanoseconds(int64_t(std::ceil(wait))));
+    timer->async_wait([this](const boost::system::error_code&) { send(); });
+
+    // Requests are tagged with the time they were planned for, not the time they leave
+    const auto sends_start = steady_clock::now();
+    for (std::size_t i = 0; i < due; ++i)
+    {
+        client->send(params->init_time +
+                     duration_cast<steady_clock::duration>(duration<double, std::nano>(batch[i])));
+    }
+
+    if (stats)
+    {
+        const auto send_time = duration_cast<nanoseconds>(steady_clock::now() - sends_start);
+        stats->add_wakeup(int64_t(lag / 1e3), due, send_time.count());
+    }
+}
+
+void sender::set_rate(const double rate)
+{
+    pending_rate = rate;
+}
+
+void sender::stop()
+{
+    stopped = true;
 }
 
 }  // namespace engine
@@ -1,5 +1,7 @@
 #include <atomic>
 #include <future>
+#include <memory>
+#include <vector>
 
 #pragma once
 
@@ -11,9 +13,14 @@ namespace http2_client
 {
 class client;
 }
+namespace stats
+{
+class stats_if;
+}
 
 namespace engine
 {
+class arrival;
 class timer;
 
 class sender
@@ -21,20 +28,41 @@ class sender
 public:
     sender() = delete;
     sender(std::unique_ptr<engine::timer>&& t, std::unique_ptr<http2_client::client>&& c,
-           std::shared_ptr<config::params> params, std::promise<void>&& p);
+           std::shared_ptr<config::params> params, std::promise<void>&& p,
+           std::shared_ptr<stats::stats_if> stats = nullptr);
 
-    ~sender() = default;
+    ~sender();
+
+    // Requests sent in a single wake-up, so that a late sender does not starve the io_context
+    static constexpr std::size_t max_batch = 10000;
 
     void send();
 
+    // Thread safe. The rate (req/s) changes from the next wake-up on, keeping what was sent
+    void set_rate(const double rate);
+    // Thread safe. Closes the traffic window before the test duration is over
+    void stop();
+
 private:
     bool still_in_window();
-    bool continue_sending();
     std::unique_ptr<engine::timer> timer;
-    std::atomic<int64_t> counter;
+    std::unique_ptr<engine::arrival> arrival;
+    // Requests expected to be sent so far, as given by the arrival gaps
+    double expected_requests;
+    std::size_t profile_segment;
+    // Planned time of the next request, in ns since params->init_time
+    double next_deadline;
+    // Time the current wake-up was planned for, in ns since params->init_time
+    double planned_wakeup;
+    // Planned times of the requests due in the current wake-up
+    std::vector<double> batch;
+    // Rate to be applied in the next wake-up, negative if none
+    std::atomic<double> pending_rate;
+    std::atomic<bool> stopped;
 
     std::unique_ptr<http2_client::client> client;
     std::shared_ptr<config::params> params;
     std::promise<void> prom;
+    std::shared_ptr<stats::stats_if> stats;
 };
 }  // namespace engine
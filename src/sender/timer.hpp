@@ -9,12 +9,12 @@ class timer
 {
 public:
     using wait_handler = std::function<void(boost::system::error_code)>;
-    using duration_us = std::chrono::microseconds;
+    using duration_ns = std::chrono::nanoseconds;
 
     virtual ~timer() {}
 
     virtual void async_wait(wait_handler&& handler) = 0;
 
-    virtual std::size_t expires_after(const duration_us expiry_time) = 0;
+    virtual std::size_t expires_after(const duration_ns expiry_time) = 0;
 };
 }  // namespace engine
@@ -9,7 +9,7 @@ void timer_impl::async_wait(engine::timer::wait_handler&& handler)
     timer.async_wait(handler);
 }
 
-size_t timer_impl::expires_after(const engine::timer::duration_us expiry_time)
+size_t timer_impl::expires_after(const engine::timer::duration_ns expiry_time)
 {
     return timer.expires_after(expiry_time);
 }
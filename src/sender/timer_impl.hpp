@@ -13,7 +13,7 @@ public:
 
     void async_wait(wait_handler&& handler) override;
 
-    size_t expires_after(duration_us expiry_time) override;
+    size_t expires_after(duration_ns expiry_time) override;
 
 private:
     boost::asio::steady_timer timer;
@@ -0,0 +1,93 @@
+#include "histogram.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+constexpr int sub_bucket_bits = 5;
+constexpr int64_t sub_buckets = int64_t(1) << sub_bucket_bits;
+constexpr int64_t half_sub_buckets = sub_buckets / 2;
+// Values are clamped to 2^40 (~12 days in us)
+constexpr int max_bit = 40;
+constexpr int64_t max_value = (int64_t(1) << max_bit) - 1;
+
+int most_significant_bit(uint64_t value)
+{
+    return 63 - __builtin_clzll(value);
+}
+}  // namespace
+
+namespace stats
+{
+histogram::histogram() : buckets(index_of(max_value) + 1, 0), count(0), max(0) {}
+
+std::size_t histogram::index_of(int64_t value)
+{
+    if (value < sub_buckets)
+    {
+        return std::size_t(value);
+    }
+
+    const int shift = most_significant_bit(uint64_t(value)) - (sub_bucket_bits - 1);
+    return std::size_t(shift * half_sub_buckets + (value >> shift));
+}
+
+int64_t histogram::highest_of(std::size_t index)
+{
+    if (int64_t(index) < sub_buckets)
+    {
+        return int64_t(index);
+    }
+
+    const int64_t shift = int64_t(index) / half_sub_buckets - 1;
+    const int64_t lowest = (int64_t(index) - shift * half_sub_buckets) << shift;
+    return lowest + (int64_t(1) << shift) - 1;
+}
+
+void histogram::record(int64_t value)
+{
+    value = std::clamp<int64_t>(value, 0, max_value);
+    ++buckets[index_of(value)];
+    ++count;
+    max = std::max(max, value);
+}
+
+void histogram::merge(const histogram& other)
+{
+    for (std::size_t i = 0; i < buckets.size(); ++i)
+    {
+        buckets[i] += other.buckets[i];
+    }
+    count += other.count;
+    max = std::max(max, other.max);
+}
+
+void histogram::reset()
+{
+    std::fill(buckets.begin(), buckets.end(), 0);
+    count = 0;
+    max = 0;
+}
+
+int64_t histogram::percentile(double fraction) const
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    const auto rank = uint64_t(std::ceil(std::clamp(fraction, 0.0, 1.0) * double(count)));
+    uint64_t seen{0};
+    for (std::size_t i = 0; i < buckets.size(); ++i)
+    {
+        seen += buckets[i];
+        if (seen >= std::max<uint64_t>(rank, 1))
+        {
+            return std::min(highest_of(i), max);
+        }
+    }
+    return max;
+}
+
+}  // namespace stats
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace stats
+{
+/**
+ * Log-linear histogram of non negative integer values (e.g. us), in the spirit
+ * of HdrHistogram: every power of two is split in 16 buckets, so any recorded
+ * value is known with an error below 6.25%, whatever its magnitude. Recording
+ * is O(1) and never allocates, and histograms can be merged.
+ */
+class histogram
+{
+public:
+    histogram();
+
+    void record(int64_t value);
+    void merge(const histogram& other);
+    void reset();
+
+    uint64_t get_count() const { return count; }
+    int64_t get_max() const { return max; }
+
+    // Value below which the given fraction (0 to 1) of the recorded values lie
+    int64_t percentile(double fraction) const;
+
+private:
+    static std::size_t index_of(int64_t value);
+    static int64_t highest_of(std::size_t index);
+
+    std::vector<uint64_t> buckets;
+    uint64_t count;
+    int64_t max;
+};
+}  // namespace stats
@@ -1,5 +1,6 @@
 #include "stats.hpp"
 
+#include <algorithm>
 #include <boost/asio.hpp>
 #include <boost/bind/bind.hpp>
 #include <chrono>
@@ -13,6 +14,7 @@
 #include "opentelemetry/context/context.h"
 #include "opentelemetry/metrics/provider.h"
 #include "opentelemetry/nostd/shared_ptr.h"
+#include "params.hpp"
 
 using namespace std::chrono;
 
@@ -22,19 +24,87 @@ namespace stats
 std::string stats::create_headers_str()
 {
     std::stringstream h;
-    h << std::left << std::setw(10) << "Time (s)" << std::right << std::setw(10) << "Sent/s"
-      << std::right << std::setw(10) << "Recv/s" << std::right << std::setw(15) << "RT (ms)"
-      << std::right << std::setw(15) << "minRT (ms)" << std::right << std::setw(15) << "maxRT (ms)"
-      << std::right << std::setw(15) << "Sent" << std::right << std::setw(15) << "Success"
-      << std::right << std::setw(15) << "Errors" << std::right << std::setw(15) << "Timeouts"
+    h << std::left << std::setw(10) << "Time (s)" << std::right << std::setw(10) << "Target/s"
+      << std::right << std::setw(10) << "Sent/s" << std::right << std::setw(10) << "Recv/s"
+      << std::right << std::setw(15) << "RT (ms)" << std::right << std::setw(15) << "minRT (ms)"
+      << std::right << std::setw(15) << "maxRT (ms)" << std::right << std::setw(15) << "Sent"
+      << std::right << std::setw(15) << "Success" << std::right << std::setw(15) << "Errors"
+      << std::right << std::setw(15) << "Timeouts" << std::right << std::setw(15) << "Skipped"
       << std::endl;
 
     return h.str();
 }
 
+std::string stats::create_latency_headers_str()
+{
+    std::stringstream h;
+    h << std::left << std::setw(10) << "Time (s)";
+    for (const auto* kind : {"Svc", "Resp"})
+    {
+        for (const auto* p : {"p50", "p90", "p99", "p99.9", "max"})
+        {
+            h << std::right << std::setw(15) << std::string(kind) + " " + p + " (ms)";
+        }
+    }
+    h << std::endl;
+
+    return h.str();
+}
+
+std::string stats::create_sender_headers_str()
+{
+    std::stringstream h;
+    h << std::left << std::setw(10) << "Time (s)";
+    for (const auto* p : {"p50", "p99", "max"})
+    {
+        h << std::right << std::setw(15) << std::string("Lag ") + p + " (ms)";
+    }
+    for (const auto* p : {"p50", "p99", "max"})
+    {
+        h << std::right << std::setw(15) << std::string("Send ") + p + " (us)";
+    }
+    h << std::right << std::setw(15) << "Wake-ups" << std::right << std::setw(15)
+      << "Stream waits";
+    for (const auto* p : {"p99", "max"})
+    {
+        h << std::right << std::setw(15) << std::string("Wait ") + p + " (ms)";
+    }
+    h << std::right << std::setw(15) << "Handshakes" << std::right << std::setw(15)
+      << "Resumed";
+    for (const auto* p : {"p99", "max"})
+    {
+        h << std::right << std::setw(15) << std::string("HS ") + p + " (ms)";
+    }
+    h << std::endl;
+
+    return h.str();
+}
+
+std::string stats::create_connections_headers_str()
+{
+    std::stringstream h;
+    h << std::left << std::setw(10) << "Time (s)" << std::right << std::setw(12) << "Connection"
+      << std::right << std::setw(15) << "Sent/s" << std::right << std::setw(15) << "Answered/s"
+      << std::right << std::setw(15) << "Failed" << std::endl;
+
+    return h.str();
+}
+
+std::string stats::create_endpoints_headers_str()
+{
+    std::stringstream h;
+    h << std::left << std::setw(10) << "Time (s)" << std::right << std::setw(25) << "Endpoint"
+      << std::right << std::setw(15) << "Sent/s" << std::right << std::setw(15) << "Answered/s"
+      << std::right << std::setw(15) << "Failed" << std::right << std::setw(15) << "Svc p50 (ms)"
+      << std::right << std::setw(15) << "Svc p99 (ms)" << std::endl;
+
+    return h.str();
+}
+
 stats::stats(boost::asio::io_context& io_ctx, const int p, const std::string& output_file_name,
-             const std::vector<std::string>& msg_names)
+             const std::vector<std::string>& msg_names, std::shared_ptr<const config::params> prms)
     : timer(io_ctx),
+      params(std::move(prms)),
       print_period(p * 1000),
       cancel(false),
       counter(0),
@@ -42,9 +112,17 @@ stats::stats(boost::asio::io_context& io_ctx, const int p, const std::string& ou
       accum_filename(output_file_name + ".accum"),
       partial_filename(output_file_name + ".partial"),
       err_filename(output_file_name + ".err"),
+      latency_filename(output_file_name + ".latency"),
+      sender_filename(output_file_name + ".sender"),
+      connections_filename(output_file_name + ".connections"),
+      endpoints_filename(output_file_name + ".endpoints"),
       total_snap(),
       partial_snap(),
-      stats_headers(create_headers_str())
+      stats_headers(create_headers_str()),
+      latency_headers(create_latency_headers_str()),
+      sender_headers(create_sender_headers_str()),
+      connections_headers(create_connections_headers_str()),
+      endpoints_headers(create_endpoints_headers_str())
 {
     for (const auto& name : msg_names)
     {
@@ -66,6 +144,37 @@ stats::stats(boost::asio::io_context& io_ctx, const int p, const std::string& ou
     write_headers(partials_file);
     partials_file.close();
 
+    std::fstream latency_file;
+    latency_file.open(latency_filename, std::fstream::out);
+    auto start_time = system_clock::to_time_t(system_clock::now());
+    latency_file << "Traffic started at:  " << std::ctime(&start_time) << std::endl
+                 << "Svc: time since the request was sent. Resp: time since it should have been "
+                    "sent."
+                 << std::endl
+                 << latency_headers;
+    latency_file.close();
+
+    std::fstream sender_file;
+    sender_file.open(sender_filename, std::fstream::out);
+    sender_file << "Traffic started at:  " << std::ctime(&start_time) << std::endl
+                << "Lag: how late the sender woke up. Send: mean time spent in each send. "
+                   "Wait: time held waiting for a stream."
+                << std::endl
+                << sender_headers;
+    sender_file.close();
+
+    std::fstream connections_file;
+    connections_file.open(connections_filename, std::fstream::out);
+    connections_file << "Traffic started at:  " << std::ctime(&start_time) << std::endl
+                     << connections_headers;
+    connections_file.close();
+
+    std::fstream endpoints_file;
+    endpoints_file.open(endpoints_filename, std::fstream::out);
+    endpoints_file << "Traffic started at:  " << std::ctime(&start_time) << std::endl
+                   << endpoints_headers;
+    endpoints_file.close();
+
     std::fstream errors_file;
     errors_file.open(err_filename, std::fstream::out);
     auto print_time = system_clock::to_time_t(system_clock::now());
@@ -94,11 +203,43 @@ stats::stats(boost::asio::io_context& io_ctx, const int p, const std::string& ou
     responses_err = std::move(resp_nok);
     auto to = meter->CreateUInt64Counter("hermes_timeouts", "Timeouts in requests sent by hermes");
     timeouts = std::move(to);
+    auto skip = meter->CreateUInt64Counter(
+        "hermes_requests_skipped", "Requests not sent by hermes because of the in-flight limits");
+    skipped = std::move(skip);
+    auto conn_requests = meter->CreateUInt64Counter(
+        "hermes_connection_requests", "Requests sent, answered and failed on every connection");
+    connection_requests = std::move(conn_requests);
+    auto ep_requests = meter->CreateUInt64Counter(
+        "hermes_endpoint_requests", "Requests sent, answered and failed on every endpoint");
+    endpoint_requests = std::move(ep_requests);
 
     auto rtok = meter->CreateDoubleHistogram(
         "hermes_response_time_ok_ms",
         "Response Time of requests with response codes expected by hermes", "ms");
     histo_rtok_ms = std::move(rtok);
+    auto rt_intended = meter->CreateDoubleHistogram(
+        "hermes_response_time_intended_ms",
+        "Response Time of answered requests since the time they should have been sent", "ms");
+    histo_rt_intended_ms = std::move(rt_intended);
+    auto lag = meter->CreateDoubleHistogram(
+        "hermes_send_lag_ms", "How late the sender of hermes woke up compared to its plan", "ms");
+    histo_send_lag_ms = std::move(lag);
+    auto send_cost = meter->CreateDoubleHistogram(
+        "hermes_send_cost_us", "Mean time spent by hermes in each send of a sender wake-up",
+        "us");
+    histo_send_cost_us = std::move(send_cost);
+    auto stream_wait = meter->CreateDoubleHistogram(
+        "hermes_stream_wait_ms",
+        "Time requests were held by hermes because its connections were out of streams", "ms");
+    histo_stream_wait_ms = std::move(stream_wait);
+    auto handshake = meter->CreateDoubleHistogram(
+        "hermes_tls_handshake_ms", "Time of the TLS handshakes of the connections of hermes",
+        "ms");
+    histo_handshake_ms = std::move(handshake);
+    auto ep_service_time = meter->CreateDoubleHistogram(
+        "hermes_endpoint_service_time_ms",
+        "Time until an answer arrived since the request was sent, by endpoint", "ms");
+    histo_endpoint_service_time_ms = std::move(ep_service_time);
     /*auto rtnok = meter->CreateDoubleHistogram(
         "hermes_response_time_nok_ms",
         "Response Time of requests with response codes not expected by hermes", "ms");
@@ -160,13 +301,147 @@ void stats::add_measurement(snapshot& snap, const int64_t elapsed_time, const in
     update_rcs(snap, code, false);
 }
 
-void stats::add_measurement(const std::string& id, const int64_t elapsed_time, const int code)
+void stats::add_latency(snapshot& snap, const int64_t service_time, const int64_t response_time)
 {
-    write_lock wr_lock(rw_mutex);
-    add_measurement(total_snap, elapsed_time, code);
-    add_measurement(partial_snap, elapsed_time, code);
-    add_measurement(msg_snaps.at(id), elapsed_time, code);
+    snap.service_time.record(service_time);
+    snap.response_time.record(response_time);
+}
+
+void stats::add_wakeup(snapshot& snap, const int64_t lag, const std::size_t sends,
+                       const int64_t send_time)
+{
+    snap.send_lag.record(lag);
+    if (sends > 0)
+    {
+        snap.send_cost.record(send_time / int64_t(sends));
+    }
+}
+
+void stats::add_connection_event(snapshot& snap, const std::size_t connection,
+                                 const connection_event e)
+{
+    if (snap.connections.size() <= connection)
+    {
+        snap.connections.resize(connection + 1);
+    }
+
+    auto& figures = snap.connections[connection];
+    switch (e)
+    {
+        case connection_event::SENT:
+            ++figures.sent;
+            break;
+        case connection_event::ANSWERED:
+            ++figures.answered;
+            break;
+        case connection_event::FAILED:
+            ++figures.failed;
+            break;
+    }
+}
+
+void stats::add_endpoint_event(snapshot& snap, const std::size_t endpoint,
+                               const connection_event e, const int64_t service_time)
+{
+    if (snap.endpoints.size() <= endpoint)
+    {
+        snap.endpoints.resize(endpoint + 1);
+    }
+
+    auto& figures = snap.endpoints[endpoint];
+    switch (e)
+    {
+        case connection_event::SENT:
+            ++figures.sent;
+            break;
+        case connection_event::ANSWERED:
+            ++figures.answered;
+            figures.service_time.record(service_time);
+            break;
+        case connection_event::FAILED:
+            ++figures.failed;
+            break;
+    }
+}
+
+void stats::merge(snapshot& into, const snapshot& from)
+{
+    if (from.responded_ok > 0)
+    {
+        const auto n = double(into.responded_ok + from.responded_ok);
+        if (into.avg_rt > 0 && from.avg_rt > 0)
+        {
+            // avg_rt is a geometric mean
+            into.avg_rt *= std::pow(double(from.avg_rt) / double(into.avg_rt),
+                                    double(from.responded_ok) / n);
+        }
+        else
+        {
+            into.avg_rt = (into.avg_rt * double(into.responded_ok) +
+                           from.avg_rt * double(from.responded_ok)) /
+                          n;
+        }
+    }
+
+    if (from.min_rt > 0 && (into.min_rt == 0 || from.min_rt < into.min_rt))
+    {
+        into.min_rt = from.min_rt;
+    }
+    into.max_rt = std::max(into.max_rt, from.max_rt);
+
+    into.sent += from.sent;
+    into.responded_ok += from.responded_ok;
+    into.timed_out += from.timed_out;
+    into.skipped += from.skipped;
+    for (const auto& [code, count] : from.response_codes_ok)
+    {
+        into.response_codes_ok[code] += count;
+    }
+    for (const auto& [code, count] : from.response_codes_nok)
+    {
+        into.response_codes_nok[code] += count;
+    }
+    into.service_time.merge(from.service_time);
+    into.response_time.merge(from.response_time);
+    into.send_lag.merge(from.send_lag);
+    into.send_cost.merge(from.send_cost);
+    into.stream_wait.merge(from.stream_wait);
+    into.handshake.merge(from.handshake);
+    into.resumed_handshakes += from.resumed_handshakes;
+    if (into.connections.size() < from.connections.size())
+    {
+        into.connections.resize(from.connections.size());
+    }
+    for (std::size_t i = 0; i < from.connections.size(); ++i)
+    {
+        into.connections[i].sent += from.connections[i].sent;
+        into.connections[i].answered += from.connections[i].answered;
+        into.connections[i].failed += from.connections[i].failed;
+    }
+    if (into.endpoints.size() < from.endpoints.size())
+    {
+        into.endpoints.resize(from.endpoints.size());
+    }
+    for (std::size_t i = 0; i < from.endpoints.size(); ++i)
+    {
+        into.endpoints[i].sent += from.endpoints[i].sent;
+        into.endpoints[i].answered += from.endpoints[i].answered;
+        into.endpoints[i].failed += from.endpoints[i].failed;
+        into.endpoints[i].service_time.merge(from.endpoints[i].service_time);
+    }
+}
+
+void stats::export_sent(const std::string& id) const
+{
+    // Create a label set which annotates metric values
+    std::map<std::string, std::string> labels = {{"id", id}};
+    auto labelkv = opentelemetry::common::KeyValueIterableView<decltype(labels)>{labels};
+    requests_sent->Add(1, labelkv);
+}
 
+void stats::export_measurement(const std::string& id, const int64_t elapsed_time,
+                               const int code) const
+{
     std::map<std::string, std::string> labels1{{"id", id}, {"response_code", std::to_string(code)}};
     auto labelkv1 = opentelemetry::common::KeyValueIterableView<decltype(labels1)>{labels1};
 
@@ -175,29 +450,62 @@ void stats::add_measurement(const std::string& id, const int64_t elapsed_time, c
     histo_rtok_ms->Record(double(elapsed_time) / 1000.0, labelkv1, context);
 }
 
+void stats::export_timeout(const std::string& id) const
+{
+    std::map<std::string, std::string> labels = {{"id", id}};
+    auto labelkv = opentelemetry::common::KeyValueIterableView<decltype(labels)>{labels};
+    timeouts->Add(1, labelkv);
+}
+
+void stats::export_error(const std::string& id, const int e) const
+{
+    std::map<std::string, std::string> labels{{"id", id}, {"response_code", std::to_string(e)}};
+    auto labelkv = opentelemetry::common::KeyValueIterableView<decltype(labels)>{labels};
+    responses_err->Add(1, labelkv);
+}
+
+void stats::export_skipped() const
+{
+    skipped->Add(1);
+}
+
+void stats::export_latency(const std::string& id, const int64_t response_time) const
+{
+    std::map<std::string, std::string> labels = {{"id", id}};
+    auto labelkv = opentelemetry::common::KeyValueIterableView<decltype(labels)>{labels};
+    auto context = opentelemetry::context::Context{};
+    histo_rt_intended_ms->Record(double(response_time) / 1000.0, labelkv, context);
+}
+
+void stats::add_measurement(const std::string& id, const int64_t elapsed_time, const int code)
+{
+    write_lock wr_lock(rw_mutex);
+    add_measurement(total_snap, elapsed_time, code);
+    add_measurement(partial_snap, elapsed_time, code);
+    add_measurement(msg_snaps.at(id), elapsed_time, code);
+    export_measurement(id, elapsed_time, code);
+}
+
 void stats::increase_sent(const std::string& id)
 {
     write_lock wr_lock(rw_mutex);
     ++total_snap.sent;
     ++partial_snap.sent;
     ++msg_snaps.at(id).sent;
-
-    // Create a label set which annotates metric values
-    std::map<std::string, std::string> labels = {{"id", id}};
-    auto labelkv = opentelemetry::common::KeyValueIterableView<decltype(labels)>{labels};
-    requests_sent->Add(1, labelkv);
+    export_sent(id);
 }
 
-void stats::add_timeout(const std::string& id)
+void stats::add_timeout(const std::string& id, const int64_t response_time)
 {
     write_lock wr_lock(rw_mutex);
-    ++total_snap.timed_out;
-    ++partial_snap.timed_out;
-    ++msg_snaps.at(id).timed_out;
-
-    std::map<std::string, std::string> labels = {{"id", id}};
-    auto labelkv = opentelemetry::common::KeyValueIterableView<decltype(labels)>{labels};
-    timeouts->Add(1, labelkv);
+    auto& msg_snap = msg_snaps.at(id);
+    for (auto* snap : {&total_snap, &partial_snap, &msg_snap})
+    {
+        ++snap->timed_out;
+        snap->response_time.record(response_time);
+    }
+    export_timeout(id);
+    export_latency(id, response_time);
 }
 
 void stats::add_error(const std::string& id, const int e)
@@ -206,10 +514,7 @@ void stats::add_error(const std::string& id, const int e)
     update_rcs(total_snap, e, true);
     update_rcs(partial_snap, e, true);
     update_rcs(msg_snaps.at(id), e, true);
-
-    std::map<std::string, std::string> labels{{"id", id}, {"response_code", std::to_string(e)}};
-    auto labelkv = opentelemetry::common::KeyValueIterableView<decltype(labels)>{labels};
-    responses_err->Add(1, labelkv);
+    export_error(id, e);
 }
 
 void stats::add_client_error(const std::string& id, const int e)
@@ -223,6 +528,192 @@ void stats::add_client_error(const std::string& id, const int e)
     update_rcs(msg_snaps.at(id), e, true);
 }
 
+void stats::add_skipped()
+{
+    write_lock wr_lock(rw_mutex);
+    ++total_snap.skipped;
+    ++partial_snap.skipped;
+    export_skipped();
+}
+
+void stats::add_latency(const std::string& id, const int64_t service_time,
+                        const int64_t response_time)
+{
+    write_lock wr_lock(rw_mutex);
+    add_latency(total_snap, service_time, response_time);
+    add_latency(partial_snap, service_time, response_time);
+    add_latency(msg_snaps.at(id), service_time, response_time);
+    export_latency(id, response_time);
+}
+
+void stats::export_wakeup(const int64_t lag, const std::size_t sends,
+                          const int64_t send_time) const
+{
+    auto context = opentelemetry::context::Context{};
+    histo_send_lag_ms->Record(double(lag) / 1000.0, context);
+    if (sends > 0)
+    {
+        histo_send_cost_us->Record(double(send_time) / double(sends) / 1000.0, context);
+    }
+}
+
+void stats::add_wakeup(const int64_t lag, const std::size_t sends, const int64_t send_time)
+{
+    {
+        write_lock wr_lock(rw_mutex);
+        add_wakeup(total_snap, lag, sends, send_time);
+        add_wakeup(partial_snap, lag, sends, send_time);
+    }
+    export_wakeup(lag, sends, send_time);
+}
+
+void stats::export_connection_event(const std::size_t connection, const connection_event e) const
+{
+    const char* event = e == connection_event::SENT       ? "sent"
+                        : e == connection_event::ANSWERED ? "answered"
+                                                          : "failed";
+    std::map<std::string, std::string> labels{{"connection", std::to_string(connection)},
+                                              {"event", event}};
+    auto labelkv = opentelemetry::common::KeyValueIterableView<decltype(labels)>{labels};
+    connection_requests->Add(1, labelkv);
+}
+
+void stats::add_connection_event(const std::size_t connection, const connection_event e)
+{
+    {
+        write_lock wr_lock(rw_mutex);
+        add_connection_event(total_snap, connection, e);
+        add_connection_event(partial_snap, connection, e);
+    }
+    export_connection_event(connection, e);
+}
+
+std::string stats::endpoint_name(const std::size_t endpoint) const
+{
+    return endpoint < endpoint_names.size() ? endpoint_names[endpoint]
+                                            : std::to_string(endpoint);
+}
+
+void stats::set_endpoint_names(const std::vector<std::string>& names)
+{
+    write_lock wr_lock(rw_mutex);
+    endpoint_names = names;
+}
+
+void stats::export_endpoint_event(const std::size_t endpoint, const connection_event e,
+                                  const int64_t service_time) const
+{
+    const char* event = e == connection_event::SENT       ? "sent"
+                        : e == connection_event::ANSWERED ? "answered"
+                                                          : "failed";
+    std::map<std::string, std::string> labels{{"endpoint", endpoint_name(endpoint)},
+                                              {"event", event}};
+    auto labelkv = opentelemetry::common::KeyValueIterableView<decltype(labels)>{labels};
+    endpoint_requests->Add(1, labelkv);
+    if (e == connection_event::ANSWERED)
+    {
+        std::map<std::string, std::string> ep_labels{{"endpoint", endpoint_name(endpoint)}};
+        auto ep_labelkv = opentelemetry::common::KeyValueIterableView<decltype(ep_labels)>{
+            ep_labels};
+        auto context = opentelemetry::context::Context{};
+        histo_endpoint_service_time_ms->Record(double(service_time) / 1000.0, ep_labelkv,
+                                               context);
+    }
+}
+
+void stats::add_endpoint_event(const std::size_t endpoint, const connection_event e,
+                               const int64_t service_time)
+{
+    {
+        write_lock wr_lock(rw_mutex);
+        add_endpoint_event(total_snap, endpoint, e, service_time);
+        add_endpoint_event(partial_snap, endpoint, e, service_time);
+    }
+    export_endpoint_event(endpoint, e, service_time);
+}
+
+void stats::export_stream_wait(const int64_t wait) const
+{
+    auto context = opentelemetry::context::Context{};
+    histo_stream_wait_ms->Record(double(wait) / 1000.0, context);
+}
+
+void stats::add_stream_wait(const int64_t wait)
+{
+    {
+        write_lock wr_lock(rw_mutex);
+        total_snap.stream_wait.record(wait);
+        partial_snap.stream_wait.record(wait);
+    }
+    export_stream_wait(wait);
+}
+
+void stats::export_handshake(const int64_t time, const bool resumed) const
+{
+    std::map<std::string, std::string> labels{{"resumed", resumed ? "true" : "false"}};
+    auto labelkv = opentelemetry::common::KeyValueIterableView<decltype(labels)>{labels};
+    auto context = opentelemetry::context::Context{};
+    histo_handshake_ms->Record(double(time) / 1000.0, labelkv, context);
+}
+
+void stats::add_handshake(const int64_t time, const bool resumed)
+{
+    {
+        write_lock wr_lock(rw_mutex);
+        total_snap.handshake.record(time);
+        partial_snap.handshake.record(time);
+        total_snap.resumed_handshakes += resumed ? 1 : 0;
+        partial_snap.resumed_handshakes += resumed ? 1 : 0;
+    }
+    export_handshake(time, resumed);
+}
+
+std::shared_ptr<stats_if> stats::create_shard()
+{
+    std::vector<std::string> msg_names;
+    for (const auto& msg_snap : msg_snaps)
+    {
+        msg_names.push_back(msg_snap.first);
+    }
+
+    write_lock wr_lock(rw_mutex);
+    return shards.emplace_back(std::make_shared<stats_shard>(*this, msg_names));
+}
+
+void stats::set_period_callback(period_callback&& cb)
+{
+    write_lock wr_lock(rw_mutex);
+    on_period = std::move(cb);
+}
+
+void stats::set_params(std::shared_ptr<const config::params> prms)
+{
+    write_lock wr_lock(rw_mutex);
+    params = std::move(prms);
+}
+
+void stats::drain_shards()
+{
+    write_lock wr_lock(rw_mutex);
+    for (const auto& shard : shards)
+    {
+        shard->drain(total_snap, partial_snap, msg_snaps);
+    }
+}
+
+float stats::target_rate(const time_point<steady_clock>& from,
+                         const time_point<steady_clock>& to) const
+{
+    if (!params)
+    {
+        return 0;
+    }
+
+    const auto since_start = [this](const time_point<steady_clock>& t)
+    { return std::max(0.0, duration<double>(t - params->init_time).count()); };
+    return params->profile.mean_rate(since_start(from), since_start(to));
+}
+
 void stats::print_snapshot(const snapshot& snap, const time_point<steady_clock>& init_time,
                            std::ostream& out) const
 {
@@ -248,13 +739,125 @@ void stats::print_snapshot(const snapshot& snap, const time_point<steady_clock>&
     }
 
     out << std::fixed << std::left << std::setw(10) << std::setprecision(1) << total_time * 0.001
-        << std::right << std::setw(10) << float(snap.sent) / partial_time * 1000. << std::right
+        << std::right << std::setw(10) << target_rate(snap.init_time, now) << std::right
+        << std::setw(10) << float(snap.sent) / partial_time * 1000. << std::right
         << std::setw(10) << float(snap.responded_ok) / partial_time * 1000. << std::right
         << std::setw(15) << std::setprecision(3) << snap.avg_rt / 1000. << std::right
         << std::setw(15) << snap.min_rt / 1000. << std::right << std::setw(15)
         << snap.max_rt / 1000. << std::right << std::setw(15) << snap.sent << std::right
         << std::setw(15) << counter_ok << std::right << std::setw(15) << counter_nok << std::right
-        << std::setw(15) << snap.timed_out << std::endl;
+        << std::setw(15) << snap.timed_out << std::right << std::setw(15) << snap.skipped
+        << std::endl;
+}
+
+void stats::print_latency(const snapshot& snap, std::ostream& out) const
+{
+    // Since the start, whether the figures are of a period or of the whole execution
+    const float time =
+        duration_cast<milliseconds>(steady_clock::now() - total_snap.init_time).count();
+    out << std::fixed << std::left << std::setw(10) << std::setprecision(1) << time * 0.001
+        << std::setprecision(3);
+    for (const auto* h : {&snap.service_time, &snap.response_time})
+    {
+        for (const auto p : {0.5, 0.9, 0.99, 0.999})
+        {
+            out << std::right << std::setw(15) << double(h->percentile(p)) / 1000.;
+        }
+        out << std::right << std::setw(15) << double(h->get_max()) / 1000.;
+    }
+    out << std::endl;
+}
+
+void stats::print_sender(const snapshot& snap, std::ostream& out) const
+{
+    // Since the start, whether the figures are of a period or of the whole execution
+    const float time =
+        duration_cast<milliseconds>(steady_clock::now() - total_snap.init_time).count();
+    out << std::fixed << std::left << std::setw(10) << std::setprecision(1) << time * 0.001
+        << std::setprecision(3);
+    for (const auto p : {0.5, 0.99})
+    {
+        out << std::right << std::setw(15) << double(snap.send_lag.percentile(p)) / 1000.;
+    }
+    out << std::right << std::setw(15) << double(snap.send_lag.get_max()) / 1000.;
+    for (const auto p : {0.5, 0.99})
+    {
+        out << std::right << std::setw(15) << double(snap.send_cost.percentile(p)) / 1000.;
+    }
+    out << std::right << std::setw(15) << double(snap.send_cost.get_max()) / 1000. << std::right
+        << std::setw(15) << snap.send_lag.get_count() << std::right << std::setw(15)
+        << snap.stream_wait.get_count() << std::right << std::setw(15)
+        << double(snap.stream_wait.percentile(0.99)) / 1000. << std::right << std::setw(15)
+        << double(snap.stream_wait.get_max()) / 1000. << std::right << std::setw(15)
+        << snap.handshake.get_count() << std::right << std::setw(15) << snap.resumed_handshakes
+        << std::right << std::setw(15) << double(snap.handshake.percentile(0.99)) / 1000.
+        << std::right << std::setw(15) << double(snap.handshake.get_max()) / 1000. << std::endl;
+}
+
+void stats::print_connections(const snapshot& snap, std::ostream& out) const
+{
+    const float time = duration_cast<milliseconds>(steady_clock::now() - snap.init_time).count();
+    const float since_start =
+        duration_cast<milliseconds>(steady_clock::now() - total_snap.init_time).count();
+    if (time == 0)
+    {
+        return;
+    }
+
+    for (std::size_t i = 0; i < snap.connections.size(); ++i)
+    {
+        const auto& figures = snap.connections[i];
+        out << std::fixed << std::left << std::setw(10) << std::setprecision(1)
+            << since_start * 0.001 << std::right << std::setw(12) << i << std::right
+            << std::setw(15) << float(figures.sent) / time * 1000. << std::right << std::setw(15)
+            << float(figures.answered) / time * 1000. << std::right << std::setw(15)
+            << figures.failed << std::endl;
+    }
+}
+
+void stats::print_endpoints(const snapshot& snap, std::ostream& out) const
+{
+    const float time = duration_cast<milliseconds>(steady_clock::now() - snap.init_time).count();
+    const float since_start =
+        duration_cast<milliseconds>(steady_clock::now() - total_snap.init_time).count();
+    if (time == 0)
+    {
+        return;
+    }
+
+    for (std::size_t i = 0; i < snap.endpoints.size(); ++i)
+    {
+        const auto& figures = snap.endpoints[i];
+        out << std::fixed << std::left << std::setw(10) << std::setprecision(1)
+            << since_start * 0.001 << std::right << std::setw(25) << endpoint_name(i)
+            << std::right << std::setw(15) << float(figures.sent) / time * 1000. << std::right
+            << std::setw(15) << float(figures.answered) / time * 1000. << std::right
+            << std::setw(15) << figures.failed << std::setprecision(3) << std::right
+            << std::setw(15) << double(figures.service_time.percentile(0.5)) / 1000.
+            << std::right << std::setw(15)
+            << double(figures.service_time.percentile(0.99)) / 1000. << std::endl;
+    }
+}
+
+void stats::warn_if_behind(const snapshot& period) const
+{
+    const auto now = steady_clock::now();
+    const float time = duration<float>(now - period.init_time).count();
+    const float target = target_rate(period.init_time, now);
+    if (time <= 0 || target <= 0 || period.send_lag.get_count() == 0)
+    {
+        return;
+    }
+
+    const float sent = float(period.sent + period.skipped) / time;
+    const auto lag = period.send_lag.percentile(0.99);
+    if (sent < behind_fraction * target && lag >= behind_lag_us)
+    {
+        std::cerr << "Warning: hermes cannot keep up with the target rate (" << std::fixed
+                  << std::setprecision(1) << sent << " of " << target
+                  << " req/s, p99 lag of the sender " << std::setprecision(3)
+                  << double(lag) / 1000. << "ms)" << std::endl;
+    }
 }
 
 void stats::write_errors() const
@@ -295,13 +898,59 @@ void stats::do_print()
 
     write_errors();
 
+    std::fstream latency_file;
+    latency_file.open(latency_filename, std::fstream::app);
+    print_latency(partial_snap, latency_file);
+    latency_file.close();
+
+    std::fstream sender_file;
+    sender_file.open(sender_filename, std::fstream::app);
+    print_sender(partial_snap, sender_file);
+    sender_file.close();
+
+    std::fstream connections_file;
+    connections_file.open(connections_filename, std::fstream::app);
+    print_connections(partial_snap, connections_file);
+    connections_file.close();
+
+    std::fstream endpoints_file;
+    endpoints_file.open(endpoints_filename, std::fstream::app);
+    print_endpoints(partial_snap, endpoints_file);
+    endpoints_file.close();
+
     print_snapshot(total_snap, total_snap.init_time);
+    if (cancel)
+    {
+        std::cout << std::endl << latency_headers;
+        print_latency(total_snap);
+        std::cout << std::endl << sender_headers;
+        print_sender(total_snap);
+        if (total_snap.connections.size() > 1)
+        {
+            std::cout << std::endl << connections_headers;
+            print_connections(total_snap, std::cout);
+        }
+        if (total_snap.endpoints.size() > 1)
+        {
+            std::cout << std::endl << endpoints_headers;
+            print_endpoints(total_snap, std::cout);
+        }
+    }
+    else
+    {
+        warn_if_behind(partial_snap);
+    }
 
+    if (on_period)
+    {
+        on_period(partial_snap);
+    }
     partial_snap = snapshot();
 }
 
 void stats::print()
 {
+    drain_shards();
     if (!cancel)
     {
         ++counter;
@@ -332,4 +981,137 @@ void stats::end()
     cancel = true;
     timer.cancel();
 }
+
+stats_shard::stats_shard(stats& owner, const std::vector<std::string>& msg_names) : owner(owner)
+{
+    for (const auto& name : msg_names)
+    {
+        msg_snaps.emplace(name, snapshot());
+    }
+}
+
+void stats_shard::increase_sent(const std::string& id)
+{
+    {
+        std::scoped_lock guard(mtx);
+        ++partial_snap.sent;
+        ++msg_snaps.at(id).sent;
+    }
+    owner.export_sent(id);
+}
+
+void stats_shard::add_measurement(const std::string& id, const int64_t elapsed_time,
+                                  const int code)
+{
+    {
+        std::scoped_lock guard(mtx);
+        stats::add_measurement(partial_snap, elapsed_time, code);
+        stats::add_measurement(msg_snaps.at(id), elapsed_time, code);
+    }
+    owner.export_measurement(id, elapsed_time, code);
+}
+
+void stats_shard::add_timeout(const std::string& id, const int64_t response_time)
+{
+    {
+        std::scoped_lock guard(mtx);
+        auto& msg_snap = msg_snaps.at(id);
+        for (auto* snap : {&partial_snap, &msg_snap})
+        {
+            ++snap->timed_out;
+            snap->response_time.record(response_time);
+        }
+    }
+    owner.export_timeout(id);
+    owner.export_latency(id, response_time);
+}
+
+void stats_shard::add_error(const std::string& id, const int e)
+{
+    {
+        std::scoped_lock guard(mtx);
+        stats::update_rcs(partial_snap, e, true);
+        stats::update_rcs(msg_snaps.at(id), e, true);
+    }
+    owner.export_error(id, e);
+}
+
+void stats_shard::add_client_error(const std::string& id, const int e)
+{
+    std::scoped_lock guard(mtx);
+    ++partial_snap.sent;
+    ++msg_snaps.at(id).sent;
+    stats::update_rcs(partial_snap, e, true);
+    stats::update_rcs(msg_snaps.at(id), e, true);
+}
+
+void stats_shard::add_skipped()
+{
+    {
+        std::scoped_lock guard(mtx);
+        ++partial_snap.skipped;
+    }
+    owner.export_skipped();
+}
+
+void stats_shard::add_latency(const std::string& id, const int64_t service_time,
+                              const int64_t response_time)
+{
+    {
+        std::scoped_lock guard(mtx);
+        stats::add_latency(partial_snap, service_time, response_time);
+        stats::add_latency(msg_snaps.at(id), service_time, response_time);
+    }
+    owner.export_latency(id, response_time);
+}
+
+void stats_shard::add_wakeup(const int64_t lag, const std::size_t sends, const int64_t send_time)
+{
+    {
+        std::scoped_lock guard(mtx);
+        stats::add_wakeup(partial_snap, lag, sends, send_time);
+    }
+    owner.export_wakeup(lag, sends, send_time);
+}
+
+void stats_shard::add_connection_event(const std::size_t connection, const connection_event e)
+{
+    {
+        std::scoped_lock guard(mtx);
+        stats::add_connection_event(partial_snap, connection, e);
+    }
+    owner.export_connection_event(connection, e);
+}
+
+void stats_shard::add_endpoint_event(const std::size_t endpoint, const connection_event e,
+                                     const int64_t service_time)
+{
+    {
+        std::scoped_lock guard(mtx);
+        stats::add_endpoint_event(partial_snap, endpoint, e, service_time);
+    }
+    owner.export_endpoint_event(endpoint, e, service_time);
+}
+
+void stats_shard::add_stream_wait(const int64_t wait)
+{
+    {
+        std::scoped_lock guard(mtx);
+        partial_snap.stream_wait.record(wait);
+    }
+    owner.export_stream_wait(wait);
+}
+
+void stats_shard::drain(snapshot& total, snapshot& partial, std::map<std::string, snapshot>& msgs)
+{
+    std::scoped_lock guard(mtx);
+    stats::merge(total, partial_snap);
+    stats::merge(partial, partial_snap);
+    partial_snap = snapshot();
+    for (auto& [id, snap] : msg_snaps)
+    {
+        stats::merge(msgs.at(id), snap);
+        snap = snapshot();
+    }
+}
 }  // namespace stats
@@ -1,11 +1,15 @@
 #include <atomic>
 #include <boost/asio.hpp>
 #include <chrono>
+#include <functional>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <shared_mutex>
+#include <vector>
 
+#include "histogram.hpp"
 #include "opentelemetry/sdk/metrics/sync_instruments.h"
 #include "stats_if.hpp"
 
@@ -24,12 +28,28 @@ using mutex_type = std::shared_timed_mutex;
 using read_lock = std::shared_lock<mutex_type>;
 using write_lock = std::unique_lock<mutex_type>;
 
+struct connection_figures
+{
+    int64_t sent = 0;
+    int64_t answered = 0;
+    int64_t failed = 0;
+};
+
+struct endpoint_figures
+{
+    int64_t sent = 0;
+    int64_t answered = 0;
+    int64_t failed = 0;
+    histogram service_time{};
+};
+
 struct snapshot
 {
     friend inline bool operator==(const snapshot& lhs, const snapshot& rhs)
     {
         return lhs.sent == rhs.sent && lhs.responded_ok == rhs.responded_ok &&
-               lhs.timed_out == rhs.timed_out && lhs.rate == rhs.rate && lhs.avg_rt == rhs.avg_rt &&
+               lhs.timed_out == rhs.timed_out && lhs.skipped == rhs.skipped &&
+               lhs.rate == rhs.rate && lhs.avg_rt == rhs.avg_rt &&
                lhs.max_rt == rhs.max_rt && lhs.min_rt == rhs.min_rt &&
                lhs.response_codes_ok == rhs.response_codes_ok &&
                lhs.response_codes_nok == rhs.response_codes_nok;
@@ -47,13 +67,70 @@ struct snapshot
     std::map<int, int64_t> response_codes_ok{};
     std::map<int, int64_t> response_codes_nok{};
     time_point<steady_clock> init_time{steady_clock::now()};
+    histogram service_time{};
+    histogram response_time{};
+    int64_t skipped = 0;
+    // Lag (us) of the sender wake-ups, and mean time (ns) of a send in each of them
+    histogram send_lag{};
+    histogram send_cost{};
+    // Time (us) requests were held waiting for a stream
+    histogram stream_wait{};
+    // Time (us) of the TLS handshakes, and how many of them resumed a session
+    histogram handshake{};
+    int64_t resumed_handshakes = 0;
+    // By connection index
+    std::vector<connection_figures> connections{};
+    // By endpoint index
+    std::vector<endpoint_figures> endpoints{};
+};
+
+// Receives the figures of a print period, before they are reset
+using period_callback = std::function<void(const snapshot& period)>;
+
+class stats;
+
+/**
+ * Statistics gathered by one engine shard. A shard is only fed by the threads
+ * of its own engine, and its figures are moved into stats at print time, so
+ * shards do not contend with each other.
+ */
+class stats_shard : public stats_if
+{
+public:
+    stats_shard(stats& owner, const std::vector<std::string>& msg_names);
+
+    void increase_sent(const std::string& id) override;
+    void add_measurement(const std::string& id, const int64_t time, const int code) override;
+    void add_timeout(const std::string& id, const int64_t response_time) override;
+    void add_error(const std::string& id, const int e) override;
+    void add_client_error(const std::string& id, const int e) override;
+    void add_skipped() override;
+    void add_latency(const std::string& id, const int64_t service_time,
+                     const int64_t response_time) override;
+    void add_wakeup(const int64_t lag, const std::size_t sends, const int64_t send_time) override;
+    void add_connection_event(const std::size_t connection, const connection_event e) override;
+    void add_stream_wait(const int64_t wait) override;
+    void add_endpoint_event(const std::size_t endpoint, const connection_event e,
+                            const int64_t service_time) override;
+
+    // Adds the figures gathered since the last call to the given snapshots
+    void drain(snapshot& total, snapshot& partial, std::map<std::string, snapshot>& msgs);
+
+private:
+    stats& owner;
+    snapshot partial_snap;
+    std::map<std::string, snapshot> msg_snaps;
+    std::mutex mtx;
 };
 
 class stats : public stats_if
 {
+    friend class stats_shard;
+
 public:
     stats(boost::asio::io_context& io_ctx, const int print_period,
-          const std::string& output_file_name, const std::vector<std::string>& msg_names);
+          const std::string& output_file_name, const std::vector<std::string>& msg_names,
+          std::shared_ptr<const config::params> params = nullptr);
 
     stats(const stats& s) = delete;
 
@@ -62,26 +139,90 @@ public:
     void print();
     void end();
 
+    // New source of statistics for an engine shard, merged in every print
+    std::shared_ptr<stats_if> create_shard();
+
+    // Called from the stats threads at the end of every print period
+    void set_period_callback(period_callback&& cb);
+    // The target rate follows their load profile from then on. Set once their start time is
+    // final, as the stats threads read it
+    void set_params(std::shared_ptr<const config::params> prms);
+
     void increase_sent(const std::string& id) override;
     void add_measurement(const std::string& id, const int64_t time, const int code) override;
-    void add_timeout(const std::string& id) override;
+    void add_timeout(const std::string& id, const int64_t response_time) override;
     void add_error(const std::string& id, const int e) override;
     void add_client_error(const std::string& id, const int e) override;
+    void add_skipped() override;
+    void add_latency(const std::string& id, const int64_t service_time,
+                     const int64_t response_time) override;
+    void add_wakeup(const int64_t lag, const std::size_t sends, const int64_t send_time) override;
+    void add_connection_event(const std::size_t connection, const connection_event e) override;
+    void add_stream_wait(const int64_t wait) override;
+    void add_endpoint_event(const std::size_t endpoint, const connection_event e,
+                            const int64_t service_time) override;
+    // Names of the endpoints, in the order of their indexes, for the files and the labels.
+    // Only before the traffic starts
+    void set_endpoint_names(const std::vector<std::string>& names);
+    // A TLS handshake of any connection, full or resuming a previous session. They are
+    // rare, so they are not sharded
+    void add_handshake(const int64_t time, const bool resumed);
+
+    // Sent/s below this fraction of Target/s, with late wake-ups, means hermes is falling behind
+    static constexpr float behind_fraction = 0.95;
+    static constexpr int64_t behind_lag_us = 1000;
 
 protected:
     static std::string create_headers_str();
+    static std::string create_latency_headers_str();
+    static std::string create_sender_headers_str();
+    static std::string create_connections_headers_str();
+    static std::string create_endpoints_headers_str();
+    static void add_latency(snapshot& snap, const int64_t service_time,
+                            const int64_t response_time);
+    static void add_wakeup(snapshot& snap, const int64_t lag, const std::size_t sends,
+                           const int64_t send_time);
+    static void add_connection_event(snapshot& snap, const std::size_t connection,
+                                     const connection_event e);
+    static void add_endpoint_event(snapshot& snap, const std::size_t endpoint,
+                                   const connection_event e, const int64_t service_time);
     void write_headers(std::fstream& fs);
     void write_errors() const;
     void print_headers() const;
     void print_snapshot(const snapshot& snap, const time_point<steady_clock>& init_time,
                         std::ostream& out = std::cout) const;
+    void print_latency(const snapshot& snap, std::ostream& out = std::cout) const;
+    void print_sender(const snapshot& snap, std::ostream& out = std::cout) const;
+    void print_connections(const snapshot& snap, std::ostream& out) const;
+    void print_endpoints(const snapshot& snap, std::ostream& out) const;
+    std::string endpoint_name(const std::size_t endpoint) const;
+    void warn_if_behind(const snapshot& period) const;
     void do_print();
+    float target_rate(const time_point<steady_clock>& from,
+                      const time_point<steady_clock>& to) const;
 
-    void update_rcs(snapshot& snap, const int code, const bool is_error);
-    void update_rts(snapshot& snap, const int64_t elapsed_time);
-    void add_measurement(snapshot& snap, const int64_t elapsed_time, const int code);
+    static void update_rcs(snapshot& snap, const int code, const bool is_error);
+    static void update_rts(snapshot& snap, const int64_t elapsed_time);
+    static void add_measurement(snapshot& snap, const int64_t elapsed_time, const int code);
+    static void merge(snapshot& into, const snapshot& from);
+    void drain_shards();
+
+    void export_sent(const std::string& id) const;
+    void export_measurement(const std::string& id, const int64_t elapsed_time,
+                            const int code) const;
+    void export_timeout(const std::string& id) const;
+    void export_error(const std::string& id, const int e) const;
+    void export_latency(const std::string& id, const int64_t response_time) const;
+    void export_skipped() const;
+    void export_wakeup(const int64_t lag, const std::size_t sends, const int64_t send_time) const;
+    void export_connection_event(const std::size_t connection, const connection_event e) const;
+    void export_stream_wait(const int64_t wait) const;
+    void export_handshake(const int64_t time, const bool resumed) const;
+    void export_endpoint_event(const std::size_t endpoint, const connection_event e,
+                               const int64_t service_time) const;
 
     boost::asio::steady_timer timer;
+    std::shared_ptr<const config::params> params;
     int print_period;
     bool cancel;
     std::atomic<int64_t> counter;
@@ -90,14 +231,25 @@ protected:
     std::string accum_filename;
     std::string partial_filename;
     std::string err_filename;
+    std::string latency_filename;
+    std::string sender_filename;
+    std::string connections_filename;
+    std::string endpoints_filename;
 
     snapshot total_snap;
     snapshot partial_snap;
     std::map<std::string, snapshot> msg_snaps;
+    std::vector<std::shared_ptr<stats_shard>> shards;
+    period_callback on_period;
 
     mutable mutex_type rw_mutex;
 
     const std::string stats_headers;
+    const std::string latency_headers;
+    const std::string sender_headers;
+    const std::string connections_headers;
+    const std::string endpoints_headers;
+    std::vector<std::string> endpoint_names;
 
     opentelemetry::v1::nostd::unique_ptr<opentelemetry::v1::metrics::Counter<uint64_t>>
         requests_sent;
@@ -106,9 +258,26 @@ protected:
     opentelemetry::v1::nostd::unique_ptr<opentelemetry::v1::metrics::Counter<uint64_t>>
         responses_err;
     opentelemetry::v1::nostd::unique_ptr<opentelemetry::v1::metrics::Counter<uint64_t>> timeouts;
+    opentelemetry::v1::nostd::unique_ptr<opentelemetry::v1::metrics::Counter<uint64_t>> skipped;
+    opentelemetry::v1::nostd::unique_ptr<opentelemetry::v1::metrics::Counter<uint64_t>>
+        connection_requests;
+    opentelemetry::v1::nostd::unique_ptr<opentelemetry::v1::metrics::Counter<uint64_t>>
+        endpoint_requests;
     opentelemetry::v1::nostd::unique_ptr<opentelemetry::v1::metrics::Histogram<double>>
         histo_rtok_ms;
     opentelemetry::v1::nostd::unique_ptr<opentelemetry::v1::metrics::Histogram<double>>
         histo_rtnok_ms;
+    opentelemetry::v1::nostd::unique_ptr<opentelemetry::v1::metrics::Histogram<double>>
+        histo_rt_intended_ms;
+    opentelemetry::v1::nostd::unique_ptr<opentelemetry::v1::metrics::Histogram<double>>
+        histo_send_lag_ms;
+    opentelemetry::v1::nostd::unique_ptr<opentelemetry::v1::metrics::Histogram<double>>
+        histo_send_cost_us;
+    opentelemetry::v1::nostd::unique_ptr<opentelemetry::v1::metrics::Histogram<double>>
+        histo_stream_wait_ms;
+    opentelemetry::v1::nostd::unique_ptr<opentelemetry::v1::metrics::Histogram<double>>
+        histo_handshake_ms;
+    opentelemetry::v1::nostd::unique_ptr<opentelemetry::v1::metrics::Histogram<double>>
+        histo_endpoint_service_time_ms;
 };
 }  // namespace stats
@@ -1,10 +1,20 @@
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
 #pragma once
 
 namespace stats
 {
+// What happened to a request on one of the connections of a client
+enum class connection_event
+{
+    SENT,
+    ANSWERED,
+    FAILED  // not answered: it could not be sent, it timed out or the connection was lost
+};
+
 class stats_if
 {
 public:
@@ -12,8 +22,29 @@ public:
 
     virtual void increase_sent(const std::string& id) = 0;
     virtual void add_measurement(const std::string& id, const int64_t time, const int code) = 0;
-    virtual void add_timeout(const std::string& id) = 0;
+    // A request not answered in time. The time (us) since it should have been sent is
+    // recorded as its response time, so that the percentiles include the worst stalls
+    virtual void add_timeout(const std::string& id, const int64_t response_time) = 0;
     virtual void add_error(const std::string& id, const int e) = 0;
     virtual void add_client_error(const std::string& id, const int e) = 0;
+    // A send given up by hermes itself because of the in-flight limits. As no script was
+    // picked for it, it is not accounted to any message
+    virtual void add_skipped() = 0;
+    // Times (us) until an answer arrived, since the request was actually sent and since
+    // it should have been sent according to the schedule (corrected for coordinated omission)
+    virtual void add_latency(const std::string& id, const int64_t service_time,
+                             const int64_t response_time) = 0;
+    // A wake-up of the sender: how late (us) it was compared to its plan, and the time (ns)
+    // spent in the sends it made, so that a generator falling behind can be told apart
+    virtual void add_wakeup(const int64_t lag, const std::size_t sends,
+                            const int64_t send_time) = 0;
+    // Requests of every connection, by its index, so that an unbalanced pool shows up
+    virtual void add_connection_event(const std::size_t connection, const connection_event e) = 0;
+    // Time (us) a request was held because every connection of its client was out of streams
+    virtual void add_stream_wait(const int64_t wait) = 0;
+    // Requests of every endpoint of the script, by its index, and the time (us) until an
+    // answer arrived since they were sent, for the answered ones
+    virtual void add_endpoint_event(const std::size_t endpoint, const connection_event e,
+                                    const int64_t service_time) = 0;
 };
 }  // namespace stats
@@ -2,6 +2,7 @@
 #include <gtest/gtest.h>
 #include <nghttp2/asio_http2_server.h>
 
+#include <atomic>
 #include <boost/asio.hpp>
 #include <boost/system/error_code.hpp>
 #include <chrono>
@@ -16,6 +17,10 @@ namespace ba = boost::asio;
 namespace ng = nghttp2::asio_http2;
 
 using testing::_;
+using testing::Field;
+using testing::Ge;
+using testing::Lt;
+using testing::NiceMock;
 using testing::Return;
 
 class stats_mock : public stats::stats_if
@@ -23,9 +28,16 @@ class stats_mock : public stats::stats_if
 public:
     MOCK_METHOD1(increase_sent, void(const std::string&));
     MOCK_METHOD3(add_measurement, void(const std::string&, const int64_t, const int));
-    MOCK_METHOD1(add_timeout, void(const std::string&));
+    MOCK_METHOD2(add_timeout, void(const std::string&, const int64_t));
     MOCK_METHOD2(add_error, void(const std::string&, const int));
     MOCK_METHOD2(add_client_error, void(const std::string&, const int));
+    MOCK_METHOD3(add_latency, void(const std::string&, const int64_t, const int64_t));
+    MOCK_METHOD0(add_skipped, void());
+    MOCK_METHOD3(add_wakeup, void(const int64_t, const std::size_t, const int64_t));
+    MOCK_METHOD2(add_connection_event, void(const std::size_t, const stats::connection_event));
+    MOCK_METHOD1(add_stream_wait, void(const int64_t));
+    MOCK_METHOD3(add_endpoint_event,
+                 void(const std::size_t, const stats::connection_event, const int64_t));
 };
 
 class script_queue_mock : public traffic::script_queue_if
@@ -38,6 +50,7 @@ public:
     MOCK_CONST_METHOD0(has_pending_scripts, bool());
     MOCK_METHOD0(close_window, void());
     MOCK_METHOD0(is_window_closed, bool());
+    MOCK_CONST_METHOD0(get_room, int64_t());
 };
 
 namespace http2_client
@@ -232,6 +245,7 @@ TEST_P(client_test_p, SendMessage)
     auto stats = std::make_shared<stats_mock>();
     EXPECT_CALL(*stats, increase_sent("test1")).Times(1);
     EXPECT_CALL(*stats, add_measurement("test1", _, 200)).Times(1);
+    EXPECT_CALL(*stats, add_latency("test1", _, _)).Times(1);
 
     auto queue = std::make_unique<script_queue_mock>();
 
@@ -251,11 +265,322 @@ TEST_P(client_test_p, SendMessage)
     ASSERT_EQ(fut.wait_for(1s), std::future_status::ready);
 }
 
+TEST_P(client_test_p, AnswersAreOnlyKeptIfFieldsAreSavedFromThem)
+{
+    auto stats = std::make_shared<NiceMock<stats_mock>>();
+    auto queue = std::make_unique<script_queue_mock>();
+
+    auto json = build_script();
+    json.set<std::string>("/messages/test1/save_from_answer/id/path", "/id");
+    json.set<std::string>("/messages/test1/save_from_answer/id/value_type", "string");
+    auto saving = std::make_shared<traffic::script>(json);
+    auto checking = std::make_shared<traffic::script>(build_script());
+
+    std::promise<void> prom;
+    std::future<void> fut = prom.get_future();
+    EXPECT_CALL(*queue, get_next_script()).Times(2).WillOnce(Return(saving)).WillOnce(
+        Return(checking));
+    EXPECT_CALL(*queue, enqueue_script(_, Field(&traffic::answer_type::body, response_body)))
+        .Times(1);
+    EXPECT_CALL(*queue, enqueue_script(_, Field(&traffic::answer_type::body, "")))
+        .Times(1)
+        .WillOnce(SetFuture(&prom));
+
+    auto client =
+        client_impl(stats, client_io_ctx, std::move(queue), server_host, server_port, GetParam());
+    ASSERT_TRUE(client.is_connected());
+
+    client.send();
+    std::this_thread::sleep_for(200ms);
+    client.send();
+
+    ASSERT_EQ(fut.wait_for(1s), std::future_status::ready);
+}
+
+TEST_P(client_test_p, LateSendIsAccountedFromIntendedTime)
+{
+    auto stats = std::make_shared<stats_mock>();
+    EXPECT_CALL(*stats, increase_sent("test1")).Times(1);
+    EXPECT_CALL(*stats, add_measurement("test1", Lt(500000), 200)).Times(1);
+    EXPECT_CALL(*stats, add_latency("test1", Lt(500000), Ge(500000))).Times(1);
+
+    auto queue = std::make_unique<script_queue_mock>();
+
+    auto script = std::make_shared<traffic::script>(build_script());
+    std::promise<void> prom;
+    std::future<void> fut = prom.get_future();
+    EXPECT_CALL(*queue, get_next_script()).Times(1).WillOnce(Return(script));
+    EXPECT_CALL(*queue, enqueue_script(_, _)).Times(1).WillOnce(SetFuture(&prom));
+
+    auto client =
+        client_impl(stats, client_io_ctx, std::move(queue), server_host, server_port, GetParam());
+
+    ASSERT_TRUE(client.is_connected());
+
+    // The request should have left 500ms ago
+    client.send(std::chrono::steady_clock::now() - 500ms);
+
+    ASSERT_EQ(fut.wait_for(1s), std::future_status::ready);
+}
+
+TEST_P(client_test_p, CompletionHandlerCalledOnceAnswered)
+{
+    auto stats = std::make_shared<stats_mock>();
+    EXPECT_CALL(*stats, increase_sent("test1")).Times(1);
+    EXPECT_CALL(*stats, add_measurement("test1", _, 200)).Times(1);
+
+    auto queue = std::make_unique<script_queue_mock>();
+    auto script = std::make_shared<traffic::script>(build_script());
+    EXPECT_CALL(*queue, get_next_script()).Times(1).WillOnce(Return(script));
+    EXPECT_CALL(*queue, enqueue_script(_, _)).Times(1);
+
+    auto client =
+        client_impl(stats, client_io_ctx, std::move(queue), server_host, server_port, GetParam());
+    ASSERT_TRUE(client.is_connected());
+
+    std::promise<bool> prom;
+    std::future<bool> fut = prom.get_future();
+    client.set_completion_handler([&prom](bool sent) { prom.set_value(sent); });
+
+    client.send();
+
+    ASSERT_EQ(fut.wait_for(1s), std::future_status::ready);
+    ASSERT_TRUE(fut.get());
+}
+
+TEST_P(client_test_p, BurstsOfSendsAreAllSubmitted)
+{
+    constexpr int sends{300};
+    auto stats = std::make_shared<NiceMock<stats_mock>>();
+    EXPECT_CALL(*stats, increase_sent("test1")).Times(sends);
+    EXPECT_CALL(*stats, add_measurement("test1", _, 200)).Times(sends);
+
+    auto queue = std::make_unique<NiceMock<script_queue_mock>>();
+    auto script = std::make_shared<traffic::script>(build_script());
+    EXPECT_CALL(*queue, get_next_script()).Times(sends).WillRepeatedly(Return(script));
+
+    config::connection_pool pool;
+    pool.max_streams = 0;
+    auto client = client_impl(stats, client_io_ctx, std::move(queue), server_host, server_port,
+                              GetParam(), {}, pool);
+    ASSERT_TRUE(client.is_connected());
+
+    std::promise<void> prom;
+    std::future<void> fut = prom.get_future();
+    std::atomic<int> answered{0};
+    client.set_completion_handler(
+        [&prom, &answered](bool sent)
+        {
+            if (sent && ++answered == sends)
+            {
+                prom.set_value();
+            }
+        });
+
+    // Pushed faster than the connection thread drains them, so they are submitted in batches
+    for (int i = 0; i < sends; ++i)
+    {
+        client.send();
+    }
+
+    ASSERT_EQ(fut.wait_for(2s), std::future_status::ready);
+}
+
+TEST_P(client_test_p, SendsBeyondTheLimitAreSkipped)
+{
+    auto stats = std::make_shared<stats_mock>();
+    EXPECT_CALL(*stats, increase_sent("test1")).Times(1);
+    EXPECT_CALL(*stats, add_measurement("test1", _, 200)).Times(1);
+    EXPECT_CALL(*stats, add_skipped()).Times(1);
+
+    auto queue = std::make_unique<script_queue_mock>();
+    auto script = std::make_shared<traffic::script>(build_script());
+    std::promise<void> prom;
+    std::future<void> fut = prom.get_future();
+    EXPECT_CALL(*queue, get_room()).WillRepeatedly(Return(100));
+    EXPECT_CALL(*queue, get_next_script()).Times(1).WillOnce(Return(script));
+    EXPECT_CALL(*queue, enqueue_script(_, _)).Times(1).WillOnce(SetFuture(&prom));
+
+    config::in_flight_limits limits;
+    limits.max_requests = 1;
+    auto client = client_impl(stats, client_io_ctx, std::move(queue), server_host, server_port,
+                              GetParam(), limits);
+    ASSERT_TRUE(client.is_connected());
+
+    client.send();
+    client.send();
+
+    ASSERT_EQ(fut.wait_for(1s), std::future_status::ready);
+}
+
+TEST_P(client_test_p, QueuedSendsLeaveOnceThereIsRoom)
+{
+    auto stats = std::make_shared<stats_mock>();
+    EXPECT_CALL(*stats, increase_sent("test1")).Times(2);
+    EXPECT_CALL(*stats, add_measurement("test1", _, 200)).Times(2);
+    EXPECT_CALL(*stats, add_skipped()).Times(0);
+
+    auto queue = std::make_unique<script_queue_mock>();
+    auto script = std::make_shared<traffic::script>(build_script());
+    std::promise<void> prom;
+    std::future<void> fut = prom.get_future();
+    EXPECT_CALL(*queue, get_room()).WillRepeatedly(Return(100));
+    EXPECT_CALL(*queue, get_next_script()).Times(2).WillRepeatedly(Return(script));
+    EXPECT_CALL(*queue, enqueue_script(_, _))
+        .Times(2)
+        .WillOnce(Return())
+        .WillOnce(SetFuture(&prom));
+
+    config::in_flight_limits limits;
+    limits.max_requests = 1;
+    limits.policy = config::overload_policy::QUEUE;
+    auto client = client_impl(stats, client_io_ctx, std::move(queue), server_host, server_port,
+                              GetParam(), limits);
+    ASSERT_TRUE(client.is_connected());
+
+    client.send();
+    client.send();
+
+    ASSERT_EQ(fut.wait_for(1s), std::future_status::ready);
+}
+
+TEST_P(client_test_p, RequestsAreSpreadAmongThePool)
+{
+    auto stats = std::make_shared<NiceMock<stats_mock>>();
+    EXPECT_CALL(*stats, increase_sent("test1")).Times(4);
+    EXPECT_CALL(*stats, add_connection_event(2, stats::connection_event::SENT)).Times(2);
+    EXPECT_CALL(*stats, add_connection_event(3, stats::connection_event::SENT)).Times(2);
+
+    auto queue = std::make_unique<script_queue_mock>();
+    auto script = std::make_shared<traffic::script>(build_script());
+    std::promise<void> prom;
+    std::future<void> fut = prom.get_future();
+    EXPECT_CALL(*queue, get_next_script()).Times(4).WillRepeatedly(Return(script));
+    EXPECT_CALL(*queue, enqueue_script(_, _))
+        .Times(4)
+        .WillOnce(Return())
+        .WillOnce(Return())
+        .WillOnce(Return())
+        .WillOnce(SetFuture(&prom));
+
+    config::connection_pool pool;
+    pool.size = 2;
+    auto client = client_impl(stats, client_io_ctx, std::move(queue), server_host, server_port,
+                              GetParam(), {}, pool.shard(1));
+    ASSERT_TRUE(client.is_connected());
+
+    for (int i = 0; i < 4; ++i)
+    {
+        client.send();
+    }
+
+    ASSERT_EQ(fut.wait_for(1s), std::future_status::ready);
+}
+
+TEST_P(client_test_p, SendsWaitForAFreeStream)
+{
+    auto stats = std::make_shared<NiceMock<stats_mock>>();
+    EXPECT_CALL(*stats, increase_sent("test1")).Times(2);
+    EXPECT_CALL(*stats, add_stream_wait(_)).Times(1);
+    EXPECT_CALL(*stats, add_skipped()).Times(0);
+
+    auto queue = std::make_unique<script_queue_mock>();
+    auto script = std::make_shared<traffic::script>(build_script());
+    std::promise<void> prom;
+    std::future<void> fut = prom.get_future();
+    EXPECT_CALL(*queue, get_room()).WillRepeatedly(Return(100));
+    EXPECT_CALL(*queue, get_next_script()).Times(2).WillRepeatedly(Return(script));
+    EXPECT_CALL(*queue, enqueue_script(_, _))
+        .Times(2)
+        .WillOnce(Return())
+        .WillOnce(SetFuture(&prom));
+
+    config::connection_pool pool;
+    pool.max_streams = 1;
+    auto client = client_impl(stats, client_io_ctx, std::move(queue), server_host, server_port,
+                              GetParam(), {}, pool);
+    ASSERT_TRUE(client.is_connected());
+
+    client.send();
+    client.send();
+
+    ASSERT_EQ(fut.wait_for(1s), std::future_status::ready);
+}
+
+TEST_P(client_test_p, PoolGrowsWhenOutOfStreams)
+{
+    auto stats = std::make_shared<NiceMock<stats_mock>>();
+    EXPECT_CALL(*stats, add_connection_event(0, stats::connection_event::SENT)).Times(1);
+    EXPECT_CALL(*stats, add_connection_event(1, stats::connection_event::SENT)).Times(1);
+
+    auto queue = std::make_unique<script_queue_mock>();
+    auto json = build_script();
+    json.set<std::string>("/messages/test1/url", "v1/test_timeout");
+    auto script = std::make_shared<traffic::script>(json);
+    std::promise<void> prom;
+    std::future<void> fut = prom.get_future();
+    EXPECT_CALL(*queue, get_room()).WillRepeatedly(Return(100));
+    EXPECT_CALL(*queue, get_next_script()).Times(2).WillRepeatedly(Return(script));
+    EXPECT_CALL(*queue, enqueue_script(_, _))
+        .Times(2)
+        .WillOnce(Return())
+        .WillOnce(SetFuture(&prom));
+
+    config::connection_pool pool;
+    pool.max_streams = 1;
+    pool.max_size = 2;
+    auto client = client_impl(stats, client_io_ctx, std::move(queue), server_host, server_port,
+                              GetParam(), {}, pool);
+    ASSERT_TRUE(client.is_connected());
+
+    // The first one keeps its stream for 750ms
+    client.send();
+    client.send();
+
+    ASSERT_EQ(fut.wait_for(2s), std::future_status::ready);
+}
+
+TEST_P(client_test_p, ScriptsAreSpreadOverTheEndpoints)
+{
+    auto stats = std::make_shared<NiceMock<stats_mock>>();
+    EXPECT_CALL(*stats, add_endpoint_event(0, stats::connection_event::SENT, 0)).Times(1);
+    EXPECT_CALL(*stats, add_endpoint_event(1, stats::connection_event::SENT, 0)).Times(1);
+    EXPECT_CALL(*stats, add_endpoint_event(_, stats::connection_event::ANSWERED, Ge(0)))
+        .Times(2);
+    // The pool of the second endpoint comes after the one of the first
+    EXPECT_CALL(*stats, add_connection_event(0, stats::connection_event::SENT)).Times(1);
+    EXPECT_CALL(*stats, add_connection_event(1, stats::connection_event::SENT)).Times(1);
+
+    auto queue = std::make_unique<script_queue_mock>();
+    auto first = std::make_shared<traffic::script>(build_script());
+    auto second = std::make_shared<traffic::script>(build_script());
+    std::promise<void> prom;
+    std::future<void> fut = prom.get_future();
+    EXPECT_CALL(*queue, get_next_script()).WillOnce(Return(first)).WillOnce(Return(second));
+    EXPECT_CALL(*queue, enqueue_script(_, _))
+        .Times(2)
+        .WillOnce(Return())
+        .WillOnce(SetFuture(&prom));
+
+    const std::vector<traffic::endpoint> endpoints{{server_host, server_port, 1},
+                                                   {server_host, server_port, 1}};
+    auto client = client_impl(stats, client_io_ctx, std::move(queue), endpoints, {}, GetParam());
+    ASSERT_TRUE(client.is_connected());
+
+    client.send();
+    client.send();
+
+    ASSERT_EQ(fut.wait_for(1s), std::future_status::ready);
+    EXPECT_EQ(0u, first->get_endpoint());
+    EXPECT_EQ(1u, second->get_endpoint());
+}
+
 TEST_P(client_test_p, TimeoutInAnswer)
 {
     auto stats = std::make_shared<stats_mock>();
     EXPECT_CALL(*stats, increase_sent("test1")).Times(1);
-    EXPECT_CALL(*stats, add_timeout("test1")).Times(1);
+    // From when it was meant to be sent, at least as long as the timeout
+    EXPECT_CALL(*stats, add_timeout("test1", Ge(500000))).Times(1);
 
     auto queue = std::make_unique<script_queue_mock>();
 
@@ -280,6 +605,31 @@ TEST_P(client_test_p, TimeoutInAnswer)
     ASSERT_EQ(fut.wait_for(1s), std::future_status::ready);
 }
 
+TEST_P(client_test_p, DestroyedWithStreamsOpen)
+{
+    auto stats = std::make_shared<stats_mock>();
+    std::promise<void> prom;
+    std::future<void> fut = prom.get_future();
+    EXPECT_CALL(*stats, increase_sent("test1")).Times(1).WillOnce(SetFuture(&prom));
+    EXPECT_CALL(*stats, add_timeout(_, _)).Times(0);
+
+    auto queue = std::make_unique<script_queue_mock>();
+    auto json = build_script();
+    json.set<std::string>("/messages/test1/url", "v1/test_timeout");
+    auto script = std::make_shared<traffic::script>(json);
+    EXPECT_CALL(*queue, get_next_script()).Times(1).WillOnce(Return(script));
+
+    {
+        auto client = client_impl(stats, client_io_ctx, std::move(queue), server_host,
+                                  server_port, GetParam());
+        ASSERT_TRUE(client.is_connected());
+        client.send();
+        ASSERT_EQ(fut.wait_for(1s), std::future_status::ready);
+        // Gone while the server is still holding the answer, so its stream is closed as the
+        // client tears its io contexts down
+    }
+}
+
 TEST_P(client_test_p, WrongCodeInAnswer)
 {
     auto stats = std::make_shared<stats_mock>();
@@ -309,12 +659,12 @@ TEST_P(client_test_p, WrongCodeInAnswer)
     ASSERT_EQ(fut.wait_for(1s), std::future_status::ready);
 }
 
-TEST_P(client_test_p, ServerDisconnectionTriggersReconnectionInNextMessage)
+TEST_P(client_test_p, ServerDisconnectionTriggersReconnectionInBackground)
 {
     // This test tries to send a message 3 times.
     // 1) There's no connection, so error is added and script in queue cancelled.
-    //    A connection is then triggered but unsuccessful.
-    // 2) After server is respawned, the same happens, but this time the reconnection occurs.
+    //    The client keeps on reconnecting in the background, backing off.
+    // 2) After server is respawned, the same happens until the next attempt succeeds.
     // 3) Message is sent successfully
 
     auto stats = std::make_shared<stats_mock>();
@@ -364,4 +714,30 @@ TEST_P(client_test_p, ServerDisconnectionTriggersReconnectionInNextMessage)
     ASSERT_EQ(fut2.wait_for(1s), std::future_status::ready);
 }
 
+TEST_P(client_test_p, SendsDoNotWaitForReconnections)
+{
+    auto stats = std::make_shared<NiceMock<stats_mock>>();
+    EXPECT_CALL(*stats, add_client_error("test1", _)).Times(3);
+    EXPECT_CALL(*stats, increase_sent(_)).Times(0);
+
+    auto queue = std::make_unique<NiceMock<script_queue_mock>>();
+    auto script = std::make_shared<traffic::script>(build_script());
+    EXPECT_CALL(*queue, get_next_script()).Times(3).WillRepeatedly(Return(script));
+    EXPECT_CALL(*queue, cancel_script()).Times(3);
+
+    auto client =
+        client_impl(stats, client_io_ctx, std::move(queue), server_host, server_port, GetParam());
+    ASSERT_TRUE(client.is_connected());
+
+    stop_server();
+    std::this_thread::sleep_for(200ms);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 3; ++i)
+    {
+        client.send();
+    }
+    ASSERT_LT(std::chrono::steady_clock::now() - start, 100ms);
+}
+
 }  // namespace http2_client
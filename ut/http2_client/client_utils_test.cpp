@@ -12,6 +12,12 @@ TEST(client_utils_test, BuildUri)
     ASSERT_EQ("http://" + host + ":" + port + "/" + path, build_uri(host, port, path));
 }
 
+TEST(client_utils_test, BuildUriForSecureSessions)
+{
+    ASSERT_EQ("https://host:8443/v1/test", build_uri("host", "8443", "v1/test", true));
+    ASSERT_EQ("https://host:8443/", build_uri_prefix("host", "8443", true));
+}
+
 void check_pre_built_headers(const size_t s, const header_map& built)
 {
     auto element = built.find("content-type");
@@ -53,4 +59,19 @@ TEST(client_utils_test, BuildHeadersAddingHeaders)
     ASSERT_FALSE(element->second.sensitive);
 }
 
+TEST(client_utils_test, ReconnectBackoffDoublesUpToACap)
+{
+    ASSERT_EQ(reconnect_backoff(1, 0), std::chrono::milliseconds(50));
+    ASSERT_EQ(reconnect_backoff(2, 0), std::chrono::milliseconds(100));
+    ASSERT_EQ(reconnect_backoff(3, 0), std::chrono::milliseconds(200));
+    ASSERT_EQ(reconnect_backoff(100, 0), std::chrono::milliseconds(2500));
+}
+
+TEST(client_utils_test, ReconnectBackoffIsSpreadByTheJitter)
+{
+    ASSERT_EQ(reconnect_backoff(1, 0.5), std::chrono::milliseconds(75));
+    ASSERT_EQ(reconnect_backoff(100, 0.5), std::chrono::milliseconds(3750));
+    ASSERT_EQ(reconnect_backoff(100, 1), std::chrono::milliseconds(5000));
+}
+
 }  // namespace http2_client
\ No newline at end of file
@@ -0,0 +1,126 @@
+#include "connection_pool.hpp"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "connection_selector.hpp"
+
+namespace http2_client
+{
+TEST(connection_pool_test, ParsePool)
+{
+    const auto pool = config::parse_connection_pool("connections=4,select=least-outstanding");
+    ASSERT_EQ(4u, pool.size);
+    ASSERT_EQ(config::connection_selection::LEAST_OUTSTANDING, pool.selection);
+    ASSERT_EQ(config::connection_selection::TWO_CHOICES,
+              config::parse_connection_pool("select=two-choices").selection);
+    ASSERT_EQ(1u, config::parse_connection_pool("").size);
+    ASSERT_EQ(8u, pool.shard(2).first_index);
+    // No limit unless it is given
+    ASSERT_EQ(0u, pool.max_streams);
+
+    const auto growing = config::parse_connection_pool("connections=2,streams=50,grow=6,queue=10");
+    ASSERT_EQ(50u, growing.max_streams);
+    ASSERT_EQ(6u, growing.capacity());
+    ASSERT_EQ(10u, growing.queue_size);
+    // Room is kept for the connections the pool may grow to
+    ASSERT_EQ(6u, growing.shard(1).first_index);
+    // And for the pool of every endpoint
+    ASSERT_EQ(18u, growing.shard(1, 3).first_index);
+    ASSERT_EQ(0u, config::parse_connection_pool("streams=0").max_streams);
+
+    ASSERT_THROW(config::parse_connection_pool("connections=0"), std::invalid_argument);
+    ASSERT_THROW(config::parse_connection_pool("connections=-2"), std::invalid_argument);
+    ASSERT_THROW(config::parse_connection_pool("select=random"), std::invalid_argument);
+    ASSERT_THROW(config::parse_connection_pool("connections=4,grow=2"), std::invalid_argument);
+    ASSERT_THROW(config::parse_connection_pool("connections=2,grow=4"), std::invalid_argument);
+    ASSERT_THROW(config::parse_connection_pool("weights=1"), std::invalid_argument);
+}
+
+TEST(connection_pool_test, RoundRobin)
+{
+    connection_selector selector(config::connection_selection::ROUND_ROBIN);
+    const auto none = [](std::size_t) { return int64_t(0); };
+    for (std::size_t i = 0; i < 7; ++i)
+    {
+        ASSERT_EQ(i % 3, selector.select(3, none));
+    }
+}
+
+TEST(connection_pool_test, FullConnectionsAreSkipped)
+{
+    connection_selector selector(config::connection_selection::ROUND_ROBIN);
+    std::vector<int64_t> streams{100, 100, 40};
+    const auto count = [&streams](std::size_t i) { return streams[i]; };
+    for (int i = 0; i < 3; ++i)
+    {
+        ASSERT_EQ(2u, selector.select(3, count, 100));
+    }
+
+    // Unless all of them are
+    streams[2] = 100;
+    ASSERT_EQ(0u, selector.select(3, count, 100));
+}
+
+TEST(connection_pool_test, PoolsGrow)
+{
+    connection_selector selector(config::connection_selection::LEAST_OUTSTANDING);
+    std::vector<int64_t> streams{10, 10, 0};
+    const auto count = [&streams](std::size_t i) { return streams[i]; };
+    ASSERT_NE(2u, selector.select(2, count));
+    ASSERT_EQ(2u, selector.select(3, count));
+}
+
+TEST(connection_pool_test, LeastOutstanding)
+{
+    connection_selector selector(config::connection_selection::LEAST_OUTSTANDING);
+    std::vector<int64_t> outstanding{5, 2, 7, 3};
+    const auto count = [&outstanding](std::size_t i) { return outstanding[i]; };
+    ASSERT_EQ(1u, selector.select(outstanding.size(), count));
+    ASSERT_EQ(1u, selector.select(outstanding.size(), count));
+
+    // Idle connections are taken in turns
+    outstanding = {0, 0, 0, 0};
+    std::vector<int> chosen(4, 0);
+    for (int i = 0; i < 8; ++i)
+    {
+        ++chosen[selector.select(outstanding.size(), count)];
+    }
+    ASSERT_EQ(std::vector<int>(4, 2), chosen);
+}
+
+TEST(connection_pool_test, TwoChoicesTakeTheLessLoaded)
+{
+    connection_selector selector(config::connection_selection::TWO_CHOICES);
+    std::vector<int64_t> outstanding{9, 1};
+    const auto count = [&outstanding](std::size_t i) { return outstanding[i]; };
+    // With two connections, both are always the choices
+    for (int i = 0; i < 10; ++i)
+    {
+        ASSERT_EQ(1u, selector.select(outstanding.size(), count));
+    }
+}
+
+TEST(connection_pool_test, TwoChoicesSpreadTheLoad)
+{
+    connection_selector selector(config::connection_selection::TWO_CHOICES);
+    std::vector<int64_t> outstanding(8, 0);
+    const auto count = [&outstanding](std::size_t i) { return outstanding[i]; };
+    for (int i = 0; i < 8000; ++i)
+    {
+        ++outstanding[selector.select(outstanding.size(), count)];
+    }
+
+    for (const auto n : outstanding)
+    {
+        ASSERT_NEAR(1000, n, 10);
+    }
+}
+
+TEST(connection_pool_test, SingleConnection)
+{
+    connection_selector selector(config::connection_selection::TWO_CHOICES);
+    ASSERT_EQ(0u, selector.select(1, [](std::size_t) { return int64_t(3); }));
+}
+}  // namespace http2_client
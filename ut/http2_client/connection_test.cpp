@@ -4,6 +4,12 @@
 #include <nghttp2/asio_http2_server.h>
 
 #include <boost/system/error_code.hpp>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "io_context_pool.hpp"
+#include "tls_context.hpp"
 
 using namespace std::chrono_literals;
 
@@ -15,49 +21,65 @@ public:
     connection_test()
         : server_host("localhost"), server_port("8080"), server_started(false), is_secure(false){};
 
-    void start_server()
+    std::unique_ptr<nghttp2::asio_http2::server::http2> listen(const std::string& port)
     {
         boost::system::error_code server_error_code;
-        server = std::make_unique<nghttp2::asio_http2::server::http2>();
+        auto srv = std::make_unique<nghttp2::asio_http2::server::http2>();
 
         if (is_secure)
         {
-            boost::system::error_code ec;
-            tlsCtx = std::make_unique<boost::asio::ssl::context>(boost::asio::ssl::context::sslv23);
-            tlsCtx->use_private_key_file("/usr/local/share/ca-certificates/localhost.key",
-                                         boost::asio::ssl::context::pem);
-            tlsCtx->use_certificate_chain_file("/usr/local/share/ca-certificates/localhost.crt");
-            nghttp2::asio_http2::server::configure_tls_context_easy(ec, *tlsCtx);
-
-            if (server->listen_and_serve(server_error_code, *tlsCtx, server_host, server_port,
-                                         true))
+            // Shared by every server started
+            if (!tlsCtx)
+            {
+                boost::system::error_code ec;
+                tlsCtx = std::make_unique<boost::asio::ssl::context>(
+                    boost::asio::ssl::context::sslv23);
+                tlsCtx->use_private_key_file("/usr/local/share/ca-certificates/localhost.key",
+                                             boost::asio::ssl::context::pem);
+                tlsCtx->use_certificate_chain_file(
+                    "/usr/local/share/ca-certificates/localhost.crt");
+                nghttp2::asio_http2::server::configure_tls_context_easy(ec, *tlsCtx);
+            }
+
+            if (srv->listen_and_serve(server_error_code, *tlsCtx, server_host, port, true))
             {
                 fprintf(stderr, "Error starting server in %s:%s", server_host.c_str(),
-                        server_port.c_str());
+                        port.c_str());
             }
         }
         else
         {
-            if (server->listen_and_serve(server_error_code, server_host, server_port, true))
+            if (srv->listen_and_serve(server_error_code, server_host, port, true))
             {
                 fprintf(stderr, "Error starting server in %s:%s", server_host.c_str(),
-                        server_port.c_str());
+                        port.c_str());
             }
         }
 
-        server_started = true;
+        return srv;
     }
 
-    void stop_server()
+    static void stop(std::unique_ptr<nghttp2::asio_http2::server::http2>& srv)
     {
-        for (auto& service : server->io_services())
+        for (auto& service : srv->io_services())
         {
             service->stop();
         }
 
-        server->stop();
-        server->join();
-        server.reset();
+        srv->stop();
+        srv->join();
+        srv.reset();
+    }
+
+    void start_server()
+    {
+        server = listen(server_port);
+        server_started = true;
+    }
+
+    void stop_server()
+    {
+        stop(server);
         server_started = false;
     }
 
@@ -78,6 +100,7 @@ protected:
     const std::string server_port;
     bool server_started;
     bool is_secure;
+    io_context_pool contexts{1};
 };
 
 class connection_test_p : public connection_test, public testing::WithParamInterface<bool>
@@ -90,7 +113,7 @@ INSTANTIATE_TEST_CASE_P(is_secure, connection_test_p, testing::Values(false, tru
 
 TEST_P(connection_test_p, correct_initialization)
 {
-    connection c(server_host, server_port, GetParam());
+    connection c(contexts.next().io, server_host, server_port, GetParam());
     ASSERT_TRUE(c.wait_to_be_connected());
     ASSERT_EQ(connection::status::OPEN, c.get_status());
 }
@@ -100,7 +123,7 @@ TEST_P(connection_test_p, wrong_port)
     testing::internal::CaptureStderr();
 
     const std::string wrong_port = "1234";
-    connection c(server_host, wrong_port, GetParam());
+    connection c(contexts.next().io, server_host, wrong_port, GetParam());
 
     ASSERT_FALSE(c.wait_to_be_connected());
     ASSERT_EQ(connection::status::CLOSED, c.get_status());
@@ -112,7 +135,7 @@ TEST_P(connection_test_p, wrong_port)
 
 TEST_P(connection_test_p, connection_is_lost_because_of_the_server)
 {
-    connection c(server_host, server_port, GetParam());
+    connection c(contexts.next().io, server_host, server_port, GetParam());
 
     ASSERT_TRUE(c.wait_to_be_connected());
     ASSERT_EQ(connection::status::OPEN, c.get_status());
@@ -122,7 +145,7 @@ TEST_P(connection_test_p, connection_is_lost_because_of_the_server)
 
 TEST_P(connection_test_p, close_connection)
 {
-    connection c(server_host, server_port, GetParam());
+    connection c(contexts.next().io, server_host, server_port, GetParam());
 
     ASSERT_TRUE(c.wait_to_be_connected());
     ASSERT_EQ(connection::status::OPEN, c.get_status());
@@ -137,4 +160,117 @@ TEST_P(connection_test_p, close_connection)
     ASSERT_FALSE(c.wait_to_be_connected());
     ASSERT_EQ(connection::status::CLOSED, c.get_status());
 }
+
+class connection_test_secure : public connection_test
+{
+public:
+    connection_test_secure() : connection_test() { is_secure = true; };
+
+    bool wait_for_session(const std::string& port)
+    {
+        // TLS 1.3 tickets come after the handshake
+        for (auto i = 0; i < 100 && !tls_context::shared().has_session(server_host, port); ++i)
+        {
+            std::this_thread::sleep_for(10ms);
+        }
+        return tls_context::shared().has_session(server_host, port);
+    }
+};
+
+TEST_F(connection_test_secure, reconnections_resume_the_last_session)
+{
+    std::mutex mtx;
+    std::vector<bool> resumed;
+    tls_context::configure({});
+    tls_context::shared().set_handshake_callback(
+        [&mtx, &resumed](const int64_t time, const bool r)
+        {
+            ASSERT_GE(time, 0);
+            std::scoped_lock guard(mtx);
+            resumed.push_back(r);
+        });
+
+    {
+        connection first(contexts.next().io, server_host, server_port, true);
+        ASSERT_TRUE(first.wait_to_be_connected());
+        ASSERT_TRUE(wait_for_session(server_port));
+    }
+
+    connection second(contexts.next().io, server_host, server_port, true);
+    ASSERT_TRUE(second.wait_to_be_connected());
+    tls_context::shared().set_handshake_callback({});
+
+    std::scoped_lock guard(mtx);
+    ASSERT_EQ(std::vector<bool>({false, true}), resumed);
+}
+
+TEST_F(connection_test_secure, sessions_are_only_offered_to_the_server_that_handed_them_out)
+{
+    const std::string other_port{"8081"};
+    auto other = listen(other_port);
+
+    std::mutex mtx;
+    std::vector<bool> resumed;
+    tls_context::configure({});
+    tls_context::shared().set_handshake_callback(
+        [&mtx, &resumed](const int64_t, const bool r)
+        {
+            std::scoped_lock guard(mtx);
+            resumed.push_back(r);
+        });
+
+    {
+        connection first(contexts.next().io, server_host, server_port, true);
+        ASSERT_TRUE(first.wait_to_be_connected());
+        ASSERT_TRUE(wait_for_session(server_port));
+        ASSERT_FALSE(tls_context::shared().has_session(server_host, other_port));
+    }
+    {
+        connection second(contexts.next().io, server_host, other_port, true);
+        ASSERT_TRUE(second.wait_to_be_connected());
+        ASSERT_TRUE(wait_for_session(other_port));
+    }
+    connection third(contexts.next().io, server_host, server_port, true);
+    ASSERT_TRUE(third.wait_to_be_connected());
+    tls_context::shared().set_handshake_callback({});
+    stop(other);
+
+    // Each server only resumes its own sessions
+    std::scoped_lock guard(mtx);
+    ASSERT_EQ(std::vector<bool>({false, false, true}), resumed);
+}
+
+TEST(tls_context_test, ParseSettings)
+{
+    const auto settings =
+        config::parse_tls("ca=/tmp/ca.pem,ciphers=HIGH,alpn=h2:http/1.1,verify=on,resume=off");
+    ASSERT_EQ("/tmp/ca.pem", settings.ca_file);
+    ASSERT_EQ("HIGH", settings.ciphers);
+    ASSERT_EQ(std::vector<std::string>({"h2", "http/1.1"}), settings.alpn);
+    ASSERT_TRUE(settings.verify);
+    ASSERT_FALSE(settings.resume);
+
+    const auto defaults = config::parse_tls("");
+    ASSERT_EQ(std::vector<std::string>({"h2"}), defaults.alpn);
+    ASSERT_FALSE(defaults.verify);
+    ASSERT_TRUE(defaults.resume);
+
+    ASSERT_THROW(config::parse_tls("alpn=http/1.1"), std::invalid_argument);
+    ASSERT_THROW(config::parse_tls("verify=yes"), std::invalid_argument);
+    ASSERT_THROW(config::parse_tls("ca="), std::invalid_argument);
+    ASSERT_THROW(config::parse_tls("tickets=on"), std::invalid_argument);
+}
+
+TEST(tls_context_test, WrongSettingsAreRejected)
+{
+    config::tls settings;
+    settings.ca_file = "/non/existent/ca.pem";
+    ASSERT_THROW(tls_context{settings}, std::invalid_argument);
+
+    settings = {};
+    settings.ciphers = "NOT-A-CIPHER";
+    ASSERT_THROW(tls_context{settings}, std::invalid_argument);
+
+    ASSERT_FALSE(tls_context{}.has_session("localhost", "8080"));
+}
 }  // namespace http2_client
@@ -0,0 +1,122 @@
+#include "endpoint_selector.hpp"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace http2_client
+{
+namespace
+{
+std::vector<traffic::endpoint> replicas(const std::vector<unsigned>& weights)
+{
+    std::vector<traffic::endpoint> eps;
+    for (std::size_t i = 0; i < weights.size(); ++i)
+    {
+        eps.push_back({"replica" + std::to_string(i), "8080", weights[i]});
+    }
+    return eps;
+}
+}  // namespace
+
+TEST(endpoint_selector_test, SingleEndpoint)
+{
+    endpoint_selector selector(replicas({3}), {});
+    ASSERT_EQ(0u, selector.select(""));
+    ASSERT_EQ(0u, selector.select("user1"));
+}
+
+TEST(endpoint_selector_test, WeightedRoundRobinIsSmooth)
+{
+    endpoint_selector selector(replicas({5, 1, 1}), {});
+    std::vector<std::size_t> picks;
+    for (int i = 0; i < 7; ++i)
+    {
+        picks.push_back(selector.select(""));
+    }
+    // The heavy endpoint is not picked 5 times in a row
+    ASSERT_EQ(std::vector<std::size_t>({0, 0, 1, 0, 2, 0, 0}), picks);
+}
+
+TEST(endpoint_selector_test, ScaledWeightsTakeTheSameTurns)
+{
+    endpoint_selector selector(replicas({200, 100}), {});
+    ASSERT_EQ(0u, selector.select(""));
+    ASSERT_EQ(1u, selector.select(""));
+    ASSERT_EQ(0u, selector.select(""));
+    ASSERT_EQ(0u, selector.select(""));
+}
+
+TEST(endpoint_selector_test, HashKeepsEveryKeyInItsEndpoint)
+{
+    const traffic::endpoint_selection hash{traffic::endpoint_policy::HASH, "user"};
+    endpoint_selector selector(replicas({1, 1, 2}), hash);
+
+    std::map<std::size_t, int> counts;
+    for (int i = 0; i < 4000; ++i)
+    {
+        const std::string key = std::to_string(i);
+        const auto e = selector.select(key);
+        ASSERT_EQ(e, selector.select(key));
+        ++counts[e];
+    }
+    // Roughly by weight
+    ASSERT_NEAR(1000, counts[0], 250);
+    ASSERT_NEAR(1000, counts[1], 250);
+    ASSERT_NEAR(2000, counts[2], 250);
+
+    // Scripts without a key are spread by weight
+    ASSERT_EQ(2u, selector.select(""));
+}
+
+TEST(endpoint_selector_test, HashOnlyMovesTheKeysOfARemovedEndpoint)
+{
+    const traffic::endpoint_selection hash{traffic::endpoint_policy::HASH, "user"};
+    auto eps = replicas({1, 1, 1});
+    endpoint_selector three(eps, hash);
+    eps.pop_back();
+    endpoint_selector two(eps, hash);
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        const std::string key = std::to_string(i);
+        if (const auto e = three.select(key); e < 2)
+        {
+            ASSERT_EQ(e, two.select(key));
+        }
+    }
+}
+TEST(endpoint_selector_test, HashKeepsTheKeysOfTheOthersWhenAnEndpointIsAdded)
+{
+    const traffic::endpoint_selection hash{traffic::endpoint_policy::HASH, "user"};
+    auto eps = replicas({2, 4});
+    endpoint_selector two(eps, hash);
+    eps.push_back({"replica2", "8080", 3});
+    endpoint_selector three(eps, hash);
+
+    std::size_t moved{0};
+    for (int i = 0; i < 3000; ++i)
+    {
+        const std::string key = std::to_string(i);
+        if (const auto e = three.select(key); e < 2)
+        {
+            ASSERT_EQ(two.select(key), e);
+        }
+        else
+        {
+            ++moved;
+        }
+    }
+    // Only the share of the new endpoint moves
+    ASSERT_NEAR(1000, moved, 250);
+}
+
+TEST(endpoint_selector_test, WeightsAreCapped)
+{
+    endpoint_selector selector(replicas({2000000000, traffic::max_endpoint_weight}), {});
+    ASSERT_EQ(0u, selector.select(""));
+    ASSERT_EQ(1u, selector.select(""));
+}
+}  // namespace http2_client
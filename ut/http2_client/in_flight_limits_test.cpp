@@ -0,0 +1,36 @@
+#include "in_flight_limits.hpp"
+
+#include <gtest/gtest.h>
+
+namespace config
+{
+TEST(in_flight_limits_test, ParseLimits)
+{
+    const auto limits = parse_in_flight_limits("requests=100,scripts=20,policy=queue,queue=50");
+    ASSERT_TRUE(limits.enabled());
+    ASSERT_EQ(100u, limits.max_requests);
+    ASSERT_EQ(20u, limits.max_scripts);
+    ASSERT_EQ(overload_policy::QUEUE, limits.policy);
+    ASSERT_EQ(50u, limits.queue_size);
+
+    ASSERT_EQ(overload_policy::DELAY, parse_in_flight_limits("policy=delay").policy);
+    ASSERT_FALSE(parse_in_flight_limits("policy=skip").enabled());
+
+    ASSERT_THROW(parse_in_flight_limits("requests=-1"), std::invalid_argument);
+    ASSERT_THROW(parse_in_flight_limits("requests=1k"), std::invalid_argument);
+    ASSERT_THROW(parse_in_flight_limits("requests"), std::invalid_argument);
+    ASSERT_THROW(parse_in_flight_limits("policy=drop"), std::invalid_argument);
+    ASSERT_THROW(parse_in_flight_limits("streams=10"), std::invalid_argument);
+}
+
+TEST(in_flight_limits_test, ShardsRoundLimitsUp)
+{
+    in_flight_limits limits;
+    limits.max_requests = 10;
+    limits.queue_size = 100;
+    const auto shard = limits.shard(4);
+    ASSERT_EQ(3u, shard.max_requests);
+    ASSERT_EQ(0u, shard.max_scripts);
+    ASSERT_EQ(25u, shard.queue_size);
+}
+}  // namespace config
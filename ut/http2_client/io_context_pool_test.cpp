@@ -0,0 +1,105 @@
+#include "io_context_pool.hpp"
+
+#include <gtest/gtest.h>
+
+#include <boost/asio.hpp>
+#include <future>
+#include <set>
+#include <thread>
+
+#include "io_threads.hpp"
+
+namespace http2_client
+{
+TEST(io_context_pool_test, ParseThreads)
+{
+    const auto threads = config::parse_io_threads("connections=8,stats=4");
+    ASSERT_EQ(8u, threads.connections);
+    ASSERT_EQ(4u, threads.stats);
+    ASSERT_EQ(0u, config::parse_io_threads("").connections);
+    ASSERT_EQ(2u, config::parse_io_threads("connections=2").stats);
+
+    // Split among the shards, the first ones taking the rest
+    ASSERT_EQ(3u, threads.shard(0, 3));
+    ASSERT_EQ(3u, threads.shard(1, 3));
+    ASSERT_EQ(2u, threads.shard(2, 3));
+    // Every shard gets at least one
+    ASSERT_EQ(1u, config::parse_io_threads("connections=1").shard(3, 4));
+    ASSERT_LE(1u, config::parse_io_threads("").shard(0, 1));
+
+    ASSERT_THROW(config::parse_io_threads("stats=0"), std::invalid_argument);
+    ASSERT_THROW(config::parse_io_threads("connections=-1"), std::invalid_argument);
+    ASSERT_THROW(config::parse_io_threads("connections"), std::invalid_argument);
+    ASSERT_THROW(config::parse_io_threads("workers=2"), std::invalid_argument);
+}
+
+TEST(io_context_pool_test, ContextsAreGivenInTurns)
+{
+    io_context_pool contexts(2);
+    ASSERT_EQ(2u, contexts.size());
+
+    auto& first = contexts.next();
+    auto& second = contexts.next();
+    ASSERT_NE(&first, &second);
+    ASSERT_EQ(&first, &contexts.next());
+    ASSERT_EQ(&second, &contexts.next());
+}
+
+TEST(io_context_pool_test, EveryContextRunsInItsOwnThread)
+{
+    io_context_pool contexts(3);
+    std::set<std::thread::id> ids;
+    for (std::size_t i = 0; i < contexts.size(); ++i)
+    {
+        std::promise<std::thread::id> id;
+        boost::asio::post(contexts.next().io,
+                          [&id]() { id.set_value(std::this_thread::get_id()); });
+        ids.insert(id.get_future().get());
+    }
+    ASSERT_EQ(3u, ids.size());
+    ASSERT_EQ(0u, ids.count(std::this_thread::get_id()));
+}
+
+TEST(io_context_pool_test, EveryContextHasItsOwnWheel)
+{
+    io_context_pool contexts(2);
+    auto& first = contexts.next();
+    auto& second = contexts.next();
+    ASSERT_NE(&first.timeouts, &second.timeouts);
+    ASSERT_FALSE(first.ticking);
+
+    const std::string id{"msg"};
+    const auto now = std::chrono::steady_clock::now();
+    first.timeouts.arm(now, std::chrono::milliseconds(100), id, now);
+    ASSERT_EQ(1u, first.timeouts.size());
+    ASSERT_EQ(0u, second.timeouts.size());
+}
+
+TEST(io_context_pool_test, StopDropsWhatIsLeft)
+{
+    io_context_pool contexts(1);
+    contexts.stop();
+
+    bool run{false};
+    boost::asio::post(contexts.next().io, [&run]() { run = true; });
+    contexts.stop();
+    ASSERT_FALSE(run);
+}
+
+TEST(io_context_pool_test, ShutdownDestroysWhatIsLeft)
+{
+    io_context_pool contexts(1);
+    contexts.stop();
+
+    auto held = std::make_shared<int>(0);
+    boost::asio::post(contexts.next().io, [held]() {});
+    const std::weak_ptr<int> weak = held;
+    held.reset();
+    contexts.stop();
+    ASSERT_FALSE(weak.expired());
+
+    contexts.shutdown();
+    ASSERT_TRUE(weak.expired());
+    ASSERT_EQ(0u, contexts.size());
+}
+}  // namespace http2_client
@@ -0,0 +1,91 @@
+#include "mpsc_ring.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace http2_client
+{
+TEST(mpsc_ring_test, PopsInTheOrderPushed)
+{
+    mpsc_ring<int> ring(3);
+    ASSERT_EQ(4u, ring.capacity());
+
+    int value{0};
+    ASSERT_FALSE(ring.pop(value));
+    for (int i = 0; i < 4; ++i)
+    {
+        ASSERT_TRUE(ring.push(i));
+    }
+    ASSERT_FALSE(ring.push(4));
+
+    for (int i = 0; i < 4; ++i)
+    {
+        ASSERT_TRUE(ring.pop(value));
+        ASSERT_EQ(i, value);
+    }
+    ASSERT_FALSE(ring.pop(value));
+}
+
+TEST(mpsc_ring_test, CellsAreReusedLapAfterLap)
+{
+    mpsc_ring<int> ring(2);
+    int value{0};
+    for (int i = 0; i < 100; ++i)
+    {
+        ASSERT_TRUE(ring.push(i));
+        ASSERT_TRUE(ring.pop(value));
+        ASSERT_EQ(i, value);
+    }
+}
+
+TEST(mpsc_ring_test, NothingIsLostWithManyProducers)
+{
+    constexpr int producers{4};
+    constexpr int per_producer{20000};
+    mpsc_ring<int> ring(64);
+    std::atomic<bool> go{false};
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back(
+            [&ring, &go, p]()
+            {
+                while (!go)
+                {
+                }
+                for (int i = 0; i < per_producer; ++i)
+                {
+                    while (!ring.push(p * per_producer + i))
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+    }
+
+    go = true;
+    std::vector<int> last(producers, -1);
+    int value{0};
+    for (int popped = 0; popped < producers * per_producer;)
+    {
+        if (!ring.pop(value))
+        {
+            continue;
+        }
+        ++popped;
+        // Every producer is seen in its own order
+        const int p = value / per_producer;
+        ASSERT_LT(last[p], value % per_producer);
+        last[p] = value % per_producer;
+    }
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    ASSERT_EQ(std::vector<int>(producers, per_producer - 1), last);
+}
+}  // namespace http2_client
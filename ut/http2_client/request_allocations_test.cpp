@@ -0,0 +1,164 @@
+#include <gtest/gtest.h>
+#include <nghttp2/asio_http2_client.h>
+
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <new>
+
+#include "client_utils.hpp"
+#include "json_reader.hpp"
+#include "request_context.hpp"
+#include "script.hpp"
+
+#if defined(__GNUC__) && !defined(__clang__)
+// The replacements below free what they allocate themselves
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+namespace
+{
+// Allocations made by the thread running the test, whatever other threads do
+thread_local std::size_t allocations{0};
+}  // namespace
+
+void* operator new(std::size_t size)
+{
+    ++allocations;
+    if (void* p = std::malloc(size ? size : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace http2_client
+{
+namespace ng = nghttp2::asio_http2;
+
+/**
+ * The bookkeeping of a request through the client, as client_impl does it, up
+ * to the stream: a pooled context is filled with the next request of the
+ * script, the callbacks of the stream borrow it, its answer is kept in its
+ * buffer, and it is given back once the stream is closed. Submitting, the
+ * answer checks and the spans are left out, as they need a server and a tracer.
+ */
+class request_allocations_test : public ::testing::Test
+{
+public:
+    request_allocations_test()
+    {
+        traffic::json_reader json;
+        json.set<std::string>("/dns", "localhost");
+        json.set<std::string>("/port", "8080");
+        json.set<int>("/timeout", 2000);
+        json.set<std::vector<std::string>>("/flow", {"test1"});
+        json.set<std::string>("/messages/test1/url", "v1/subscribers/provisioning/test");
+        json.set<traffic::json_reader>("/messages/test1/body",
+                                       {R"({"subscriber":"some-subscriber-id"})", ""});
+        json.set<std::string>("/messages/test1/method", "POST");
+        json.set<std::string>("/messages/test1/headers/x-correlation-context",
+                              "some-long-correlation-value");
+        json.set<int>("/messages/test1/response/code", 200);
+        // So that the answers are kept
+        json.set<std::string>("/messages/test1/save_from_answer/id/path", "/id");
+        json.set<std::string>("/messages/test1/save_from_answer/id/value_type", "string");
+        script = std::make_shared<traffic::script>(json);
+    }
+
+    // Returns once the stream of the request is closed
+    void send_and_receive()
+    {
+        auto ctx = contexts.acquire();
+        fill_next_request(ctx->req, uri_prefix, *script);
+        ctx->script = script;
+        ctx->intended_time = std::chrono::steady_clock::now();
+        ctx->index = 1;
+
+        // As the stream keeps them, with the captures of client_impl
+        request_context* stream_ctx = ctx.detach();
+        on_response = [this, stream_ctx](const ng::client::response&) { answer(stream_ctx); };
+        on_close = [this, stream_ctx](uint32_t)
+        {
+            request_context_ptr adopted(stream_ctx, false);
+            ++closed;
+        };
+
+        on_response(res);
+        for (int i = 0; i < 4; ++i)
+        {
+            on_data(reinterpret_cast<const uint8_t*>(chunk.data()), chunk.size());
+        }
+        on_data(nullptr, 0);
+        on_close(0);
+    }
+
+protected:
+    void answer(request_context* ctx)
+    {
+        if (const auto* compiled = ctx->script->get_next_template())
+        {
+            ctx->keep_answer = compiled->needs_body;
+        }
+        on_data = [this, ctx](const uint8_t* data, std::size_t len) { receive(ctx, data, len); };
+    }
+
+    void receive(request_context* ctx, const uint8_t* data, const std::size_t len)
+    {
+        if (len > 0)
+        {
+            ctx->answer_bytes += len;
+            if (ctx->keep_answer)
+            {
+                ctx->answer.append(reinterpret_cast<const char*>(data), len);
+            }
+            return;
+        }
+        answered += ctx->answer.size();
+    }
+
+    request_context_pool contexts;
+    std::shared_ptr<traffic::script> script;
+    const std::string uri_prefix{build_uri_prefix("localhost", "8080")};
+    const std::string chunk = std::string(200, 'c');
+
+    // Only handed to the callback, as nghttp2 does
+    ng::client::response res;
+    std::function<void(const ng::client::response&)> on_response;
+    std::function<void(const uint8_t*, std::size_t)> on_data;
+    std::function<void(uint32_t)> on_close;
+    std::size_t answered{0};
+    std::size_t closed{0};
+};
+
+TEST_F(request_allocations_test, SteadyStateRequestsDoNotAllocate)
+{
+    // Warming up fills the pool and the buffers
+    for (int i = 0; i < 100; ++i)
+    {
+        send_and_receive();
+    }
+
+    const std::size_t before = allocations;
+    for (int i = 0; i < 100000; ++i)
+    {
+        send_and_receive();
+    }
+    ASSERT_EQ(0u, allocations - before);
+
+    ASSERT_EQ(1u, contexts.size());
+    ASSERT_EQ(1u, contexts.available());
+    ASSERT_EQ(100100u, closed);
+    ASSERT_EQ(800u * 100100, answered);
+}
+}  // namespace http2_client
@@ -0,0 +1,109 @@
+#include "request_context.hpp"
+
+#include <gtest/gtest.h>
+
+#include <functional>
+
+namespace http2_client
+{
+TEST(request_context_test, ContextsAreReused)
+{
+    request_context_pool pool;
+    request_context* first{nullptr};
+    {
+        auto ctx = pool.acquire();
+        first = ctx.get();
+        ASSERT_EQ(0u, pool.available());
+    }
+    ASSERT_EQ(1u, pool.available());
+
+    auto ctx = pool.acquire();
+    ASSERT_EQ(first, ctx.get());
+    ASSERT_EQ(1u, pool.size());
+}
+
+TEST(request_context_test, ContextsAreOnlyGivenBackWithTheirLastReference)
+{
+    request_context_pool pool;
+    auto ctx = pool.acquire();
+    auto borrowed = ctx;
+    ctx.reset();
+    ASSERT_EQ(0u, pool.available());
+
+    // A different one is handed out meanwhile
+    ASSERT_NE(borrowed, pool.acquire());
+    borrowed.reset();
+    ASSERT_EQ(2u, pool.available());
+}
+
+TEST(request_context_test, ContextsAreClearedButKeepTheirBuffers)
+{
+    request_context_pool pool;
+    const std::string answer(1000, 'a');
+    const void* buffer{nullptr};
+    {
+        auto ctx = pool.acquire();
+        ctx->req.url = "http://localhost:8080/v1/test";
+        ctx->index = 3;
+        ctx->answer = answer;
+        buffer = ctx->answer.data();
+    }
+
+    auto ctx = pool.acquire();
+    ASSERT_TRUE(ctx->req.url.empty());
+    ASSERT_TRUE(ctx->answer.empty());
+    ASSERT_EQ(0u, ctx->index);
+    ASSERT_EQ(buffer, ctx->answer.data());
+}
+
+// The bookkeeping of a request through the client, as it is done in client_impl: a context
+// is taken, filled, its callbacks registered and it is given back
+TEST(request_context_test, SteadyStateRequestsReuseTheirContext)
+{
+    request_context_pool pool;
+    const std::string url(60, 'u'), name(20, 'n'), chunk(200, 'c');
+    std::size_t answered{0};
+    const void* answer_buffer{nullptr};
+    std::function<void(const uint8_t*, std::size_t)> on_data;
+    std::function<void(uint32_t)> on_close;
+
+    const auto send_and_receive = [&]()
+    {
+        auto ctx = pool.acquire();
+        ctx->req.url.assign(url);
+        ctx->req.name.assign(name);
+        ctx->intended_time = std::chrono::steady_clock::now();
+
+        request_context* stream_ctx = ctx.detach();
+        on_data = [&answered, &answer_buffer, stream_ctx](const uint8_t* data, std::size_t len)
+        {
+            if (len > 0)
+            {
+                stream_ctx->answer.append(reinterpret_cast<const char*>(data), len);
+                return;
+            }
+            answered += stream_ctx->answer.size();
+            answer_buffer = stream_ctx->answer.data();
+        };
+        on_close = [stream_ctx](uint32_t) { request_context_ptr adopted(stream_ctx, false); };
+
+        for (int i = 0; i < 4; ++i)
+        {
+            on_data(reinterpret_cast<const uint8_t*>(chunk.data()), chunk.size());
+        }
+        on_data(nullptr, 0);
+        on_close(0);
+    };
+
+    send_and_receive();
+    const void* first_buffer = answer_buffer;
+    for (int i = 0; i < 1000; ++i)
+    {
+        send_and_receive();
+        ASSERT_EQ(first_buffer, answer_buffer);
+    }
+    ASSERT_EQ(1u, pool.size());
+    ASSERT_EQ(1u, pool.available());
+    ASSERT_EQ(800u * 1001, answered);
+}
+}  // namespace http2_client
@@ -0,0 +1,132 @@
+#include "timeout_wheel.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace std::chrono_literals;
+
+namespace http2_client
+{
+class timeout_wheel_test : public ::testing::Test
+{
+public:
+    timeout_wheel_test() : start(std::chrono::steady_clock::now()), wheel(start, 10ms, 8) {}
+
+    timeout_wheel::handler collect()
+    {
+        return [this](uint64_t owner, const std::string& id,
+                      const timeout_wheel::time_point& origin)
+        {
+            owners.push_back(owner);
+            expired.push_back(id);
+            origins.push_back(origin);
+        };
+    }
+
+protected:
+    timeout_wheel::time_point start;
+    timeout_wheel wheel;
+    std::vector<uint64_t> owners;
+    std::vector<std::string> expired;
+    std::vector<timeout_wheel::time_point> origins;
+    // Kept by reference while armed
+    const std::string msg1{"msg1"};
+    const std::string msg2{"msg2"};
+    const std::string msg3{"msg3"};
+};
+
+TEST_F(timeout_wheel_test, ExpiresNeverEarlyAndAtMostOneTickLate)
+{
+    wheel.arm(start + 5ms, 100ms, msg1, start);
+    ASSERT_EQ(1u, wheel.size());
+
+    wheel.advance(start + 104ms, collect());
+    ASSERT_TRUE(expired.empty());
+
+    wheel.advance(start + 110ms, collect());
+    ASSERT_EQ(std::vector<std::string>{"msg1"}, expired);
+    ASSERT_EQ(0u, wheel.size());
+}
+
+TEST_F(timeout_wheel_test, OriginIsGivenBackOnExpiry)
+{
+    wheel.arm(start + 50ms, 10ms, msg1, start + 20ms);
+    wheel.advance(start + 100ms, collect());
+    ASSERT_EQ(std::vector<timeout_wheel::time_point>{start + 20ms}, origins);
+}
+
+TEST_F(timeout_wheel_test, CancelledTimeoutsDoNotExpire)
+{
+    const auto h1 = wheel.arm(start, 20ms, msg1, start);
+    wheel.arm(start, 20ms, msg2, start);
+    ASSERT_TRUE(wheel.cancel(h1));
+    ASSERT_FALSE(wheel.cancel(h1));
+
+    wheel.advance(start + 30ms, collect());
+    ASSERT_EQ(std::vector<std::string>{"msg2"}, expired);
+}
+
+TEST_F(timeout_wheel_test, ExpiredTimeoutsCannotBeCancelled)
+{
+    const auto h = wheel.arm(start, 10ms, msg1, start);
+    wheel.advance(start + 10ms, collect());
+    ASSERT_FALSE(wheel.cancel(h));
+}
+
+TEST_F(timeout_wheel_test, ReusedEntriesIgnoreOldHandles)
+{
+    const auto old_handle = wheel.arm(start, 10ms, msg1, start);
+    ASSERT_TRUE(wheel.cancel(old_handle));
+
+    const auto new_handle = wheel.arm(start, 10ms, msg2, start);
+    ASSERT_EQ(old_handle.index, new_handle.index);
+    ASSERT_FALSE(wheel.cancel(old_handle));
+    ASSERT_TRUE(wheel.cancel(new_handle));
+}
+
+TEST_F(timeout_wheel_test, TimeoutsLongerThanARevolutionWaitForTheirRound)
+{
+    // 8 slots of 10ms
+    wheel.arm(start, 250ms, msg1, start);
+    wheel.advance(start + 100ms, collect());
+    wheel.advance(start + 200ms, collect());
+    ASSERT_TRUE(expired.empty());
+
+    wheel.advance(start + 250ms, collect());
+    ASSERT_EQ(1u, expired.size());
+}
+
+TEST_F(timeout_wheel_test, LongStallsExpireEverythingDue)
+{
+    wheel.arm(start, 30ms, msg1, start);
+    wheel.arm(start, 70ms, msg2, start);
+    wheel.arm(start, 2s, msg3, start);
+    wheel.advance(start + 1s, collect());
+    ASSERT_EQ(2u, expired.size());
+    ASSERT_EQ(1u, wheel.size());
+}
+
+TEST_F(timeout_wheel_test, ExpireAll)
+{
+    wheel.arm(start, 30ms, msg1, start);
+    const auto h = wheel.arm(start, 5s, msg2, start);
+    wheel.expire_all(0, collect());
+    ASSERT_EQ(2u, expired.size());
+    ASSERT_EQ(0u, wheel.size());
+    ASSERT_FALSE(wheel.cancel(h));
+}
+
+TEST_F(timeout_wheel_test, ExpireAllOnlyTakesThoseOfTheOwner)
+{
+    wheel.arm(start, 30ms, msg1, start, 1);
+    wheel.arm(start, 30ms, msg2, start, 2);
+    wheel.arm(start, 5s, msg3, start, 1);
+    wheel.expire_all(1, collect());
+    ASSERT_EQ((std::vector<std::string>{"msg1", "msg3"}), expired);
+    ASSERT_EQ((std::vector<uint64_t>{1, 1}), owners);
+    ASSERT_EQ(1u, wheel.size());
+
+    wheel.advance(start + 40ms, collect());
+    ASSERT_EQ("msg2", expired.back());
+    ASSERT_EQ(2u, owners.back());
+}
+}  // namespace http2_client
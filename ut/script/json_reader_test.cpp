@@ -107,6 +107,52 @@ TEST(json_reader_test, CopyCtor)
     ASSERT_EQ(json, other_json);
 }
 
+TEST(json_reader_test, MoveCtor)
+{
+    std::string json_str = R"({"attr1": ["arr1", "arr2"], "attr2": 5})";
+    auto json = json_reader(json_str, "");
+    json_reader copy(json);
+    json_reader moved_json(std::move(copy));
+    ASSERT_EQ(json, moved_json);
+}
+
+TEST(json_reader_test, GetStringView)
+{
+    json_reader json(R"({"str": "hel\u0000lo", "int": 2})", "");
+    ASSERT_EQ(std::string_view("hel\0lo", 6), json.get_value<std::string_view>("/str"));
+    EXPECT_THROW(json.get_value<std::string_view>("/int"), std::out_of_range);
+    EXPECT_THROW(json.get_value<std::string_view>("/none"), std::out_of_range);
+}
+
+TEST(json_reader_test, PointerUsedOnSeveralDocuments)
+{
+    const json_pointer ptr{"/sub_json/value"};
+    ASSERT_TRUE(ptr.is_valid());
+    ASSERT_EQ("/sub_json/value", ptr.path());
+
+    for (const int value : {1, 2})
+    {
+        auto json = json_reader();
+        ASSERT_FALSE(json.is_present(ptr));
+        json.set(ptr, value);
+        ASSERT_TRUE(json.is_number(ptr));
+        ASSERT_FALSE(json.is_string(ptr));
+        ASSERT_EQ(value, json.get_value<int>(ptr));
+        ASSERT_EQ(json_reader(R"({"sub_json": {"value": )" + std::to_string(value) + "}}", ""),
+                  json);
+
+        json.erase(ptr);
+        ASSERT_FALSE(json.is_present(ptr));
+    }
+}
+
+TEST(json_reader_test, InvalidPointer)
+{
+    const json_pointer ptr{"no_slash"};
+    ASSERT_FALSE(ptr.is_valid());
+    ASSERT_FALSE(json_reader().is_present(ptr));
+}
+
 TEST(json_reader_test, SetGetString)
 {
     auto json = json_reader();
@@ -0,0 +1,104 @@
+#include "message_template.hpp"
+
+#include <gtest/gtest.h>
+
+#include <map>
+
+namespace traffic
+{
+message build_message(const msg_headers& headers, const std::string& body)
+{
+    message m;
+    m.id = "test1";
+    m.url = "v1/test";
+    m.method = "POST";
+    m.body = body;
+    m.headers = headers;
+    return m;
+}
+
+TEST(message_template_test, StaticHeadersAreBuiltOnce)
+{
+    const auto compiled = compile_message(build_message({{"x-id", "hermes"}}, "{\"a\":1}"));
+    ASSERT_TRUE(compiled->headers);
+    ASSERT_EQ(7u, compiled->body_size);
+    ASSERT_EQ(*compiled->headers, build_request_headers(7, {{"x-id", "hermes"}}));
+}
+
+TEST(message_template_test, HeadersWithPlaceholdersAreLeftOut)
+{
+    ASSERT_FALSE(compile_message(build_message({{"x-id", "<id>"}}, ""))->headers);
+    ASSERT_FALSE(compile_message(build_message({{"x-<name>", "hermes"}}, ""))->headers);
+}
+
+TEST(message_template_test, RequestHeadersHaveTypeAndLength)
+{
+    const auto headers = build_request_headers(12, {});
+    ASSERT_EQ(2u, headers.size());
+    ASSERT_EQ(APP_JSON, headers.find(CONTENT_TYPE)->second.value);
+    ASSERT_EQ("12", headers.find(CONTENT_LENGTH)->second.value);
+}
+TEST(message_template_test, AnswersAreOnlyKeptWhenFieldsAreSavedFromThem)
+{
+    auto m = build_message({}, "");
+    auto compiled = compile_message(m);
+    ASSERT_FALSE(compiled->needs_body);
+    ASSERT_FALSE(compiled->needs_headers);
+
+    m.sfa.body_fields["id"] = {"/id", "string"};
+    m.sfa.headers["location"] = "location";
+    compiled = compile_message(m);
+    ASSERT_TRUE(compiled->needs_body);
+    ASSERT_TRUE(compiled->needs_headers);
+}
+
+TEST(message_template_test, PathsOfTheFieldsAreCompiledInOrder)
+{
+    auto m = build_message({}, "");
+    m.sfa.body_fields["b"] = {"/saved/b", "int"};
+    m.sfa.body_fields["a"] = {"/saved/a", "string"};
+    m.atb["c"] = {"/added/c", "object"};
+
+    const auto compiled = compile_message(m);
+    ASSERT_EQ(2u, compiled->saved_fields.size());
+    ASSERT_EQ("/saved/a", compiled->saved_fields[0].path());
+    ASSERT_EQ("/saved/b", compiled->saved_fields[1].path());
+    ASSERT_EQ(1u, compiled->added_fields.size());
+    ASSERT_EQ("/added/c", compiled->added_fields[0].path());
+}
+
+TEST(message_template_test, PlaceholdersAreRenderedInASinglePass)
+{
+    const std::map<std::string, std::string, std::less<>> values{{"id", "7"}, {"name", "<id>"}};
+    const auto lookup = [&values](const std::string_view name) -> const std::string*
+    {
+        const auto v = values.find(name);
+        return v == values.end() ? nullptr : &v->second;
+    };
+
+    std::string out{"previous"};
+    text_template("v1/<id>/<name>/<unknown>").render(out, lookup);
+    // Values are not rendered again, and placeholders without one are kept
+    ASSERT_EQ("v1/7/<id>/<unknown>", out);
+
+    text_template("<<id>> a<b <id").render(out, lookup);
+    ASSERT_EQ("<7> a<b <id", out);
+
+    const text_template plain("{\"a\":1}");
+    ASSERT_TRUE(plain.is_static());
+    plain.render(out, lookup);
+    ASSERT_EQ("{\"a\":1}", out);
+    ASSERT_FALSE(text_template("<id>").is_static());
+}
+
+TEST(message_template_test, HeadersWithPlaceholdersAreCompiled)
+{
+    auto compiled = compile_message(build_message({{"x-id", "<id>"}, {"x-static", "a"}}, ""));
+    ASSERT_EQ(2u, compiled->dynamic_headers.size());
+    ASSERT_FALSE(compiled->dynamic_header_names);
+
+    compiled = compile_message(build_message({{"x-<name>", "hermes"}}, ""));
+    ASSERT_TRUE(compiled->dynamic_header_names);
+    ASSERT_TRUE(compile_message(build_message({{"x-id", "a"}}, ""))->dynamic_headers.empty());
+}
+}  // namespace traffic
@@ -0,0 +1,50 @@
+#include "script_arena.hpp"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+namespace traffic
+{
+TEST(script_arena_test, ArenasAreRecycled)
+{
+    auto arena = acquire_script_arena();
+    const auto* first = arena.get();
+    arena.reset();
+
+    auto again = acquire_script_arena();
+    ASSERT_EQ(first, again.get());
+}
+
+TEST(script_arena_test, BufferGrowsToWhatDidNotFit)
+{
+    script_arena arena(1024);
+    {
+        arena_string big(std::string(4000, 'x'), arena.resource());
+        ASSERT_EQ(1024u, arena.capacity());
+    }
+    arena.reset();
+    ASSERT_GE(arena.capacity(), 5024u);
+    {
+        // The next one fits in the buffer
+        arena_string again(std::string(4000, 'y'), arena.resource());
+    }
+    arena.reset();
+    ASSERT_GE(arena.capacity(), 5024u);
+    ASSERT_LT(arena.capacity(), 9024u);
+}
+
+TEST(script_arena_test, MapsAreAssignedByView)
+{
+    script_arena arena(1024);
+    arena_map<arena_string> values(arena.resource());
+    assign(values, "id", std::string("1"));
+    assign(values, std::string("id"), std::string("2"));
+    assign(values, "other", "3");
+
+    ASSERT_EQ(2u, values.size());
+    const auto& id = values.find(std::string_view("id"))->second;
+    ASSERT_EQ("2", id);
+    ASSERT_EQ(arena.resource(), id.get_allocator().resource());
+}
+}  // namespace traffic
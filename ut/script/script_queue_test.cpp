@@ -2,10 +2,16 @@
 
 #include <gtest/gtest.h>
 
+#include <limits>
+
 class script_queue_sut : public traffic::script_queue
 {
 public:
     script_queue_sut(const traffic::script& s) : traffic::script_queue(s) {}
+    script_queue_sut(const traffic::script& s, int64_t index, int64_t count)
+        : traffic::script_queue(s, index, count)
+    {
+    }
     int64_t get_current(const std::string& range) { return current_in_range[range]; }
 };
 
@@ -125,6 +131,45 @@ TEST_F(script_queue_test, CloseWindowAndCancelCurrentReturnsNoneAndNoMorePending
     ASSERT_TRUE(script_queue->is_window_closed());
 }
 
+TEST_F(script_queue_test, NoNewScriptsBeyondTheLimit)
+{
+    auto json = build_script();
+    json.set<std::vector<std::string>>("/flow", {"test1", "test1"});
+    setup_queue(json);
+    script_queue->set_max_in_flight(2);
+    ASSERT_EQ(2, script_queue->get_room());
+
+    auto first = script_queue->get_next_script();
+    auto second = script_queue->get_next_script();
+    ASSERT_TRUE(first && second);
+    ASSERT_EQ(0, script_queue->get_room());
+    ASSERT_FALSE(script_queue->get_next_script());
+
+    // Ongoing scripts go on, as they do not start a new one
+    script_queue->enqueue_script(std::move(first), {200, R"("OK")"});
+    ASSERT_EQ(1, script_queue->get_room());
+    ASSERT_TRUE(script_queue->get_next_script());
+
+    script_queue->cancel_script();
+    ASSERT_EQ(1, script_queue->get_room());
+    ASSERT_TRUE(script_queue->get_next_script());
+}
+
+TEST_F(script_queue_test, RoomOnceTheWindowIsClosedIsWhatIsWaiting)
+{
+    auto json = build_script();
+    json.set<std::vector<std::string>>("/flow", {"test1", "test1"});
+    setup_queue(json);
+    ASSERT_EQ(std::numeric_limits<int64_t>::max(), script_queue->get_room());
+
+    auto script = script_queue->get_next_script();
+    script_queue->close_window();
+    ASSERT_EQ(0, script_queue->get_room());
+
+    script_queue->enqueue_script(std::move(script), {200, R"("OK")"});
+    ASSERT_EQ(1, script_queue->get_room());
+}
+
 TEST_F(script_queue_test, EnqueueMultipleMessageScriptAndRangesRunTwice)
 {
     auto json = build_script();
@@ -157,6 +202,22 @@ TEST_F(script_queue_test, EnqueueMultipleMessageScriptAndRangesRunTwice)
     ASSERT_EQ(5, script_queue->get_current("range1"));
 }
 
+TEST_F(script_queue_test, RangesAreStridedAmongShards)
+{
+    auto json = build_script();
+    json.set<int>("/ranges/range1/min", 1);
+    json.set<int>("/ranges/range1/max", 5);
+    script_queue_sut shard(traffic::script(json), 1, 2);
+
+    std::vector<int64_t> values;
+    for (int i = 0; i < 5; ++i)
+    {
+        ASSERT_TRUE(shard.get_next_script());
+        values.push_back(shard.get_current("range1"));
+    }
+    ASSERT_EQ((std::vector<int64_t>{2, 4, 2, 4, 2}), values);
+}
+
 TEST_F(script_queue_test, ParseVariables)
 {
     auto json = build_script();
@@ -168,7 +229,7 @@ TEST_F(script_queue_test, ParseVariables)
 
     auto script = script_queue->get_next_script();
     ASSERT_TRUE(script);
-    traffic::json_reader next_body(script->get_next_body(), "{}");
+    traffic::json_reader next_body(std::string(script->get_next_body()), "{}");
     ASSERT_EQ(next_body.get_value<std::string>("/entry"), "1");
     ASSERT_EQ(script->get_next_url(), "v1/url/lol");
 }
\ No newline at end of file
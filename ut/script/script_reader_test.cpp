@@ -407,4 +407,41 @@ TEST_F(script_reader_test, ParseMessageHeadersEmptyObject)
     ASSERT_THROW(script_reader(json.as_string()), std::logic_error);
 }
 
+TEST_F(script_reader_test, BuildLoadProfileNotPresent)
+{
+    auto sr = script_reader(build_script().as_string());
+    ASSERT_EQ(nullptr, sr.build_load_profile());
+}
+
+TEST_F(script_reader_test, BuildLoadProfileRamp)
+{
+    auto json = build_script();
+    json.set<std::string>("/load_profile/shape", "ramp");
+    json.set<int>("/load_profile/from", 10);
+    json.set<double>("/load_profile/to", 20.5);
+    json.set<int>("/load_profile/seconds", 10);
+    auto sr = script_reader(json.as_string());
+    const auto profile = sr.build_load_profile();
+
+    ASSERT_NE(nullptr, profile);
+    ASSERT_DOUBLE_EQ(10, profile->rate_at(0));
+    ASSERT_DOUBLE_EQ(20.5, profile->rate_at(10));
+}
+
+TEST_F(script_reader_test, BuildLoadProfileMissingField)
+{
+    auto json = build_script();
+    json.set<std::string>("/load_profile/shape", "sine");
+    json.set<int>("/load_profile/mean", 10);
+    auto sr = script_reader(json.as_string());
+    ASSERT_THROW(sr.build_load_profile(), std::logic_error);
+}
+
+TEST_F(script_reader_test, BuildLoadProfileWrongShape)
+{
+    auto json = build_script();
+    json.set<std::string>("/load_profile/shape", "square");
+    ASSERT_THROW(script_reader(json.as_string()), std::logic_error);
+}
+
 }  // namespace traffic
@@ -63,6 +63,69 @@ TEST_F(script_test, SecureSetToTrue)
     ASSERT_TRUE(script->is_server_secure());
 }
 
+TEST_F(script_test, SingleServerIsTheOnlyEndpoint)
+{
+    traffic::script script{build_script()};
+    ASSERT_EQ(1u, script.get_endpoints().size());
+    EXPECT_EQ("public-dns", script.get_endpoints()[0].dns);
+    EXPECT_EQ("8686", script.get_endpoints()[0].port);
+    EXPECT_EQ(1u, script.get_endpoints()[0].weight);
+    EXPECT_FALSE(script.get_endpoint());
+}
+
+TEST_F(script_test, EndpointsWithWeights)
+{
+    auto json = build_script();
+    json.set<std::string>("/endpoints/0/dns", "replica-a");
+    json.set<std::string>("/endpoints/0/port", "8080");
+    json.set<int>("/endpoints/0/weight", 3);
+    json.set<std::string>("/endpoints/1/dns", "replica-b");
+    json.set<std::string>("/endpoints/1/port", "8081");
+
+    traffic::script script{json};
+    ASSERT_EQ(2u, script.get_endpoints().size());
+    EXPECT_EQ(3u, script.get_endpoints()[0].weight);
+    EXPECT_EQ("replica-b", script.get_endpoints()[1].dns);
+    EXPECT_EQ(1u, script.get_endpoints()[1].weight);
+    // The first endpoint is the server
+    EXPECT_EQ("replica-a", script.get_server_dns());
+    EXPECT_EQ(traffic::endpoint_policy::WEIGHTED_ROUND_ROBIN,
+              script.get_endpoint_selection().policy);
+}
+
+TEST_F(script_test, EndpointWeightAboveTheMaximum)
+{
+    auto json = build_script();
+    json.set<std::string>("/endpoints/0/dns", "replica-a");
+    json.set<std::string>("/endpoints/0/port", "8080");
+    json.set<int>("/endpoints/0/weight", 1001);
+
+    ASSERT_THROW(traffic::script script{json}, std::invalid_argument);
+}
+
+TEST_F(script_test, EndpointsHashedOnARange)
+{
+    auto json = build_script();
+    json.set<int>("/ranges/user/min", 1);
+    json.set<int>("/ranges/user/max", 9);
+    json.set<std::string>("/endpoint_selection/policy", "hash");
+    json.set<std::string>("/endpoint_selection/variable", "user");
+
+    traffic::script script{json};
+    script.parse_ranges({{"user", 7}});
+    EXPECT_EQ(traffic::endpoint_policy::HASH, script.get_endpoint_selection().policy);
+    EXPECT_EQ("7", script.get_endpoint_key());
+}
+
+TEST_F(script_test, EndpointsHashedOnAnUnknownVariable)
+{
+    auto json = build_script();
+    json.set<std::string>("/endpoint_selection/policy", "hash");
+    json.set<std::string>("/endpoint_selection/variable", "user");
+
+    ASSERT_THROW(traffic::script script{json}, std::invalid_argument);
+}
+
 TEST_F(script_test, PostProcessLastMessageReturnsFalse)
 {
     const auto json = build_script();
@@ -215,6 +278,29 @@ TEST_F(script_test, PostProcessCorrectObjectValueInSFAUsedInATB)
     ASSERT_EQ(answer.as_string(), script.get_next_body());
 }
 
+TEST_F(script_test, PostProcessSeveralValuesOfOneAnswer)
+{
+    auto json = build_script();
+    json.set<std::vector<std::string>>("/flow", {"test1", "test1"});
+    for (const std::string type : {"string", "int", "object"})
+    {
+        json.set<std::string>("/messages/test1/save_from_answer/my_" + type + "/path", "/" + type);
+        json.set<std::string>("/messages/test1/save_from_answer/my_" + type + "/value_type", type);
+        json.set<std::string>("/messages/test1/add_from_saved_to_body/my_" + type + "/path",
+                              "/new/" + type);
+        json.set<std::string>(
+            "/messages/test1/add_from_saved_to_body/my_" + type + "/value_type", type);
+    }
+    traffic::script script{json};
+
+    const traffic::json_reader answer{R"({"string": "hi", "int": 7, "object": {"a": [1]}})", ""};
+    ASSERT_TRUE(script.post_process(traffic::answer_type{200, answer.as_string()}));
+
+    const traffic::json_reader expected{
+        R"({"new": {"int": 7, "object": {"a": [1]}, "string": "hi"}})", ""};
+    ASSERT_EQ(expected, traffic::json_reader(std::string(script.get_next_body()), ""));
+}
+
 TEST_F(script_test, PostProcessSaveHeadersAndUseThemLater)
 {
     auto json = build_script();
@@ -260,6 +346,24 @@ TEST_F(script_test, PostProcessSaveHeadersAndUseThemLater)
     ASSERT_EQ(expected_next_url, script.get_next_url());
 }
 
+TEST_F(script_test, PostProcessVariablesWinOverHeadersOfTheSameName)
+{
+    auto json = build_script();
+    json.set<std::string>("/variables/token", "from-variable");
+    json.set<std::string>("/messages/test1/save_from_answer/headers/token", "x-token");
+    json.set<std::string>("/messages/test2/url", "v1/<token>");
+    json.set<std::string>("/messages/test2/method", "GET");
+    json.set<int>("/messages/test2/response/code", 200);
+    json.set<std::vector<std::string>>("/flow", {"test1", "test2"});
+
+    traffic::script script{json};
+    script.parse_variables();
+
+    nghttp2::asio_http2::header_map answer_headers{{"x-token", {"from-header", false}}};
+    ASSERT_TRUE(script.post_process(traffic::answer_type{200, "{}", answer_headers}));
+    ASSERT_EQ("v1/from-variable", script.get_next_url());
+}
+
 TEST_F(script_test, PostProcessNotFoundValueInSFAToUseInATB)
 {
     const std::string expected_path{"/some/path"};
@@ -311,6 +415,47 @@ TEST_F(script_test, ParseRangesInRangeValue)
     ASSERT_EQ(script.get_next_headers(), expected_headers);
 }
 
+TEST_F(script_test, RangesAreRenderedInTheNextMessages)
+{
+    auto json = build_script();
+    json.set<int>("/ranges/my_range/min", 50);
+    json.set<int>("/ranges/my_range/max", 60);
+    json.set<int>("/variables/my_int", 3);
+    json.set<std::vector<std::string>>("/flow", {"test1", "test2"});
+    json.set<std::string>("/messages/test2/url", "/<my_range>/<my_int>/<unknown>");
+    json.set<std::string>("/messages/test2/method", "GET");
+    json.set<int>("/messages/test2/response/code", 200);
+
+    traffic::script script{json};
+    script.parse_ranges({{"my_range", 55}});
+    script.parse_variables();
+    ASSERT_TRUE(script.post_process(traffic::answer_type{200, "{}"}));
+    ASSERT_EQ("/55/3/<unknown>", script.get_next_url());
+}
+
+TEST_F(script_test, CopiesRunOnTheirOwn)
+{
+    auto json = build_script();
+    json.set<int>("/ranges/my_range/min", 50);
+    json.set<int>("/ranges/my_range/max", 60);
+    json.set<std::string>("/messages/test1/url", "/<my_range>");
+    json.set<std::vector<std::string>>("/flow", {"test1", "test1"});
+
+    const traffic::script loaded{json};
+    traffic::script first{loaded};
+    traffic::script second{loaded};
+    first.parse_ranges({{"my_range", 51}});
+    second.parse_ranges({{"my_range", 52}});
+    ASSERT_TRUE(first.post_process(traffic::answer_type{200, "{}"}));
+
+    ASSERT_EQ("/51", first.get_next_url());
+    ASSERT_EQ("/52", second.get_next_url());
+    ASSERT_EQ("/<my_range>", loaded.get_next_url());
+    // The second one is still in its first message
+    ASSERT_TRUE(second.post_process(traffic::answer_type{200, "{}"}));
+    ASSERT_FALSE(first.post_process(traffic::answer_type{200, "{}"}));
+}
+
 TEST_F(script_test, SameNameInRangesAndVariables)
 {
     auto json = build_script();
@@ -321,6 +466,19 @@ TEST_F(script_test, SameNameInRangesAndVariables)
     ASSERT_THROW(traffic::script script{json}, std::logic_error);
 }
 
+TEST_F(script_test, FirstMessageIsRenderedOnceLoaded)
+{
+    auto json = build_script();
+    json.set<int>("/variables/my_int", 50);
+    json.set<std::string>("/messages/test1/url", "/my/<my_int>/path");
+
+    const traffic::script loaded{json};
+    ASSERT_EQ("/my/50/path", loaded.get_next_url());
+    // Copies without ranges take it as it is
+    const traffic::script copy{loaded};
+    ASSERT_EQ("/my/50/path", copy.get_next_url());
+}
+
 TEST_F(script_test, ParseVariables)
 {
     auto json = build_script();
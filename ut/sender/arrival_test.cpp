@@ -0,0 +1,107 @@
+#include "arrival.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+namespace engine
+{
+double sum_gaps(arrival& a, const std::size_t n)
+{
+    double sum{0};
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        sum += a.next_gap();
+    }
+    return sum;
+}
+
+TEST(arrival_test, ConstantAlwaysReturnsOnePeriod)
+{
+    constant_arrival a;
+    for (int i = 0; i < 10; ++i)
+    {
+        ASSERT_EQ(1.0, a.next_gap());
+    }
+}
+
+TEST(arrival_test, PoissonKeepsExactMeanPerBlock)
+{
+    poisson_arrival a(42);
+    const auto n = poisson_arrival::block_size;
+    ASSERT_NEAR(double(n), sum_gaps(a, n), 1e-6);
+    ASSERT_NEAR(double(n), sum_gaps(a, n), 1e-6);
+}
+
+TEST(arrival_test, PoissonIsReproducibleForTheSameSeed)
+{
+    poisson_arrival a(7), b(7), c(8);
+    bool all_equal_c{true};
+    for (int i = 0; i < 100; ++i)
+    {
+        const double gap = a.next_gap();
+        ASSERT_EQ(gap, b.next_gap());
+        ASSERT_GT(gap, 0.0);
+        all_equal_c = all_equal_c && gap == c.next_gap();
+    }
+    ASSERT_FALSE(all_equal_c);
+}
+
+TEST(arrival_test, JitterStaysAroundNominalGrid)
+{
+    const double jitter{0.5};
+    jittered_arrival a(jitter, 3);
+    double deadline{0};
+    for (int i = 1; i <= 1000; ++i)
+    {
+        deadline += a.next_gap();
+        ASSERT_LE(std::abs(deadline - i), jitter / 2);
+    }
+}
+
+TEST(arrival_test, TraceIsNormalizedAndReplayedInLoop)
+{
+    trace_arrival a({1, 2, 3});
+    ASSERT_DOUBLE_EQ(0.5, a.next_gap());
+    ASSERT_DOUBLE_EQ(1.0, a.next_gap());
+    ASSERT_DOUBLE_EQ(1.5, a.next_gap());
+    ASSERT_DOUBLE_EQ(0.5, a.next_gap());
+}
+
+TEST(arrival_test, ParseArrivalModes)
+{
+    ASSERT_EQ(config::arrival_mode::CONSTANT, parse_arrival("constant", 1).mode);
+    ASSERT_EQ(config::arrival_mode::POISSON, parse_arrival("poisson", 1).mode);
+    ASSERT_EQ(5u, parse_arrival("poisson", 5).seed);
+
+    const auto jitter = parse_arrival("jitter:0.25", 1);
+    ASSERT_EQ(config::arrival_mode::JITTER, jitter.mode);
+    ASSERT_DOUBLE_EQ(0.25, jitter.jitter);
+}
+
+TEST(arrival_test, ParseWrongArrivalThrows)
+{
+    ASSERT_THROW(parse_arrival("bursty", 1), std::invalid_argument);
+    ASSERT_THROW(parse_arrival("jitter", 1), std::invalid_argument);
+    ASSERT_THROW(parse_arrival("jitter:2", 1), std::invalid_argument);
+    ASSERT_THROW(parse_arrival("trace:/impossible/path/to/trace", 1), std::invalid_argument);
+}
+
+TEST(arrival_test, ParseTraceFromFile)
+{
+    const std::string path{"arrival_test_trace"};
+    {
+        std::ofstream trace(path);
+        trace << "# inter-arrival times (us)" << std::endl << "100" << std::endl << "300";
+    }
+
+    const auto cfg = parse_arrival("trace:" + path, 1);
+    std::remove(path.c_str());
+
+    ASSERT_EQ(config::arrival_mode::TRACE, cfg.mode);
+    ASSERT_EQ((std::vector<double>{100, 300}), cfg.trace);
+}
+
+}  // namespace engine
@@ -0,0 +1,100 @@
+#include "closed_loop.hpp"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <boost/asio.hpp>
+#include <thread>
+
+#include "client.hpp"
+#include "params.hpp"
+
+using namespace ::testing;
+using namespace std::chrono_literals;
+
+namespace
+{
+class loop_client_mock : public http2_client::client
+{
+public:
+    MOCK_CONST_METHOD0(has_finished, bool());
+    MOCK_METHOD1(send, void(const std::chrono::steady_clock::time_point&));
+    MOCK_METHOD0(close_window, void());
+    MOCK_CONST_METHOD0(is_connected, bool());
+    MOCK_METHOD1(set_completion_handler, void(completion_handler&&));
+};
+}  // namespace
+
+class closed_loop_test : public ::testing::Test
+{
+public:
+    closed_loop_test() : client(new loop_client_mock), fut(prom.get_future())
+    {
+        EXPECT_CALL(*client, set_completion_handler(_))
+            .WillOnce([this](http2_client::client::completion_handler&& h)
+                      { handler = std::move(h); });
+    }
+
+protected:
+    boost::asio::io_context io_ctx;
+    std::unique_ptr<loop_client_mock> client;
+    http2_client::client::completion_handler handler;
+    std::promise<void> prom;
+    std::future<void> fut;
+};
+
+TEST_F(closed_loop_test, KeepsConcurrencyInFlight)
+{
+    auto params = std::make_shared<config::params>(1000, 5);
+    auto* c = client.get();
+    EXPECT_CALL(*c, send(_)).Times(3);
+
+    engine::closed_loop loop(io_ctx, std::move(client), params, 3, std::move(prom));
+    io_ctx.poll();
+    Mock::VerifyAndClearExpectations(c);
+
+    // Every request over starts a new one straight away
+    EXPECT_CALL(*c, send(_)).Times(2);
+    handler(true);
+    handler(true);
+    io_ctx.poll();
+    Mock::VerifyAndClearExpectations(c);
+}
+
+TEST_F(closed_loop_test, RequestsNotSentAreRetriedLater)
+{
+    auto params = std::make_shared<config::params>(1000, 5);
+    auto* c = client.get();
+    EXPECT_CALL(*c, send(_)).Times(1);
+
+    engine::closed_loop loop(io_ctx, std::move(client), params, 1, std::move(prom));
+    io_ctx.poll();
+    Mock::VerifyAndClearExpectations(c);
+
+    EXPECT_CALL(*c, send(_)).Times(0);
+    handler(false);
+    io_ctx.poll();
+    Mock::VerifyAndClearExpectations(c);
+
+    EXPECT_CALL(*c, send(_)).Times(1);
+    io_ctx.run_for(engine::closed_loop::check_period + 50ms);
+    Mock::VerifyAndClearExpectations(c);
+}
+
+TEST_F(closed_loop_test, FinishesWhenWindowIsOverAndNothingIsPending)
+{
+    auto params = std::make_shared<config::params>(1000, 1);
+    params->init_time = params->init_time - 2s;
+    EXPECT_CALL(*client, send(_)).Times(1);
+    EXPECT_CALL(*client, close_window()).Times(1);
+    EXPECT_CALL(*client, has_finished()).WillOnce(Return(true));
+
+    engine::closed_loop loop(io_ctx, std::move(client), params, 1, std::move(prom));
+    io_ctx.poll();
+
+    EXPECT_EQ(fut.wait_for(0s), std::future_status::ready);
+
+    // Late completions do not send anything else
+    handler(true);
+    io_ctx.poll();
+}
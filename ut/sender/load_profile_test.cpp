@@ -0,0 +1,147 @@
+#include "load_profile.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+namespace config
+{
+// Walks the profile as the sender does, checking time_of is the inverse of requests_until
+void check_inverse(const load_profile& p, const double requests)
+{
+    std::size_t segment{0};
+    for (double n = 1; n <= requests; ++n)
+    {
+        const double t = p.time_of(n, segment);
+        ASSERT_NEAR(n, p.requests_until(t), 1e-6 * n) << "request " << n;
+    }
+}
+
+TEST(load_profile_test, ConstantRate)
+{
+    const auto p = load_profile::constant(100);
+    ASSERT_DOUBLE_EQ(100, p.rate_at(5));
+    ASSERT_DOUBLE_EQ(500, p.requests_until(5));
+
+    std::size_t segment{0};
+    ASSERT_DOUBLE_EQ(0.01, p.time_of(1, segment));
+    ASSERT_DOUBLE_EQ(10, p.time_of(1000, segment));
+}
+
+TEST(load_profile_test, RampIsLinearAndThenConstant)
+{
+    const auto p = load_profile::ramp(0, 100, 10);
+    ASSERT_DOUBLE_EQ(0, p.rate_at(0));
+    ASSERT_DOUBLE_EQ(50, p.rate_at(5));
+    ASSERT_DOUBLE_EQ(100, p.rate_at(20));
+    ASSERT_DOUBLE_EQ(500, p.requests_until(10));
+    ASSERT_DOUBLE_EQ(1500, p.requests_until(20));
+    ASSERT_DOUBLE_EQ(50, p.mean_rate(0, 10));
+    check_inverse(p, 2000);
+}
+
+TEST(load_profile_test, RampDown)
+{
+    const auto p = load_profile::ramp(100, 20, 4);
+    ASSERT_DOUBLE_EQ(60, p.rate_at(2));
+    ASSERT_DOUBLE_EQ(240, p.requests_until(4));
+    check_inverse(p, 500);
+}
+
+TEST(load_profile_test, Step)
+{
+    const auto p = load_profile::step(10, 1000, 2);
+    ASSERT_DOUBLE_EQ(10, p.rate_at(1.9));
+    ASSERT_DOUBLE_EQ(1000, p.rate_at(2));
+    ASSERT_DOUBLE_EQ(1020, p.requests_until(3));
+
+    std::size_t segment{0};
+    ASSERT_DOUBLE_EQ(2, p.time_of(20, segment));
+    ASSERT_DOUBLE_EQ(2.001, p.time_of(21, segment));
+}
+
+TEST(load_profile_test, Staircase)
+{
+    const auto p = load_profile::staircase(100, 100, 5, 250);
+    ASSERT_DOUBLE_EQ(100, p.rate_at(4));
+    ASSERT_DOUBLE_EQ(200, p.rate_at(5));
+    ASSERT_DOUBLE_EQ(250, p.rate_at(10));
+    ASSERT_DOUBLE_EQ(250, p.rate_at(100));
+    ASSERT_DOUBLE_EQ(500 + 1000 + 1250, p.requests_until(15));
+    check_inverse(p, 3000);
+}
+
+TEST(load_profile_test, Sine)
+{
+    const auto p = load_profile::sine(100, 50, 10);
+    ASSERT_NEAR(150, p.rate_at(2.5), 1e-9);
+    ASSERT_NEAR(50, p.rate_at(7.5), 1e-9);
+    ASSERT_NEAR(1000, p.requests_until(10), 1e-9);
+    ASSERT_NEAR(100, p.mean_rate(0, 10), 1e-9);
+    check_inverse(p, 2000);
+}
+
+TEST(load_profile_test, RateDroppingToZeroNeverReachesMoreRequests)
+{
+    const auto p = load_profile::step(10, 0, 1);
+    std::size_t segment{0};
+    ASSERT_DOUBLE_EQ(1, p.time_of(10, segment));
+    ASSERT_TRUE(std::isinf(p.time_of(11, segment)));
+}
+
+TEST(load_profile_test, ScaledProfileKeepsItsShape)
+{
+    const auto ramp = load_profile::ramp(0, 100, 10).scaled(0.25);
+    ASSERT_DOUBLE_EQ(12.5, ramp.rate_at(5));
+    ASSERT_DOUBLE_EQ(125, ramp.requests_until(10));
+    check_inverse(ramp, 500);
+
+    const auto sine = load_profile::sine(100, 50, 10).scaled(0.5);
+    ASSERT_NEAR(75, sine.rate_at(2.5), 1e-9);
+    check_inverse(sine, 500);
+}
+
+TEST(load_profile_test, SwitchedProfileKeepsThePast)
+{
+    const auto p = load_profile::ramp(0, 100, 10).switched(4, 500);
+    ASSERT_DOUBLE_EQ(20, p.rate_at(2));
+    ASSERT_DOUBLE_EQ(80, p.requests_until(4));
+    ASSERT_DOUBLE_EQ(500, p.rate_at(4));
+    ASSERT_DOUBLE_EQ(580, p.requests_until(5));
+    ASSERT_DOUBLE_EQ(500, p.rate_at(50));
+    check_inverse(p, 1000);
+
+    const auto sine = load_profile::sine(100, 50, 10);
+    const auto s = sine.switched(2.5, 10);
+    ASSERT_NEAR(sine.requests_until(2.5), s.requests_until(2.5), 1e-9);
+    ASSERT_DOUBLE_EQ(10, s.rate_at(3));
+    check_inverse(s, 500);
+
+    ASSERT_DOUBLE_EQ(7, load_profile::constant(1).switched(0, 7).rate_at(0));
+    ASSERT_THROW(load_profile::constant(1).switched(1, -1), std::invalid_argument);
+}
+
+TEST(load_profile_test, WrongProfilesThrow)
+{
+    ASSERT_THROW(load_profile::ramp(-1, 10, 10), std::invalid_argument);
+    ASSERT_THROW(load_profile::ramp(1, 10, 0), std::invalid_argument);
+    ASSERT_THROW(load_profile::step(1, 10, 0), std::invalid_argument);
+    ASSERT_THROW(load_profile::staircase(10, 0, 1, 20), std::invalid_argument);
+    ASSERT_THROW(load_profile::staircase(10, 1, 1, 5), std::invalid_argument);
+    ASSERT_THROW(load_profile::staircase(0, 1e-6, 1, 1), std::invalid_argument);
+    ASSERT_THROW(load_profile::sine(10, 20, 1), std::invalid_argument);
+}
+
+TEST(load_profile_test, ParseLoadProfiles)
+{
+    ASSERT_DOUBLE_EQ(75, parse_load_profile("ramp:50:100:2").rate_at(1));
+    ASSERT_DOUBLE_EQ(100, parse_load_profile("step:50:100:2").rate_at(3));
+    ASSERT_DOUBLE_EQ(70, parse_load_profile("stairs:50:10:1:100").rate_at(2.5));
+    ASSERT_EQ(load_profile::shape::SINE, parse_load_profile("sine:10:5:60").get_shape());
+
+    ASSERT_THROW(parse_load_profile("ramp:50:100"), std::invalid_argument);
+    ASSERT_THROW(parse_load_profile("ramp:a:100:2"), std::invalid_argument);
+    ASSERT_THROW(parse_load_profile("square:1:2:3"), std::invalid_argument);
+}
+
+}  // namespace config
@@ -0,0 +1,150 @@
+#include "rate_search.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <sstream>
+
+namespace engine
+{
+namespace
+{
+// A server answering everything in 10ms up to its capacity, and failing above it
+period_result serve(const double rate, const double capacity)
+{
+    const auto answered = int64_t(rate * 10);
+    return rate <= capacity ? period_result{rate, answered, 0, 10}
+                            : period_result{rate, answered / 2, answered / 2, 500};
+}
+
+double search_capacity(rate_search& search, const double capacity)
+{
+    for (int i = 0; i < 1000 && !search.is_done(); ++i)
+    {
+        search.on_period(serve(search.get_rate(), capacity));
+    }
+    return search.get_best();
+}
+}  // namespace
+
+TEST(rate_search_test, ProbesExponentiallyAndThenBisects)
+{
+    search_config cfg;
+    cfg.start_rate = 100;
+    rate_search search(cfg);
+
+    // Warm-up period is not evaluated
+    ASSERT_DOUBLE_EQ(100, search.on_period(serve(100, 1000)));
+    ASSERT_DOUBLE_EQ(200, search.on_period(serve(100, 1000)));
+    search.on_period(serve(200, 1000));
+    ASSERT_DOUBLE_EQ(400, search.on_period(serve(200, 1000)));
+
+    const double best = search_capacity(search, 1000);
+    ASSERT_TRUE(search.is_done());
+    ASSERT_LE(best, 1000);
+    ASSERT_GE(best, 1000 * (1 - cfg.precision));
+    ASSERT_DOUBLE_EQ(best, search.get_rate());
+    ASSERT_FALSE(search.get_steps().back().passed && search.get_steps().back().rate > 1000);
+}
+
+TEST(rate_search_test, SearchesBelowTheStartRate)
+{
+    search_config cfg;
+    cfg.start_rate = 1000;
+    cfg.warmup_periods = 0;
+    rate_search search(cfg);
+
+    const double best = search_capacity(search, 300);
+    ASSERT_TRUE(search.is_done());
+    ASSERT_LE(best, 300);
+    ASSERT_GE(best, 300 * (1 - cfg.precision));
+}
+
+TEST(rate_search_test, LatencyObjectiveIsEnforced)
+{
+    search_config cfg;
+    cfg.warmup_periods = 0;
+    cfg.objectives.max_latency_ms = 5;
+    rate_search search(cfg);
+
+    search.on_period({10, 100, 0, 20});
+    ASSERT_FALSE(search.get_steps().back().passed);
+    ASSERT_DOUBLE_EQ(5, search.get_rate());
+}
+
+TEST(rate_search_test, RateNotReachedBySenderIsNotSustained)
+{
+    search_config cfg;
+    cfg.warmup_periods = 0;
+    rate_search search(cfg);
+
+    search.on_period({5, 50, 0, 1});
+    ASSERT_FALSE(search.get_steps().back().passed);
+}
+
+TEST(rate_search_test, EveryEvaluatedPeriodCounts)
+{
+    search_config cfg;
+    cfg.warmup_periods = 0;
+    cfg.periods = 2;
+    cfg.objectives.min_success = 0.9;
+    rate_search search(cfg);
+
+    search.on_period({10, 100, 0, 1});
+    ASSERT_TRUE(search.get_steps().empty());
+    search.on_period({10, 70, 30, 1});
+    ASSERT_EQ(1u, search.get_steps().size());
+    ASSERT_DOUBLE_EQ(0.85, search.get_steps().back().success);
+    ASSERT_FALSE(search.get_steps().back().passed);
+}
+
+TEST(rate_search_test, NothingSustainableEndsTheSearch)
+{
+    search_config cfg;
+    cfg.warmup_periods = 0;
+    rate_search search(cfg);
+
+    ASSERT_DOUBLE_EQ(0, search_capacity(search, 0));
+    ASSERT_TRUE(search.is_done());
+
+    std::ostringstream report;
+    search.report(report);
+    ASSERT_NE(std::string::npos, report.str().find("No rate met the objectives"));
+}
+
+TEST(rate_search_test, ReportShowsEveryStep)
+{
+    search_config cfg;
+    cfg.warmup_periods = 0;
+    rate_search search(cfg);
+    search_capacity(search, 100);
+
+    std::ostringstream report;
+    search.report(report);
+    const auto text = report.str();
+    ASSERT_NE(std::string::npos, text.find("P99(ms)"));
+    ASSERT_NE(std::string::npos, text.find("Max sustainable rate: "));
+    ASSERT_EQ(search.get_steps().size() + 2,
+              std::size_t(std::count(text.begin(), text.end(), '\n')));
+}
+
+TEST(rate_search_test, ParseSearch)
+{
+    const auto cfg = parse_search("success=0.999,p99.9=50,start=200,warmup=2,periods=3");
+    ASSERT_DOUBLE_EQ(0.999, cfg.objectives.min_success);
+    ASSERT_DOUBLE_EQ(0.999, cfg.objectives.percentile);
+    ASSERT_DOUBLE_EQ(50, cfg.objectives.max_latency_ms);
+    ASSERT_DOUBLE_EQ(200, cfg.start_rate);
+    ASSERT_EQ(2, cfg.warmup_periods);
+    ASSERT_EQ(3, cfg.periods);
+
+    ASSERT_DOUBLE_EQ(0.05, parse_search("precision=0.05").precision);
+    ASSERT_THROW(parse_search("success"), std::invalid_argument);
+    ASSERT_THROW(parse_search("success=2"), std::invalid_argument);
+    ASSERT_THROW(parse_search("p101=10"), std::invalid_argument);
+    ASSERT_THROW(parse_search("periods=0"), std::invalid_argument);
+    ASSERT_THROW(parse_search("start=abc"), std::invalid_argument);
+    ASSERT_THROW(parse_search("rate=10"), std::invalid_argument);
+}
+
+}  // namespace engine
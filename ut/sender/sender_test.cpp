@@ -3,8 +3,11 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <limits>
+
 #include "client.hpp"
 #include "params.hpp"
+#include "stats_if.hpp"
 #include "timer.hpp"
 
 using namespace ::testing;
@@ -13,26 +16,51 @@ class timer_mock : public engine::timer
 {
 public:
     MOCK_METHOD1(async_wait, void(wait_handler&&));
-    MOCK_METHOD1(expires_after, size_t(const duration_us));
+    MOCK_METHOD1(expires_after, size_t(const duration_ns));
 };
 
 class client_mock : public http2_client::client
 {
 public:
     MOCK_CONST_METHOD0(has_finished, bool());
-    MOCK_METHOD0(send, void());
+    MOCK_METHOD1(send, void(const std::chrono::steady_clock::time_point&));
     MOCK_METHOD0(close_window, void());
     MOCK_CONST_METHOD0(is_connected, bool());
+    MOCK_METHOD1(set_completion_handler, void(completion_handler&&));
+    MOCK_CONST_METHOD0(get_room, std::size_t());
+};
+
+class stats_mock : public stats::stats_if
+{
+public:
+    MOCK_METHOD1(increase_sent, void(const std::string&));
+    MOCK_METHOD3(add_measurement, void(const std::string&, const int64_t, const int));
+    MOCK_METHOD2(add_timeout, void(const std::string&, const int64_t));
+    MOCK_METHOD2(add_error, void(const std::string&, const int));
+    MOCK_METHOD2(add_client_error, void(const std::string&, const int));
+    MOCK_METHOD3(add_latency, void(const std::string&, const int64_t, const int64_t));
+    MOCK_METHOD0(add_skipped, void());
+    MOCK_METHOD3(add_wakeup, void(const int64_t, const std::size_t, const int64_t));
+    MOCK_METHOD2(add_connection_event, void(const std::size_t, const stats::connection_event));
+    MOCK_METHOD1(add_stream_wait, void(const int64_t));
+    MOCK_METHOD3(add_endpoint_event,
+                 void(const std::size_t, const stats::connection_event, const int64_t));
 };
 
 class sender_test : public ::testing::Test
 {
 public:
-    sender_test() : client(new client_mock), timer(new timer_mock), fut(prom.get_future()) {}
+    sender_test()
+        : client(new NiceMock<client_mock>), timer(new timer_mock), fut(prom.get_future())
+    {
+        ON_CALL(*client, get_room())
+            .WillByDefault(Return(std::numeric_limits<std::size_t>::max()));
+    }
 
     static void adjust_time(std::shared_ptr<config::params> params)
     {
-        params->init_time = params->init_time - std::chrono::microseconds(params->wait_time);
+        params->init_time =
+            params->init_time - std::chrono::microseconds(int64_t(params->wait_time));
     }
 
 protected:
@@ -45,12 +73,13 @@ protected:
 TEST_F(sender_test, SimpleTest)
 {
     auto params = std::make_shared<config::params>(1000000, 5);
-    auto times = params->duration * 1000000 / params->wait_time;
+    auto times = int(params->duration * 1000000 / params->wait_time);
     engine::timer::wait_handler handler;
     EXPECT_CALL(*timer, async_wait(_)).Times(times);
     EXPECT_CALL(*timer, expires_after(_)).Times(times - 1);
 
-    EXPECT_CALL(*client, send()).Times(times - 1);
+    // The first wake-up happens one period late, so the request due at 0 is sent with the next one
+    EXPECT_CALL(*client, send(_)).Times(times);
     EXPECT_CALL(*client, has_finished()).WillOnce(Return(true));
     EXPECT_CALL(*client, close_window()).Times(1);
 
@@ -64,3 +93,133 @@ TEST_F(sender_test, SimpleTest)
 
     EXPECT_EQ(fut.wait_for(std::chrono::seconds(0)), std::future_status::ready);
 }
+
+TEST_F(sender_test, BatchesRequestsDueWithinTick)
+{
+    // 1M req/s, waking up every ms
+    auto params = std::make_shared<config::params>(1, 5);
+    params->tick = 1000;
+
+    EXPECT_CALL(*timer, async_wait(_)).Times(2);
+    EXPECT_CALL(*timer, expires_after(Ge(std::chrono::milliseconds(1)))).Times(1);
+    EXPECT_CALL(*client, send(_)).Times(AtLeast(1001));
+
+    engine::sender sender(std::move(timer), std::move(client), params, std::move(prom));
+
+    params->init_time = params->init_time - std::chrono::milliseconds(1);
+    sender.send();
+}
+
+TEST_F(sender_test, FractionalRateIsNotTruncated)
+{
+    // 3 req/s
+    auto params = std::make_shared<config::params>(1e6 / 3, 5);
+
+    EXPECT_CALL(*timer, async_wait(_)).Times(2);
+    EXPECT_CALL(*timer, expires_after(_)).Times(1);
+    EXPECT_CALL(*client, send(_)).Times(3);
+
+    engine::sender sender(std::move(timer), std::move(client), params, std::move(prom));
+
+    // Requests due at 0, 1/3 and 2/3 s, but not the one at 1s
+    params->init_time = params->init_time - std::chrono::microseconds(999000);
+    sender.send();
+}
+
+TEST_F(sender_test, RequestsAreTaggedWithTheirPlannedTime)
+{
+    // 3 req/s
+    auto params = std::make_shared<config::params>(1e6 / 3, 5);
+    params->init_time = params->init_time - std::chrono::microseconds(999000);
+    const auto start = params->init_time;
+
+    EXPECT_CALL(*timer, async_wait(_)).Times(2);
+    EXPECT_CALL(*timer, expires_after(_)).Times(1);
+    EXPECT_CALL(*client, send(start)).Times(1);
+    EXPECT_CALL(*client, send(start + std::chrono::nanoseconds(333333333))).Times(1);
+    EXPECT_CALL(*client, send(start + std::chrono::nanoseconds(666666666))).Times(1);
+
+    engine::sender sender(std::move(timer), std::move(client), params, std::move(prom));
+    sender.send();
+}
+
+TEST_F(sender_test, NewRateAppliesFromTheNextWakeUp)
+{
+    // 1 req/s
+    auto params = std::make_shared<config::params>(1e6, 5);
+
+    EXPECT_CALL(*timer, async_wait(_)).Times(4);
+    EXPECT_CALL(*timer, expires_after(_)).Times(3);
+    EXPECT_CALL(*client, send(_)).Times(11);
+
+    engine::sender sender(std::move(timer), std::move(client), params, std::move(prom));
+    sender.send();
+
+    // 1000 req/s from 20ms on: requests are due every ms from 20.98ms
+    sender.set_rate(1000);
+    params->init_time = params->init_time - std::chrono::milliseconds(20);
+    sender.send();
+    params->init_time = params->init_time - std::chrono::milliseconds(10);
+    sender.send();
+}
+
+TEST_F(sender_test, StopClosesTheWindow)
+{
+    auto params = std::make_shared<config::params>(1e6, 5);
+
+    EXPECT_CALL(*timer, async_wait(_)).Times(1);
+    EXPECT_CALL(*client, close_window()).Times(1);
+    EXPECT_CALL(*client, has_finished()).WillOnce(Return(true));
+
+    engine::sender sender(std::move(timer), std::move(client), params, std::move(prom));
+    sender.stop();
+    sender.send();
+
+    EXPECT_EQ(fut.wait_for(std::chrono::seconds(0)), std::future_status::ready);
+}
+
+TEST_F(sender_test, RequestsHeldBackByTheClientKeepTheirPlannedTime)
+{
+    // 3 req/s
+    auto params = std::make_shared<config::params>(1e6 / 3, 5);
+    params->init_time = params->init_time - std::chrono::microseconds(999000);
+    const auto start = params->init_time;
+
+    EXPECT_CALL(*client, get_room()).WillOnce(Return(1)).WillRepeatedly(Return(100));
+    EXPECT_CALL(*timer, async_wait(_)).Times(3);
+    // Not everything due was sent, so the sender checks again for room 1ms later
+    EXPECT_CALL(*timer, expires_after(_)).Times(1);
+    EXPECT_CALL(*timer, expires_after(Ge(std::chrono::milliseconds(1)))).Times(1);
+    {
+        InSequence s;
+        EXPECT_CALL(*client, send(start)).Times(1);
+        EXPECT_CALL(*client, send(start + std::chrono::nanoseconds(333333333))).Times(1);
+        EXPECT_CALL(*client, send(start + std::chrono::nanoseconds(666666666))).Times(1);
+    }
+
+    engine::sender sender(std::move(timer), std::move(client), params, std::move(prom));
+    sender.send();
+    sender.send();
+}
+
+TEST_F(sender_test, WakeUpsReportHowLateTheyAre)
+{
+    // 1 req/s
+    auto params = std::make_shared<config::params>(1e6, 5);
+    auto stats = std::make_shared<stats_mock>();
+
+    EXPECT_CALL(*timer, async_wait(_)).Times(3);
+    EXPECT_CALL(*timer, expires_after(_)).Times(2);
+    EXPECT_CALL(*client, send(_)).Times(1);
+    {
+        InSequence s;
+        EXPECT_CALL(*stats, add_wakeup(Lt(10000), 1u, Ge(0))).Times(1);
+        // Planned 100ms after the first one, as nothing else is due within the second
+        EXPECT_CALL(*stats, add_wakeup(AllOf(Ge(200000), Lt(210000)), 0u, _)).Times(1);
+    }
+
+    engine::sender sender(std::move(timer), std::move(client), params, std::move(prom), stats);
+    sender.send();
+    params->init_time = params->init_time - std::chrono::milliseconds(300);
+    sender.send();
+}
@@ -0,0 +1,69 @@
+#include "histogram.hpp"
+
+#include <gtest/gtest.h>
+
+namespace stats
+{
+TEST(histogram_test, EmptyHistogram)
+{
+    histogram h;
+    ASSERT_EQ(0u, h.get_count());
+    ASSERT_EQ(0, h.percentile(0.5));
+    ASSERT_EQ(0, h.get_max());
+}
+
+TEST(histogram_test, SmallValuesAreExact)
+{
+    histogram h;
+    for (int64_t v = 0; v < 32; ++v)
+    {
+        h.record(v);
+    }
+    ASSERT_EQ(32u, h.get_count());
+    ASSERT_EQ(15, h.percentile(0.5));
+    ASSERT_EQ(31, h.percentile(1));
+}
+
+TEST(histogram_test, PercentilesKeepRelativePrecision)
+{
+    histogram h;
+    for (int64_t v = 1; v <= 100000; ++v)
+    {
+        h.record(v);
+    }
+
+    for (const auto p : {0.5, 0.9, 0.99, 0.999})
+    {
+        const double expected = p * 100000;
+        ASSERT_NEAR(expected, double(h.percentile(p)), expected * 0.0625) << p;
+    }
+    ASSERT_EQ(100000, h.percentile(1));
+    ASSERT_EQ(100000, h.get_max());
+}
+
+TEST(histogram_test, MergeAndReset)
+{
+    histogram a, b;
+    a.record(10);
+    b.record(1000);
+    b.record(1000);
+    a.merge(b);
+    ASSERT_EQ(3u, a.get_count());
+    ASSERT_EQ(1000, a.get_max());
+    ASSERT_EQ(10, a.percentile(0.3));
+
+    a.reset();
+    ASSERT_EQ(0u, a.get_count());
+    ASSERT_EQ(0, a.percentile(0.99));
+}
+
+TEST(histogram_test, OutOfRangeValuesAreClamped)
+{
+    histogram h;
+    h.record(-5);
+    h.record(int64_t(1) << 50);
+    ASSERT_EQ(0, h.percentile(0.5));
+    ASSERT_EQ((int64_t(1) << 40) - 1, h.get_max());
+}
+
+}  // namespace stats
@@ -23,6 +23,8 @@ public:
     const snapshot& get_partial_snap() const { return partial_snap; }
 
     const std::map<std::string, snapshot>& get_msg_snaps() const { return msg_snaps; }
+
+    void merge_shards() { drain_shards(); }
 };
 
 class stats_test : public ::testing::TestWithParam<int>
@@ -41,6 +43,10 @@ public:
         std::remove("stats_test_output.accum");
         std::remove("stats_test_output.partial");
         std::remove("stats_test_output.err");
+        std::remove("stats_test_output.latency");
+        std::remove("stats_test_output.sender");
+        std::remove("stats_test_output.connections");
+        std::remove("stats_test_output.endpoints");
         std::remove("stats_test_output.msg1");
         std::remove("stats_test_output.msg2");
     };
@@ -305,7 +311,7 @@ TEST_P(stats_test, add_timeout_ok)
             [&, this]
             {
                 std::this_thread::sleep_for(std::chrono::milliseconds(thread_number > 1 ? 50 : 0));
-                sut.add_timeout("msg1");
+                sut.add_timeout("msg1", 1000);
             }});
     }
     for (auto& thread : threads)
@@ -325,7 +331,7 @@ TEST_P(stats_test, add_timeout_ok)
 
 TEST_P(stats_test, add_timeout_id_non_existent)
 {
-    EXPECT_THROW(sut.add_timeout("non-existent"), std::exception);
+    EXPECT_THROW(sut.add_timeout("non-existent", 1000), std::exception);
 }
 
 TEST_P(stats_test, add_error_ok)
@@ -531,4 +537,198 @@ TEST_P(stats_test, add_client_error_id_non_existant)
 {
     EXPECT_THROW(sut.add_client_error("non-existent", 0), std::exception);
 }
+
+TEST_P(stats_test, shards_are_merged)
+{
+    // SETUP
+    const auto thread_number = GetParam();
+    const int64_t elapsed_time{1000};
+    const int code{200};
+
+    const snapshot expected_snapshot{
+        thread_number,            // sent
+        thread_number,            // responded_ok
+        0,                        // timed_out
+        0,                        // rate
+        elapsed_time,             // avg_rt
+        elapsed_time,             // max_rt
+        elapsed_time,             // min_rt
+        {{code, thread_number}},  // response_codes_ok
+        {}                        // response_codes_nok
+    };
+
+    std::vector<std::thread> threads;
+
+    // EXEC
+    for (int i = 0; i < thread_number; ++i)
+    {
+        threads.push_back(std::thread{
+            [&, this, shard = sut.create_shard()]
+            {
+                shard->increase_sent("msg1");
+                shard->add_measurement("msg1", elapsed_time, code);
+            }});
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    // ASSERT
+    EXPECT_EQ(snapshot(), sut.get_total_snap());
+    sut.merge_shards();
+    EXPECT_EQ(expected_snapshot, sut.get_total_snap());
+    EXPECT_EQ(expected_snapshot, sut.get_partial_snap());
+    EXPECT_EQ(expected_snapshot, sut.get_msg_snaps().at("msg1"));
+
+    // Shards only keep what was not merged yet
+    sut.merge_shards();
+    EXPECT_EQ(expected_snapshot, sut.get_total_snap());
+}
+
+TEST_P(stats_test, shards_merge_response_times)
+{
+    auto shard1 = sut.create_shard();
+    auto shard2 = sut.create_shard();
+    shard1->add_measurement("msg1", 1000, 200);
+    shard2->add_measurement("msg1", 4000, 200);
+    shard2->add_timeout("msg2", 9000);
+    sut.merge_shards();
+
+    const auto& total = sut.get_total_snap();
+    EXPECT_NEAR(2000, total.avg_rt, 1);
+    EXPECT_EQ(1000, total.min_rt);
+    EXPECT_EQ(4000, total.max_rt);
+    EXPECT_EQ(1, total.timed_out);
+    EXPECT_EQ(1, sut.get_msg_snaps().at("msg2").timed_out);
+    // Timeouts are response times too, but not service times
+    EXPECT_EQ(9000, total.response_time.get_max());
+    EXPECT_EQ(0u, sut.get_msg_snaps().at("msg2").service_time.get_count());
+}
+
+TEST_P(stats_test, add_latency_records_both_histograms)
+{
+    auto shard = sut.create_shard();
+    sut.add_latency("msg1", 1000, 5000);
+    shard->add_latency("msg2", 2000, 2000);
+    sut.merge_shards();
+
+    const auto& total = sut.get_total_snap();
+    EXPECT_EQ(2u, total.service_time.get_count());
+    EXPECT_EQ(2000, total.service_time.get_max());
+    EXPECT_EQ(5000, total.response_time.get_max());
+    EXPECT_EQ(2u, sut.get_partial_snap().response_time.get_count());
+    EXPECT_EQ(5000, sut.get_msg_snaps().at("msg1").response_time.get_max());
+    EXPECT_EQ(2000, sut.get_msg_snaps().at("msg2").response_time.get_max());
+}
+
+TEST_P(stats_test, add_wakeup_records_lag_and_mean_send_cost)
+{
+    auto shard = sut.create_shard();
+    sut.add_wakeup(1500, 4, 8000);
+    shard->add_wakeup(200, 0, 0);
+    sut.merge_shards();
+
+    const auto& total = sut.get_total_snap();
+    EXPECT_EQ(2u, total.send_lag.get_count());
+    EXPECT_EQ(1500, total.send_lag.get_max());
+    // Wake-ups without sends only count for the lag
+    EXPECT_EQ(1u, total.send_cost.get_count());
+    EXPECT_EQ(2000, total.send_cost.get_max());
+    EXPECT_EQ(2u, sut.get_partial_snap().send_lag.get_count());
+}
+
+TEST_P(stats_test, connection_events_are_kept_by_connection)
+{
+    auto shard = sut.create_shard();
+    sut.add_connection_event(0, connection_event::SENT);
+    sut.add_connection_event(0, connection_event::ANSWERED);
+    shard->add_connection_event(3, connection_event::SENT);
+    shard->add_connection_event(3, connection_event::FAILED);
+    sut.merge_shards();
+
+    const auto& connections = sut.get_total_snap().connections;
+    ASSERT_EQ(4u, connections.size());
+    EXPECT_EQ(1, connections[0].sent);
+    EXPECT_EQ(1, connections[0].answered);
+    EXPECT_EQ(0, connections[0].failed);
+    EXPECT_EQ(0, connections[1].sent);
+    EXPECT_EQ(1, connections[3].sent);
+    EXPECT_EQ(1, connections[3].failed);
+    EXPECT_EQ(4u, sut.get_partial_snap().connections.size());
+}
+
+TEST_P(stats_test, endpoint_events_are_kept_by_endpoint)
+{
+    sut.set_endpoint_names({"a:80", "b:80"});
+    auto shard = sut.create_shard();
+    sut.add_endpoint_event(0, connection_event::SENT, 0);
+    sut.add_endpoint_event(0, connection_event::ANSWERED, 2000);
+    shard->add_endpoint_event(1, connection_event::SENT, 0);
+    shard->add_endpoint_event(1, connection_event::ANSWERED, 5000);
+    shard->add_endpoint_event(1, connection_event::FAILED, 0);
+    sut.merge_shards();
+
+    const auto& endpoints = sut.get_total_snap().endpoints;
+    ASSERT_EQ(2u, endpoints.size());
+    EXPECT_EQ(1, endpoints[0].sent);
+    EXPECT_EQ(1, endpoints[0].answered);
+    EXPECT_EQ(0, endpoints[0].failed);
+    EXPECT_EQ(2000, endpoints[0].service_time.get_max());
+    EXPECT_EQ(1, endpoints[1].failed);
+    // Only the answered ones have a service time
+    EXPECT_EQ(1u, endpoints[1].service_time.get_count());
+    EXPECT_EQ(5000, endpoints[1].service_time.get_max());
+    EXPECT_EQ(2u, sut.get_partial_snap().endpoints.size());
+}
+
+TEST_P(stats_test, handshakes_are_counted_apart_from_messages)
+{
+    sut.add_handshake(3000, false);
+    sut.add_handshake(1000, true);
+    sut.add_handshake(800, true);
+
+    const auto& total = sut.get_total_snap();
+    EXPECT_EQ(3u, total.handshake.get_count());
+    EXPECT_EQ(3000, total.handshake.get_max());
+    EXPECT_EQ(2, total.resumed_handshakes);
+    EXPECT_EQ(2, sut.get_partial_snap().resumed_handshakes);
+    EXPECT_EQ(0, sut.get_msg_snaps().at("msg1").sent);
+}
+
+TEST_P(stats_test, skipped_sends_are_not_accounted_to_messages)
+{
+    auto shard = sut.create_shard();
+    sut.add_skipped();
+    shard->add_skipped();
+    shard->add_skipped();
+    sut.merge_shards();
+
+    EXPECT_EQ(3, sut.get_total_snap().skipped);
+    EXPECT_EQ(3, sut.get_partial_snap().skipped);
+    EXPECT_EQ(0, sut.get_msg_snaps().at("msg1").skipped);
+    EXPECT_EQ(0, sut.get_msg_snaps().at("msg1").sent);
+}
+
+TEST_P(stats_test, period_callback_receives_partial_figures)
+{
+    std::vector<snapshot> periods;
+    sut.set_period_callback([&periods](const snapshot& period) { periods.push_back(period); });
+
+    sut.increase_sent("msg1");
+    sut.add_measurement("msg1", 1000, 200);
+    sut.add_latency("msg1", 1000, 3000);
+    sut.print();
+    sut.add_timeout("msg2", 7000);
+    sut.print();
+
+    ASSERT_EQ(2u, periods.size());
+    EXPECT_EQ(1, periods[0].sent);
+    EXPECT_EQ(1, periods[0].responded_ok);
+    EXPECT_EQ(3000, periods[0].response_time.get_max());
+    EXPECT_EQ(0, periods[1].responded_ok);
+    EXPECT_EQ(1, periods[1].timed_out);
+    EXPECT_EQ(7000, periods[1].response_time.get_max());
+    EXPECT_EQ(0, sut.get_partial_snap().timed_out);
+}
 }  // namespace stats
@@ -52,6 +52,10 @@ public:
         std::remove("stats_test_extended.accum");
         std::remove("stats_test_extended.partial");
         std::remove("stats_test_extended.err");
+        std::remove("stats_test_extended.latency");
+        std::remove("stats_test_extended.sender");
+        std::remove("stats_test_extended.connections");
+        std::remove("stats_test_extended.endpoints");
         std::remove("stats_test_extended.msg1");
         std::remove("stats_test_extended.msg2");
         std::remove("stats_test_extended.msg3");
@@ -114,12 +118,15 @@ public:
         {
             sut.increase_sent("msg1");
             sut.add_measurement("msg1", 1000, 200);
+            sut.add_latency("msg1", 1000, 1000);
 
             sut.increase_sent("msg2");
             sut.add_error("msg2", 500);
 
             sut.increase_sent("msg3");
-            sut.add_timeout("msg3");
+            sut.add_timeout("msg3", 1000);
+
+            sut.add_skipped();
         }
     }
 
@@ -132,8 +139,8 @@ protected:
     std::vector<std::string> msg_names;
     stats_extended_sut sut;
     const std::string expected_headers =
-        "Time (s)      Sent/s    Recv/s        RT (ms)     minRT (ms)     maxRT (ms)           "
-        "Sent        Success         Errors       Timeouts";
+        "Time (s)    Target/s    Sent/s    Recv/s        RT (ms)     minRT (ms)     maxRT (ms)"
+        "           Sent        Success         Errors       Timeouts        Skipped";
 };
 
 TEST_F(stats_test_extended, PrintHeaders)
@@ -150,53 +157,77 @@ TEST_F(stats_test_extended, PrintAndWrite)
     simulate_responses();
     testing::internal::CaptureStdout();
     std::this_thread::sleep_for(1.1s);
-    validate_fields(testing::internal::GetCapturedStdout(), {1, 30, 10, 1, 1, 1, 30, 10, 10, 10});
+    validate_fields(testing::internal::GetCapturedStdout(),
+                    {1, 0, 30, 10, 1, 1, 1, 30, 10, 10, 10, 10});
 
     simulate_responses();
     testing::internal::CaptureStdout();
     std::this_thread::sleep_for(1.1s);
-    validate_fields(testing::internal::GetCapturedStdout(), {2, 30, 10, 1, 1, 1, 60, 20, 20, 20});
+    validate_fields(testing::internal::GetCapturedStdout(),
+                    {2, 0, 30, 10, 1, 1, 1, 60, 20, 20, 20, 20});
 
     // accum
     const auto accum_content = read_file("stats_test_extended.accum");
     ASSERT_FALSE(accum_content.empty());
     ASSERT_EQ(expected_headers, accum_content.at(1));
-    validate_fields(accum_content.at(2), {1, 30, 10, 1, 1, 1, 30, 10, 10, 10});
-    validate_fields(accum_content.at(3), {2, 30, 10, 1, 1, 1, 60, 20, 20, 20});
+    validate_fields(accum_content.at(2), {1, 0, 30, 10, 1, 1, 1, 30, 10, 10, 10, 10});
+    validate_fields(accum_content.at(3), {2, 0, 30, 10, 1, 1, 1, 60, 20, 20, 20, 20});
 
     // partial
     const auto partial_content = read_file("stats_test_extended.partial");
     ASSERT_FALSE(partial_content.empty());
     ASSERT_EQ(expected_headers, partial_content.at(1));
-    validate_fields(partial_content.at(2), {1, 30, 10, 1, 1, 1, 30, 10, 10, 10});
-    validate_fields(partial_content.at(3), {2, 30, 10, 1, 1, 1, 30, 10, 10, 10});
+    validate_fields(partial_content.at(2), {1, 0, 30, 10, 1, 1, 1, 30, 10, 10, 10, 10});
+    validate_fields(partial_content.at(3), {2, 0, 30, 10, 1, 1, 1, 30, 10, 10, 10, 10});
 
     // msg1
     const auto msg1_content = read_file("stats_test_extended.msg1");
     ASSERT_FALSE(msg1_content.empty());
     ASSERT_EQ(expected_headers, msg1_content.at(1));
-    validate_fields(msg1_content.at(2), {1, 10, 10, 1, 1, 1, 10, 10, 0, 0});
-    validate_fields(msg1_content.at(3), {2, 10, 10, 1, 1, 1, 20, 20, 0, 0});
+    validate_fields(msg1_content.at(2), {1, 0, 10, 10, 1, 1, 1, 10, 10, 0, 0, 0});
+    validate_fields(msg1_content.at(3), {2, 0, 10, 10, 1, 1, 1, 20, 20, 0, 0, 0});
 
     // msg2
     const auto msg2_content = read_file("stats_test_extended.msg2");
     ASSERT_FALSE(msg2_content.empty());
     ASSERT_EQ(expected_headers, msg2_content.at(1));
-    validate_fields(msg2_content.at(2), {1, 10, 0, 0, 0, 0, 10, 0, 10, 0});
-    validate_fields(msg2_content.at(3), {2, 10, 0, 0, 0, 0, 20, 0, 20, 0});
+    validate_fields(msg2_content.at(2), {1, 0, 10, 0, 0, 0, 0, 10, 0, 10, 0, 0});
+    validate_fields(msg2_content.at(3), {2, 0, 10, 0, 0, 0, 0, 20, 0, 20, 0, 0});
 
     // msg3
     const auto msg3_content = read_file("stats_test_extended.msg3");
     ASSERT_FALSE(msg3_content.empty());
     ASSERT_EQ(expected_headers, msg3_content.at(1));
-    validate_fields(msg3_content.at(2), {1, 10, 0, 0, 0, 0, 10, 0, 0, 10});
-    validate_fields(msg3_content.at(3), {2, 10, 0, 0, 0, 0, 20, 0, 0, 20});
+    validate_fields(msg3_content.at(2), {1, 0, 10, 0, 0, 0, 0, 10, 0, 0, 10, 0});
+    validate_fields(msg3_content.at(3), {2, 0, 10, 0, 0, 0, 0, 20, 0, 0, 20, 0});
 
     // err
     const auto err_content = read_file("stats_test_extended.err");
     ASSERT_FALSE(err_content.empty());
     validate_fields(err_content.at(2), {1, 500, 10});
     validate_fields(err_content.at(3), {2, 500, 20});
+
+    // latency
+    const auto latency_content = read_file("stats_test_extended.latency");
+    ASSERT_FALSE(latency_content.empty());
+    validate_fields(latency_content.at(3), {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1});
+    validate_fields(latency_content.at(4), {2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1});
+}
+
+TEST_F(stats_test_extended, LatencyIsWrittenByPeriod)
+{
+    testing::internal::CaptureStdout();
+    sut.add_latency("msg1", 5000, 5000);
+    std::this_thread::sleep_for(1.1s);
+    sut.add_latency("msg1", 1000, 1000);
+    std::this_thread::sleep_for(1.1s);
+    testing::internal::GetCapturedStdout();
+
+    const auto latency_content = read_file("stats_test_extended.latency");
+    ASSERT_LE(5u, latency_content.size());
+    validate_fields(latency_content.at(3), {1, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5});
+    // Only the second period
+    validate_fields(latency_content.at(4), {2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1});
 }
 
 }  // namespace stats